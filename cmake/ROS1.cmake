@@ -58,7 +58,11 @@ find_package(catkin REQUIRED COMPONENTS
   roscpp
   nodelet
   dynamic_reconfigure
+  diagnostic_msgs
   event_camera_msgs
+  message_generation
+  sensor_msgs
+  std_msgs
   std_srvs)
 
 # MetavisionSDK is now found otherwise
@@ -66,6 +70,44 @@ find_package(catkin REQUIRED COMPONENTS
 
 add_definitions(-DMETAVISION_VERSION=${MetavisionSDK_VERSION_MAJOR})
 
+# optional compression libraries for the compressed event topic
+find_package(PkgConfig QUIET)
+if(PKG_CONFIG_FOUND)
+  pkg_check_modules(ZSTD QUIET IMPORTED_TARGET libzstd)
+  pkg_check_modules(LZ4 QUIET IMPORTED_TARGET liblz4)
+endif()
+set(COMPRESSION_LIBS "")
+if(ZSTD_FOUND)
+  message(STATUS "zstd compression enabled")
+  add_definitions(-DHAS_ZSTD)
+  list(APPEND COMPRESSION_LIBS PkgConfig::ZSTD)
+endif()
+if(LZ4_FOUND)
+  message(STATUS "lz4 compression enabled")
+  add_definitions(-DHAS_LZ4)
+  list(APPEND COMPRESSION_LIBS PkgConfig::LZ4)
+endif()
+
+# per-packet timeline tracing, see include/metavision_driver/tracing.h
+option(ENABLE_TRACING "compile in the trace points" OFF)
+if(ENABLE_TRACING)
+  message(STATUS "tracing enabled")
+  add_definitions(-DMETAVISION_DRIVER_TRACING)
+endif()
+
+add_message_files(
+  FILES
+  DecodedEvents.msg
+  EventPacketInfo.msg
+  ExtTrigger.msg)
+
+add_service_files(
+  FILES
+  Seek.srv
+  SetBiases.srv)
+
+generate_messages(DEPENDENCIES std_msgs)
+
 generate_dynamic_reconfigure_options(
   cfg/MetaVisionDyn.cfg)
 
@@ -73,17 +115,33 @@ include_directories(
   include
   ${catkin_INCLUDE_DIRS})
 
-catkin_package(CATKIN_DEPENDS dynamic_reconfigure)
+catkin_package(
+  INCLUDE_DIRS include
+  LIBRARIES metavision_driver_shm
+  CATKIN_DEPENDS dynamic_reconfigure message_runtime sensor_msgs std_msgs)
+
+#
+# --------- shared memory ring (no ROS dependencies, used by consumers) ------
+
+add_library(metavision_driver_shm src/shm_ring.cpp)
+target_link_libraries(metavision_driver_shm rt)
 
 #
 # --------- driver -------------
 
 # code common to nodelet and node
 add_library(driver_common
-  src/driver_ros1.cpp src/bias_parameter.cpp src/metavision_wrapper.cpp)
-target_link_libraries(driver_common MetavisionSDK::driver ${catkin_LIBRARIES})
+  src/driver_ros1.cpp src/bias_parameter.cpp src/metavision_wrapper.cpp
+  src/raw_file_reader.cpp src/sdk_camera_source.cpp src/synthetic_source.cpp
+  src/thread_config.cpp src/thread_cpu_monitor.cpp src/tracing.cpp
+  src/buffer_pool.cpp src/preview_renderer.cpp
+  src/decoded_events_worker.cpp src/compressor.cpp src/compression_pool.cpp)
+target_link_libraries(driver_common MetavisionSDK::driver ${catkin_LIBRARIES} ${COMPRESSION_LIBS}
+  metavision_driver_shm)
 # to ensure messages get built before executable
 add_dependencies(driver_common ${metavision_driver_EXPORTED_TARGETS})
+# the preview rendering loops only get vectorized at -O3
+set_source_files_properties(src/preview_renderer.cpp PROPERTIES COMPILE_OPTIONS "-O3")
 
 # nodelet
 add_library(driver_nodelet src/driver_nodelet_ros1.cpp)
@@ -110,6 +168,14 @@ install(TARGETS driver_nodelet
   LIBRARY DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
   RUNTIME DESTINATION ${CATKIN_GLOBAL_BIN_DESTINATION})
 
+install(TARGETS metavision_driver_shm
+  ARCHIVE DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
+  LIBRARY DESTINATION ${CATKIN_PACKAGE_LIB_DESTINATION}
+  RUNTIME DESTINATION ${CATKIN_GLOBAL_BIN_DESTINATION})
+
+install(FILES include/metavision_driver/shm_ring.h
+  DESTINATION ${CATKIN_PACKAGE_INCLUDE_DESTINATION})
+
 install(FILES nodelet_plugins.xml
   DESTINATION ${CATKIN_PACKAGE_SHARE_DESTINATION})
 
@@ -132,4 +198,30 @@ endif()
 ## Testing ##
 #############
 
-# To be done...
+if(CATKIN_ENABLE_TESTING)
+  catkin_add_gtest(${PROJECT_NAME}_test_evt3_decoder test/test_evt3_decoder.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_decoders test/test_decoders.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_ordered_worker_pool
+    test/test_ordered_worker_pool.cpp src/thread_config.cpp)
+  target_link_libraries(${PROJECT_NAME}_test_ordered_worker_pool ${catkin_LIBRARIES})
+
+  catkin_add_gtest(${PROJECT_NAME}_test_shm_ring test/test_shm_ring.cpp)
+  target_link_libraries(${PROJECT_NAME}_test_shm_ring metavision_driver_shm)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_raw_scanner test/test_raw_scanner.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_packet_sizer test/test_packet_sizer.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_reserve_policy test/test_reserve_policy.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_bias_controller
+    test/test_bias_controller.cpp src/bias_parameter.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_time_gap_detector test/test_time_gap_detector.cpp)
+
+  catkin_add_gtest(${PROJECT_NAME}_test_raw_file_reader
+    test/test_raw_file_reader.cpp src/raw_file_reader.cpp src/thread_config.cpp)
+  target_link_libraries(${PROJECT_NAME}_test_raw_file_reader ${catkin_LIBRARIES})
+endif()
@@ -48,9 +48,13 @@ find_package(ament_cmake_ros REQUIRED)
 
 
 set(ROS2_DEPENDENCIES
+  "rosidl_default_generators"
   "rclcpp"
   "rclcpp_components"
+  "diagnostic_msgs"
   "event_camera_msgs"
+  "sensor_msgs"
+  "std_msgs"
   "std_srvs"
 )
 
@@ -60,32 +64,114 @@ endforeach()
 
 ament_auto_find_build_dependencies(REQUIRED ${ROS2_DEPENDENCIES})
 
+# optional compression libraries for the compressed event topic
+find_package(PkgConfig QUIET)
+if(PKG_CONFIG_FOUND)
+  pkg_check_modules(ZSTD QUIET IMPORTED_TARGET libzstd)
+  pkg_check_modules(LZ4 QUIET IMPORTED_TARGET liblz4)
+endif()
+set(COMPRESSION_LIBS "")
+if(ZSTD_FOUND)
+  message(STATUS "zstd compression enabled")
+  add_definitions(-DHAS_ZSTD)
+  list(APPEND COMPRESSION_LIBS PkgConfig::ZSTD)
+endif()
+if(LZ4_FOUND)
+  message(STATUS "lz4 compression enabled")
+  add_definitions(-DHAS_LZ4)
+  list(APPEND COMPRESSION_LIBS PkgConfig::LZ4)
+endif()
+
+# per-packet timeline tracing, see include/metavision_driver/tracing.h
+option(ENABLE_TRACING "compile in the trace points" OFF)
+if(ENABLE_TRACING)
+  message(STATUS "tracing enabled")
+  add_definitions(-DMETAVISION_DRIVER_TRACING)
+endif()
+
+#
+# --------- messages and services -------------
+
+rosidl_generate_interfaces(${PROJECT_NAME}
+  "msg/DecodedEvents.msg"
+  "msg/EventPacketInfo.msg"
+  "msg/ExtTrigger.msg"
+  "srv/Seek.srv"
+  "srv/SetBiases.srv"
+  DEPENDENCIES std_msgs)
+
+#
+# --------- shared memory ring (no ROS dependencies, used by consumers) ------
+
+add_library(metavision_driver_shm SHARED src/shm_ring.cpp)
+target_include_directories(metavision_driver_shm PUBLIC
+  $<BUILD_INTERFACE:${CMAKE_CURRENT_SOURCE_DIR}/include>
+  $<INSTALL_INTERFACE:include>)
+target_link_libraries(metavision_driver_shm rt)
+
 #
 # --------- driver (composable component) -------------
 
 ament_auto_add_library(driver_ros2 SHARED
   src/metavision_wrapper.cpp
   src/bias_parameter.cpp
-  src/driver_ros2.cpp)
+  src/raw_file_reader.cpp
+  src/sdk_camera_source.cpp
+  src/synthetic_source.cpp
+  src/thread_config.cpp
+  src/thread_cpu_monitor.cpp
+  src/tracing.cpp
+  src/buffer_pool.cpp
+  src/preview_renderer.cpp
+  src/decoded_events_worker.cpp
+  src/compressor.cpp
+  src/compression_pool.cpp
+  src/parameters_ros2.cpp
+  src/driver_ros2.cpp
+  src/multi_driver_ros2.cpp)
+
+# the preview rendering loops only get vectorized at -O3
+set_source_files_properties(src/preview_renderer.cpp PROPERTIES COMPILE_OPTIONS "-O3")
 
 set(MV_COMPONENTS_QUAL ${MV_COMPONENTS})
 list(TRANSFORM MV_COMPONENTS_QUAL PREPEND "MetavisionSDK::")
 
 target_include_directories(driver_ros2 PRIVATE include)
-target_link_libraries(driver_ros2  ${MV_COMPONENTS_QUAL})
+target_link_libraries(driver_ros2  ${MV_COMPONENTS_QUAL} ${COMPRESSION_LIBS} metavision_driver_shm)
+
+# link against the interfaces generated in this package
+if(COMMAND rosidl_get_typesupport_target)
+  rosidl_get_typesupport_target(cpp_typesupport_target ${PROJECT_NAME} "rosidl_typesupport_cpp")
+  target_link_libraries(driver_ros2 "${cpp_typesupport_target}")
+else()
+  rosidl_target_interfaces(driver_ros2 ${PROJECT_NAME} "rosidl_typesupport_cpp")
+endif()
 
 rclcpp_components_register_nodes(driver_ros2 "metavision_driver::DriverROS2")
+rclcpp_components_register_nodes(driver_ros2 "metavision_driver::MultiDriverROS2")
 
 # --------- driver (plain old node) -------------
 
 ament_auto_add_executable(driver_node
   src/driver_node_ros2.cpp)
 
+# --------- benchmark for the raw data pipeline -------------
+
+ament_auto_add_executable(metavision_driver_bench
+  src/bench_ros2.cpp)
+target_link_libraries(metavision_driver_bench ${MV_COMPONENTS_QUAL})
+if(COMMAND rosidl_get_typesupport_target)
+  target_link_libraries(metavision_driver_bench "${cpp_typesupport_target}")
+else()
+  rosidl_target_interfaces(metavision_driver_bench ${PROJECT_NAME} "rosidl_typesupport_cpp")
+endif()
+
 
 # the node must go into the project specific lib directory or else
 # the launch file will not find it
 install(TARGETS
   driver_node
+  metavision_driver_bench
   DESTINATION lib/${PROJECT_NAME}/)
 
 # the shared library goes into the global lib dir so it can
@@ -95,6 +181,13 @@ install(TARGETS
   driver_ros2
   DESTINATION lib)
 
+install(TARGETS metavision_driver_shm
+  EXPORT export_metavision_driver_shm
+  DESTINATION lib)
+
+install(FILES include/metavision_driver/shm_ring.h
+  DESTINATION include/${PROJECT_NAME})
+
 install(PROGRAMS
   src/stop_recording_ros2.py
   DESTINATION lib/${PROJECT_NAME}/)
@@ -129,6 +222,45 @@ if(BUILD_TESTING)
   # ament_pep257() # (does not work on galactic/foxy)
   ament_xmllint()
   ament_clang_format(CONFIG_FILE .clang-format)
+
+  # unit tests
+  find_package(ament_cmake_gtest REQUIRED)
+  ament_add_gtest(${PROJECT_NAME}_test_evt3_decoder test/test_evt3_decoder.cpp)
+  target_include_directories(${PROJECT_NAME}_test_evt3_decoder PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_decoders test/test_decoders.cpp)
+  target_include_directories(${PROJECT_NAME}_test_decoders PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_ordered_worker_pool
+    test/test_ordered_worker_pool.cpp src/thread_config.cpp)
+  target_include_directories(${PROJECT_NAME}_test_ordered_worker_pool PRIVATE include)
+  ament_target_dependencies(${PROJECT_NAME}_test_ordered_worker_pool rclcpp)
+
+  ament_add_gtest(${PROJECT_NAME}_test_shm_ring test/test_shm_ring.cpp)
+  target_link_libraries(${PROJECT_NAME}_test_shm_ring metavision_driver_shm)
+
+  ament_add_gtest(${PROJECT_NAME}_test_raw_scanner test/test_raw_scanner.cpp)
+  target_include_directories(${PROJECT_NAME}_test_raw_scanner PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_packet_sizer test/test_packet_sizer.cpp)
+  target_include_directories(${PROJECT_NAME}_test_packet_sizer PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_reserve_policy test/test_reserve_policy.cpp)
+  target_include_directories(${PROJECT_NAME}_test_reserve_policy PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_bias_controller
+    test/test_bias_controller.cpp src/bias_parameter.cpp)
+  target_include_directories(${PROJECT_NAME}_test_bias_controller PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_time_gap_detector test/test_time_gap_detector.cpp)
+  target_include_directories(${PROJECT_NAME}_test_time_gap_detector PRIVATE include)
+
+  ament_add_gtest(${PROJECT_NAME}_test_raw_file_reader
+    test/test_raw_file_reader.cpp src/raw_file_reader.cpp src/thread_config.cpp)
+  target_include_directories(${PROJECT_NAME}_test_raw_file_reader PRIVATE include)
+  ament_target_dependencies(${PROJECT_NAME}_test_raw_file_reader rclcpp)
 endif()
 
+ament_export_targets(export_metavision_driver_shm HAS_LIBRARY_TARGET)
+ament_export_dependencies(rosidl_default_runtime)
 ament_package()
@@ -0,0 +1,206 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__BIAS_CONTROLLER_H_
+#define METAVISION_DRIVER__BIAS_CONTROLLER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/bias_parameter.h"
+
+namespace metavision_driver
+{
+//
+// Holds the CD event rate near a target by stepping the contrast biases
+// (bias_diff_on/off) and, once they are at their limits, the bandwidth
+// bias (bias_fo). Nothing is changed while the rate stays inside the
+// hysteresis band. When the rate drops, the biases are walked back to
+// where they started, but never beyond: the biases at startup are the
+// most sensitive setting the controller will use.
+//
+class BiasController
+{
+public:
+  struct Config
+  {
+    double targetRate{0};       // events/sec, 0 = disabled
+    double hysteresis{0.2};     // band is targetRate * (1 +- hysteresis)
+    double stepFraction{0.05};  // step as fraction of the bias range
+    double interval{1.0};       // sec between adjustments
+  };
+  enum State { DISABLED, HOLDING, REDUCING, RESTORING, SATURATED };
+
+  void setConfig(const Config & config)
+  {
+    config_ = config;
+    config_.hysteresis = std::min(std::max(config.hysteresis, 0.0), 0.9);
+    config_.interval = std::max(config.interval, 0.01);
+  }
+  const Config & getConfig() const { return (config_); }
+
+  // biases holds the values at startup, they become the baseline
+  void initialize(const std::string & sensorVersion, const std::map<std::string, int> & biases)
+  {
+    controlled_.clear();
+    baseline_.clear();
+    const auto dit = directions().find(sensorVersion);
+    if (dit == directions().end()) {
+      return;
+    }
+    const auto & ranges = BiasParameter::getAll(sensorVersion);
+    for (const auto & d : dit->second) {
+      const auto rit = ranges.find(d.first);
+      const auto bit = biases.find(d.first);
+      if (rit == ranges.end() || bit == biases.end()) {
+        continue;
+      }
+      const auto & r = rit->second;
+      const int step = std::max(
+        static_cast<int>(config_.stepFraction * (r.maxVal - r.minVal) + 0.5), static_cast<int>(1));
+      controlled_.push_back({d.first, r.minVal, r.maxVal, step, d.second, d.first != "bias_fo"});
+      baseline_[d.first] = bit->second;
+    }
+    numEvents_ = 0;
+    lastUpdate_ = std::chrono::steady_clock::now();
+    state_ = isEnabled() ? HOLDING : DISABLED;
+  }
+
+  bool isEnabled() const { return (config_.targetRate > 0 && !controlled_.empty()); }
+
+  // may be called from any thread
+  inline void addEvents(uint64_t n) { numEvents_.fetch_add(n, std::memory_order_relaxed); }
+
+  // Call every config.interval with the current bias values, which may
+  // have been changed by the user. Returns the biases to change.
+  std::map<std::string, int> update(const std::map<std::string, int> & current)
+  {
+    std::map<std::string, int> changes;
+    const auto now = std::chrono::steady_clock::now();
+    const double dt = std::chrono::duration<double>(now - lastUpdate_).count();
+    lastUpdate_ = now;
+    const uint64_t n = numEvents_.exchange(0, std::memory_order_relaxed);
+    if (!isEnabled() || dt <= 0) {
+      return (changes);
+    }
+    rate_ = n / dt;
+    if (rate_ > config_.targetRate * (1.0 + config_.hysteresis)) {
+      const bool moved =
+        stepGroup(current, true, true, &changes) || stepGroup(current, false, true, &changes);
+      state_ = moved ? REDUCING : SATURATED;
+    } else if (rate_ < config_.targetRate * (1.0 - config_.hysteresis)) {
+      // undo the bandwidth reduction first, it costs more signal
+      const bool moved =
+        stepGroup(current, false, false, &changes) || stepGroup(current, true, false, &changes);
+      state_ = moved ? RESTORING : HOLDING;
+    } else {
+      state_ = HOLDING;
+    }
+    return (changes);
+  }
+
+  State getState() const { return (state_); }
+  const char * getStateName() const
+  {
+    switch (state_) {
+      case HOLDING:
+        return ("holding");
+      case REDUCING:
+        return ("reducing sensitivity");
+      case RESTORING:
+        return ("restoring sensitivity");
+      case SATURATED:
+        return ("saturated, cannot reduce rate further");
+      default:
+        return ("disabled");
+    }
+  }
+  double getRate() const { return (rate_); }  // measured at last update
+  const std::map<std::string, int> & getBaseline() const { return (baseline_); }
+  std::vector<std::string> getControlledBiases() const
+  {
+    std::vector<std::string> names;
+    for (const auto & b : controlled_) {
+      names.push_back(b.name);
+    }
+    return (names);
+  }
+
+private:
+  struct ControlledBias
+  {
+    std::string name;
+    int minVal;
+    int maxVal;
+    int step;
+    int direction;  // +1 if increasing the bias lowers the event rate
+    bool isContrast;
+  };
+
+  static const std::map<std::string, std::map<std::string, int>> & directions()
+  {
+    // Gen3 and Gen4 sensors differ in the sign of bias_diff_off and bias_fo
+    static const std::map<std::string, std::map<std::string, int>> dirs = {
+      {"3.1", {{"bias_diff_on", 1}, {"bias_diff_off", -1}, {"bias_fo", 1}}},
+      {"4.1", {{"bias_diff_on", 1}, {"bias_diff_off", 1}, {"bias_fo", -1}}},
+      {"4.2", {{"bias_diff_on", 1}, {"bias_diff_off", 1}, {"bias_fo", -1}}}};
+    return (dirs);
+  }
+
+  // Moves the contrast or the bandwidth biases by one step, either toward
+  // a lower rate or back toward the baseline. Returns true if any moved.
+  bool stepGroup(
+    const std::map<std::string, int> & current, bool contrast, bool reduce,
+    std::map<std::string, int> * changes) const
+  {
+    bool moved = false;
+    for (const auto & b : controlled_) {
+      const auto it = current.find(b.name);
+      if (b.isContrast != contrast || it == current.end()) {
+        continue;
+      }
+      const int v = it->second;
+      int target = v + b.direction * b.step;
+      if (!reduce) {
+        const int base = baseline_.find(b.name)->second;
+        if ((v - base) * b.direction <= 0) {
+          continue;  // already at or more sensitive than the baseline
+        }
+        target = (b.direction > 0) ? std::max(v - b.step, base) : std::min(v + b.step, base);
+      }
+      target = std::min(std::max(target, b.minVal), b.maxVal);
+      if (target != v) {
+        (*changes)[b.name] = target;
+        moved = true;
+      }
+    }
+    return (moved);
+  }
+
+  // ------------ variables
+  Config config_;
+  std::vector<ControlledBias> controlled_;
+  std::map<std::string, int> baseline_;
+  std::atomic<uint64_t> numEvents_{0};
+  std::chrono::steady_clock::time_point lastUpdate_;
+  double rate_{0};
+  State state_{DISABLED};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__BIAS_CONTROLLER_H_
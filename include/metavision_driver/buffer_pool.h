@@ -0,0 +1,65 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__BUFFER_POOL_H_
+#define METAVISION_DRIVER__BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Pool of fixed size buffers carved out of a single memory region
+// that is backed by regular pages ("malloc"), transparent hugepages
+// ("thp") or explicit hugepages ("hugetlb"). The region is pre-faulted
+// by the thread calling prefault(), so with the default NUMA policy
+// (first touch) the memory lands on that thread's node.
+//
+class BufferPool
+{
+public:
+  explicit BufferPool(const std::string & loggerName);
+  ~BufferPool();
+  // returns false if no memory could be mapped at all
+  bool initialize(const std::string & mode, size_t blockSize, size_t numBlocks);
+  void prefault();
+  // returns nullptr if the request is too large or the pool is exhausted
+  void * allocate(size_t size);
+  // returns false if the buffer does not belong to the pool
+  bool release(void * p);
+  const std::string & getMode() const { return (mode_); }
+  bool isReady() const { return (ready_); }
+
+private:
+  void unmap();
+  // ------------ variables
+  std::string loggerName_;
+  std::string mode_{"none"};   // mode actually in use
+  uint8_t * region_{nullptr};  // start of mapped region
+  size_t regionSize_{0};
+  uint8_t * blocks_{nullptr};  // first block, aligned
+  size_t blockSize_{0};
+  size_t numBlocks_{0};
+  std::mutex mutex_;
+  std::vector<void *> freeList_;
+  std::atomic<bool> ready_{false};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__BUFFER_POOL_H_
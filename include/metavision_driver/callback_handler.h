@@ -32,6 +32,13 @@ public:
   virtual void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) = 0;
   virtual void eventCDCallback(
     uint64_t t, const Metavision::EventCD * start, const Metavision::EventCD * end) = 0;
+  // called on the data thread before the first data after the camera
+  // was reopened or playback from file jumped, the sensor time starts over
+  virtual void sourceRestarted() {}
+  // called on the data thread before data that does not continue the
+  // sensor time of the previous data: either lostTime (usec) is missing
+  // or the sensor clock was reset
+  virtual void sensorTimeGap(uint64_t /* lostTime */, bool /* isReset */) {}
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__CALLBACK_HANDLER_H_
@@ -0,0 +1,66 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__COMPRESSION_POOL_H_
+#define METAVISION_DRIVER__COMPRESSION_POOL_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/compressor.h"
+#include "metavision_driver/event_packet_data.h"
+#include "metavision_driver/ordered_worker_pool.h"
+#include "metavision_driver/thread_config.h"
+
+namespace metavision_driver
+{
+//
+// Compresses event messages on a pool of threads. The callback
+// is invoked in message order.
+//
+class CompressionPool
+{
+public:
+  struct Job
+  {
+    EventPacketData packet;
+    std::vector<uint8_t> compressed;
+  };
+  using Callback = std::function<void(Job *)>;
+  CompressionPool(
+    const std::string & loggerName, const std::string & method, int level, int numThreads,
+    size_t maxInFlight);
+  void start(const Callback & cb, const ThreadConfig & threadConfig);
+  void stop();
+  // returns false if the packet was dropped because too many are in flight
+  bool submit(const EventPacketData & packet);
+  const std::string & getMethod() const { return (method_); }
+  std::string getStatsReport() { return (pool_.getStatsReport()); }
+
+private:
+  void process(int worker, Job * job);
+  void emit(Job * job);
+  // ------------ variables
+  std::string loggerName_;
+  std::string method_;
+  Callback callback_;
+  std::vector<std::unique_ptr<Compressor>> compressors_;  // one per worker
+  OrderedWorkerPool<Job> pool_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__COMPRESSION_POOL_H_
@@ -0,0 +1,49 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__COMPRESSOR_H_
+#define METAVISION_DRIVER__COMPRESSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Compresses buffers with zstd or LZ4 (frame format, so the
+// uncompressed size is stored in the output). Not thread safe,
+// use one instance per thread.
+//
+class Compressor
+{
+public:
+  // method: "zstd" or "lz4". Returns false if not compiled in.
+  static bool isSupported(const std::string & method);
+  Compressor(const std::string & method, int level);
+  ~Compressor();
+  Compressor(const Compressor &) = delete;
+  Compressor & operator=(const Compressor &) = delete;
+  // returns false on failure
+  bool compress(const uint8_t * data, size_t size, std::vector<uint8_t> * out);
+
+private:
+  std::string method_;
+  int level_{1};
+  void * zstdContext_{nullptr};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__COMPRESSOR_H_
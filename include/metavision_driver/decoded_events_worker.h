@@ -0,0 +1,98 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__DECODED_EVENTS_WORKER_H_
+#define METAVISION_DRIVER__DECODED_EVENTS_WORKER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+#include "metavision_driver/event_packet_data.h"
+#include "metavision_driver/ordered_worker_pool.h"
+#include "metavision_driver/reserve_policy.h"
+#include "metavision_driver/thread_config.h"
+
+namespace metavision_driver
+{
+struct DecodedEventArrays
+{
+  uint64_t timeBase{0};  // sensor time (nsec) of first event
+  std::vector<uint16_t> x;
+  std::vector<uint16_t> y;
+  std::vector<uint8_t> polarity;
+  std::vector<uint32_t> t;  // sensor time (usec) relative to time base
+};
+
+//
+// Decodes event messages into arrays. The decoder carries state from
+// one message to the next, so this stage runs on a single worker.
+//
+class DecodedEventsWorker
+{
+public:
+  struct Job
+  {
+    EventPacketData packet;
+    DecodedEventArrays events;
+    bool resetDecoder{false};  // sensor time starts over with this packet
+  };
+  using Callback = std::function<void(Job *)>;
+  DecodedEventsWorker(
+    const std::string & loggerName, const std::string & encoding, size_t maxInFlight);
+  ~DecodedEventsWorker() { stop(); }  // drain while the decoder still exists
+  void start(const Callback & cb, const ThreadConfig & threadConfig);
+  void stop();
+  // returns false if the packet was dropped because the worker falls behind
+  bool submit(const EventPacketData & packet);
+  // the sensor time starts over with the next packet submitted
+  void resetTime() { resetPending_ = true; }
+  std::string getStatsReport() { return (pool_.getStatsReport()); }
+
+  // ---------- callbacks from the decoder
+  inline void eventCD(uint64_t t, uint16_t x, uint16_t y, uint8_t p)
+  {
+    DecodedEventArrays & ev = *events_;
+    if (ev.t.empty()) {
+      timeBase_ = t;
+      ev.timeBase = t * 1000;
+    }
+    ev.x.push_back(x);
+    ev.y.push_back(y);
+    ev.polarity.push_back(p);
+    ev.t.push_back(static_cast<uint32_t>(t - timeBase_));
+  }
+  inline void eventExtTrigger(uint64_t, uint8_t, uint8_t) {}
+
+private:
+  void process(int worker, Job * job);
+  void emit(Job * job);
+  // ------------ variables
+  std::string loggerName_;
+  std::string encoding_;
+  Callback callback_;
+  OrderedWorkerPool<Job> pool_;
+  bool resetPending_{false};  // only accessed by the submitting thread
+  // ------ only accessed by the worker thread
+  std::unique_ptr<EventDecoder<DecodedEventsWorker>> decoder_;
+  DecodedEventArrays * events_{nullptr};  // arrays currently decoded into
+  uint64_t timeBase_{0};                  // usec
+  ReservePolicy reservePolicy_;  // in number of events
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__DECODED_EVENTS_WORKER_H_
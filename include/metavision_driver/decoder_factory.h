@@ -0,0 +1,48 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__DECODER_FACTORY_H_
+#define METAVISION_DRIVER__DECODER_FACTORY_H_
+
+#include <memory>
+#include <string>
+
+#include "metavision_driver/event_decoder.h"
+#include "metavision_driver/evt21_decoder.h"
+#include "metavision_driver/evt2_decoder.h"
+#include "metavision_driver/evt3_decoder.h"
+
+namespace metavision_driver
+{
+inline bool is_supported_encoding(const std::string & encoding)
+{
+  return (encoding == "evt2" || encoding == "evt21" || encoding == "evt3");
+}
+
+// returns nullptr for unsupported encodings
+template <class Processor>
+std::unique_ptr<EventDecoder<Processor>> make_decoder(const std::string & encoding)
+{
+  if (encoding == "evt3") {
+    return (std::unique_ptr<EventDecoder<Processor>>(new evt3::Decoder<Processor>()));
+  } else if (encoding == "evt2") {
+    return (std::unique_ptr<EventDecoder<Processor>>(new evt2::Decoder<Processor>()));
+  } else if (encoding == "evt21") {
+    return (std::unique_ptr<EventDecoder<Processor>>(new evt21::Decoder<Processor>()));
+  }
+  return (nullptr);
+}
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__DECODER_FACTORY_H_
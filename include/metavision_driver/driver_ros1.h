@@ -16,18 +16,36 @@
 #ifndef METAVISION_DRIVER__DRIVER_ROS1_H_
 #define METAVISION_DRIVER__DRIVER_ROS1_H_
 
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <dynamic_reconfigure/server.h>
 #include <event_camera_msgs/EventPacket.h>
 #include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <std_msgs/Header.h>
 #include <std_srvs/Trigger.h>
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "metavision_driver/DecodedEvents.h"
+#include "metavision_driver/EventPacketInfo.h"
+#include "metavision_driver/ExtTrigger.h"
 #include "metavision_driver/MetaVisionDynConfig.h"
+#include "metavision_driver/Seek.h"
+#include "metavision_driver/SetBiases.h"
+#include "metavision_driver/bias_controller.h"
 #include "metavision_driver/bias_parameter.h"
 #include "metavision_driver/callback_handler.h"
+#include "metavision_driver/compression_pool.h"
+#include "metavision_driver/decoded_events_worker.h"
+#include "metavision_driver/packet_sizer.h"
+#include "metavision_driver/preview_renderer.h"
+#include "metavision_driver/raw_scanner.h"
+#include "metavision_driver/reserve_policy.h"
 #include "metavision_driver/resize_hack.h"
+#include "metavision_driver/ros_time_keeper.h"
+#include "metavision_driver/shm_ring.h"
 
 namespace metavision_driver
 {
@@ -37,7 +55,13 @@ class DriverROS1 : public CallbackHandler
 {
   using Config = MetaVisionDynConfig;
   using EventPacketMsg = event_camera_msgs::EventPacket;
+  using ExtTriggerMsg = ExtTrigger;
+  using DecodedEventsMsg = DecodedEvents;
+  using EventPacketInfoMsg = EventPacketInfo;
+  using ImageMsg = sensor_msgs::Image;
   using Trigger = std_srvs::Trigger;
+  using HeaderMsg = std_msgs::Header;
+  using DiagnosticArrayMsg = diagnostic_msgs::DiagnosticArray;
 
 public:
   explicit DriverROS1(ros::NodeHandle & nh);
@@ -47,20 +71,51 @@ public:
   void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override;
   void eventCDCallback(
     uint64_t t, const Metavision::EventCD * begin, const Metavision::EventCD * end) override;
+  void sourceRestarted() override;
+  void sensorTimeGap(uint64_t lostTime, bool isReset) override;
   // ---------------- end of inherited  -----------
 
 private:
   // service call to dump biases
   bool saveBiases(Trigger::Request & req, Trigger::Response & res);
+  // service calls to start and stop tracing, stopping writes the trace file
+  bool startTracing(Trigger::Request & req, Trigger::Response & res);
+  bool stopTracing(Trigger::Request & req, Trigger::Response & res);
+  // service call to seek when playing from file
+  bool seek(Seek::Request & req, Seek::Response & res);
+  // service call to change several biases at once
+  bool setBiases(SetBiases::Request & req, SetBiases::Response & res);
 
   // related to dynanmic config (runtime parameter update)
   void setBias(int * field, const std::string & name);
   int getBias(const std::string & name) const;
 
   void configure(Config & config, int level);
+  // applies ROI, ERC and trail filter changes, reverts rejected ones
+  void updateRuntimeConfig(Config * config, int level);
 
   // for primary sync
-  bool secondaryReadyCallback(Trigger::Request & req, Trigger::Response & res);
+  void secondaryReadyCallback(const HeaderMsg::ConstPtr & msg);
+
+  void publishTriggers(uint64_t t);
+  void resetSensorTime();
+  void sendMessage(uint64_t t, bool sendRaw, bool sendCompressed, bool sendDecoded, bool sendShm);
+  // sends the partially assembled message, if any
+  void flushMessage();
+  void publishPacketInfo();
+  void initializePreview();
+  void previewTimerExpired(const ros::WallTimerEvent &);
+  void initializeBiasController();
+  void biasControlTimerExpired(const ros::WallTimerEvent &);
+  // shows the current camera biases in dynamic reconfigure
+  void updateConfigBiases();
+  void initializeDecodedEvents();
+  void publishDecodedEvents(DecodedEventsWorker::Job * job);
+  void initializeCompression();
+  void submitPacket(bool copyEvents, bool compress, bool decode);
+  void publishCompressed(CompressionPool::Job * job);
+  void initializeSharedMemory();
+  void writeSharedMemory();
 
   // misc helper functions
   void start();
@@ -76,21 +131,56 @@ private:
   std::string frameId_;  // ROS frame id
   std::string encoding_;
   uint64_t seq_{0};        // sequence number
-  size_t reserveSize_{0};  // recommended reserve size
-  uint64_t lastMessageTime_{0};
-  uint64_t messageThresholdTime_{0};  // threshold time for sending message
-  size_t messageThresholdSize_{0};    // threshold size for sending message
+  ReservePolicy reservePolicy_;  // how much to reserve for messages
+  PacketSizer packetSizer_;  // decides when to send message
   EventPacketMsg::Ptr msg_;
   ros::Publisher eventPub_;
+  // ------ related to scanning the raw data
+  std::shared_ptr<RawScanner> scanner_;
+  bool scanPaused_{false};  // some data was not scanned
+  PacketInfo packetInfo_;   // for the message being assembled
+  uint64_t lostTime_{0};    // sensor time (usec) lost since last message was sent
+  bool timeReset_{false};   // sensor clock reset since last message was sent
+  ros::Publisher infoPub_;
+  // ------ related to external triggers
+  std::vector<TriggerEvent> triggers_;
+  std::shared_ptr<ROSTimeKeeper> timeKeeper_;
+  ros::Publisher triggerPub_;
+  // ------ related to preview image
+  std::shared_ptr<PreviewRenderer> previewRenderer_;
+  ros::Publisher previewPub_;
+  ros::WallTimer previewTimer_;
+  // ------ related to decoded events
+  std::shared_ptr<DecodedEventsWorker> decodedWorker_;
+  bool decodePaused_{false};  // some data was not decoded
+  ros::Publisher decodedPub_;
+  // ------ related to compression
+  std::shared_ptr<CompressionPool> compressionPool_;
+  ros::Publisher compressedPub_;
+  // ------ related to shared memory transport
+  std::shared_ptr<ShmRingWriter> shmWriter_;
+  ros::Publisher shmPub_;
 
   // ------ related to sync
-  ros::ServiceServer secondaryReadyServer_;
+  ros::Publisher readyPub_;   // secondary: latched, sent once camera is up
+  ros::Subscriber readySub_;  // primary: starts camera on first message
+  bool secondaryIsReady_{false};
   // ------ related to dynamic config and services
   Config config_;
   std::shared_ptr<dynamic_reconfigure::Server<Config>> configServer_;
   ros::ServiceServer saveBiasService_;
+  ros::ServiceServer seekService_;
+  ros::ServiceServer setBiasesService_;
   using ParameterMap = std::map<std::string, BiasParameter>;
   ParameterMap biasParameters_;
+  // ------ related to automatic bias control
+  BiasController biasController_;
+  ros::WallTimer biasControlTimer_;
+  ros::Publisher diagnosticsPub_;
+  // ------ related to tracing
+  std::string tracingFile_;
+  ros::ServiceServer startTracingService_;
+  ros::ServiceServer stopTracingService_;
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__DRIVER_ROS1_H_
@@ -16,17 +16,34 @@
 #ifndef METAVISION_DRIVER__DRIVER_ROS2_H_
 #define METAVISION_DRIVER__DRIVER_ROS2_H_
 
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include <event_camera_msgs/msg/event_packet.hpp>
 #include <map>
 #include <memory>
 #include <rclcpp/rclcpp.hpp>
+#include <sensor_msgs/msg/image.hpp>
 #include <std_msgs/msg/header.hpp>
 #include <std_srvs/srv/trigger.hpp>
 #include <string>
+#include <vector>
 
+#include "metavision_driver/bias_controller.h"
 #include "metavision_driver/bias_parameter.h"
 #include "metavision_driver/callback_handler.h"
+#include "metavision_driver/compression_pool.h"
+#include "metavision_driver/decoded_events_worker.h"
+#include "metavision_driver/msg/decoded_events.hpp"
+#include "metavision_driver/msg/event_packet_info.hpp"
+#include "metavision_driver/msg/ext_trigger.hpp"
+#include "metavision_driver/packet_sizer.h"
+#include "metavision_driver/preview_renderer.h"
+#include "metavision_driver/raw_scanner.h"
+#include "metavision_driver/reserve_policy.h"
 #include "metavision_driver/resize_hack.h"
+#include "metavision_driver/ros_time_keeper.h"
+#include "metavision_driver/shm_ring.h"
+#include "metavision_driver/srv/seek.hpp"
+#include "metavision_driver/srv/set_biases.hpp"
 
 namespace metavision_driver
 {
@@ -35,7 +52,15 @@ class MetavisionWrapper;  // forward decl
 class DriverROS2 : public rclcpp::Node, public CallbackHandler
 {
   using EventPacketMsg = event_camera_msgs::msg::EventPacket;
+  using ExtTriggerMsg = msg::ExtTrigger;
+  using DecodedEventsMsg = msg::DecodedEvents;
+  using EventPacketInfoMsg = msg::EventPacketInfo;
+  using ImageMsg = sensor_msgs::msg::Image;
   using Trigger = std_srvs::srv::Trigger;
+  using HeaderMsg = std_msgs::msg::Header;
+  using Seek = srv::Seek;
+  using SetBiases = srv::SetBiases;
+  using DiagnosticArrayMsg = diagnostic_msgs::msg::DiagnosticArray;
 
 public:
   explicit DriverROS2(const rclcpp::NodeOptions & options);
@@ -45,6 +70,8 @@ public:
   void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override;
   void eventCDCallback(
     uint64_t t, const Metavision::EventCD * begin, const Metavision::EventCD * end) override;
+  void sourceRestarted() override;
+  void sensorTimeGap(uint64_t lostTime, bool isReset) override;
   // ---------------- end of inherited  -----------
 
 private:
@@ -52,6 +79,17 @@ private:
   void saveBiases(
     const std::shared_ptr<Trigger::Request> request,
     const std::shared_ptr<Trigger::Response> response);
+  // service calls to start and stop tracing, stopping writes the trace file
+  void enableTracing(
+    bool enable, const std::shared_ptr<Trigger::Request> request,
+    const std::shared_ptr<Trigger::Response> response);
+  // service call to seek when playing from file
+  void seek(
+    const std::shared_ptr<Seek::Request> request, const std::shared_ptr<Seek::Response> response);
+  // service call to change several biases at once
+  void setBiases(
+    const std::shared_ptr<SetBiases::Request> request,
+    const std::shared_ptr<SetBiases::Response> response);
 
   // related to dynanmic config (runtime parameter update)
   rcl_interfaces::msg::SetParametersResult parameterChanged(
@@ -60,6 +98,36 @@ private:
   void addBiasParameter(const std::string & n, const BiasParameter & bp);
   void initializeBiasParameters(const std::string & sensorVersion);
   void declareBiasParameters(const std::string & sensorVersion);
+  // sets the ROS parameters of those biases that differ from the map
+  void updateBiasParameters(const std::map<std::string, int> & biases);
+  // ROI, ERC and trail filter, checked when set and applied to the
+  // hardware once the whole set of parameters has been accepted
+  rcl_interfaces::msg::SetParametersResult checkRuntimeParameter(const rclcpp::Parameter & p);
+  void applyRuntimeParameters(const std::map<std::string, rclcpp::Parameter> & changed);
+  // sets the ROS parameters to what the hardware has
+  void updateRuntimeParameters();
+  void declareRuntimeParameter(
+    const std::string & name, const rclcpp::ParameterValue & value, const std::string & info);
+  void declareRuntimeParameters();
+
+  void publishTriggers(uint64_t t);
+  void resetSensorTime();
+  void sendMessage(uint64_t t, bool sendRaw, bool sendCompressed, bool sendDecoded, bool sendShm);
+  // sends the partially assembled message, if any
+  void flushMessage();
+  void publishPacketInfo();
+  void initializePreview();
+  void publishPreview();
+  void initializeDecodedEvents();
+  void publishDecodedEvents(DecodedEventsWorker::Job * job);
+  void initializeCompression();
+  void submitPacket(bool copyEvents, bool compress, bool decode);
+  void publishCompressed(CompressionPool::Job * job);
+  void initializeSharedMemory();
+  void writeSharedMemory();
+  void initializeBiasController();
+  void updateBiasController();
+  void initializeTracing();
 
   // misc helper functions
   void start();
@@ -74,15 +142,39 @@ private:
   std::string frameId_;
   std::string encoding_;
   uint64_t seq_{0};        // sequence number
-  size_t reserveSize_{0};  // recommended reserve size
-  uint64_t lastMessageTime_{0};
-  uint64_t messageThresholdTime_{0};  // threshold time for sending message
-  size_t messageThresholdSize_{0};    // threshold size for sending message
+  ReservePolicy reservePolicy_;  // how much to reserve for messages
+  PacketSizer packetSizer_;  // decides when to send message
   EventPacketMsg::UniquePtr msg_;
   rclcpp::Publisher<EventPacketMsg>::SharedPtr eventPub_;
+  // ------ related to scanning the raw data
+  std::shared_ptr<RawScanner> scanner_;
+  bool scanPaused_{false};  // some data was not scanned
+  PacketInfo packetInfo_;   // for the message being assembled
+  uint64_t lostTime_{0};    // sensor time (usec) lost since last message was sent
+  bool timeReset_{false};   // sensor clock reset since last message was sent
+  rclcpp::Publisher<EventPacketInfoMsg>::SharedPtr infoPub_;
+  // ------ related to external triggers
+  std::vector<TriggerEvent> triggers_;
+  std::shared_ptr<ROSTimeKeeper> timeKeeper_;
+  rclcpp::Publisher<ExtTriggerMsg>::SharedPtr triggerPub_;
+  // ------ related to preview image
+  std::shared_ptr<PreviewRenderer> previewRenderer_;
+  rclcpp::Publisher<ImageMsg>::SharedPtr previewPub_;
+  rclcpp::TimerBase::SharedPtr previewTimer_;
+  // ------ related to decoded events
+  std::shared_ptr<DecodedEventsWorker> decodedWorker_;
+  bool decodePaused_{false};  // some data was not decoded
+  rclcpp::Publisher<DecodedEventsMsg>::SharedPtr decodedPub_;
+  // ------ related to compression
+  std::shared_ptr<CompressionPool> compressionPool_;
+  rclcpp::Publisher<EventPacketMsg>::SharedPtr compressedPub_;
+  // ------ related to shared memory transport
+  std::shared_ptr<ShmRingWriter> shmWriter_;
+  rclcpp::Publisher<EventPacketMsg>::SharedPtr shmPub_;
   // ------ related to sync
-  rclcpp::Service<Trigger>::SharedPtr secondaryReadyServer_;
-  rclcpp::TimerBase::SharedPtr oneOffTimer_;
+  rclcpp::Publisher<HeaderMsg>::SharedPtr readyPub_;     // secondary
+  rclcpp::Subscription<HeaderMsg>::SharedPtr readySub_;  // primary
+  bool secondaryIsReady_{false};
   // ------ related to dynamic config and services
   typedef std::map<std::string, rcl_interfaces::msg::ParameterDescriptor> ParameterMap;
   rclcpp::Node::OnSetParametersCallbackHandle::SharedPtr callbackHandle_;
@@ -90,6 +182,16 @@ private:
     parameterSubscription_;
   ParameterMap biasParameters_;
   rclcpp::Service<Trigger>::SharedPtr saveBiasesService_;
+  rclcpp::Service<Seek>::SharedPtr seekService_;
+  rclcpp::Service<SetBiases>::SharedPtr setBiasesService_;
+  // ------ related to automatic bias control
+  BiasController biasController_;
+  rclcpp::TimerBase::SharedPtr biasControlTimer_;
+  rclcpp::Publisher<DiagnosticArrayMsg>::SharedPtr diagnosticsPub_;
+  // ------ related to tracing
+  std::string tracingFile_;
+  rclcpp::Service<Trigger>::SharedPtr startTracingService_;
+  rclcpp::Service<Trigger>::SharedPtr stopTracingService_;
 };
 }  // namespace metavision_driver
 #endif  // METAVISION_DRIVER__DRIVER_ROS2_H_
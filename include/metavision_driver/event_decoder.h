@@ -0,0 +1,44 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVENT_DECODER_H_
+#define METAVISION_DRIVER__EVENT_DECODER_H_
+
+#include <cstdint>
+
+namespace metavision_driver
+{
+//
+// Interface for the per-encoding decoders (evt2, evt21, evt3). The
+// processor must provide
+//
+//   void eventCD(uint64_t t, uint16_t x, uint16_t y, uint8_t polarity);
+//   void eventExtTrigger(uint64_t t, uint8_t id, uint8_t polarity);
+//
+// with t being the sensor time in usec. The decoders are templated on
+// the processor such that these calls get inlined into the decoding
+// loop. The only virtual call is decode() itself, once per buffer.
+//
+template <class Processor>
+class EventDecoder
+{
+public:
+  virtual ~EventDecoder() {}
+  virtual void decode(const uint8_t * start, const uint8_t * end, Processor * proc) = 0;
+  virtual uint64_t getTime() const = 0;  // sensor time (usec) of last word decoded
+  virtual bool hasValidTime() const = 0;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVENT_DECODER_H_
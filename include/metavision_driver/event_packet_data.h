@@ -0,0 +1,37 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVENT_PACKET_DATA_H_
+#define METAVISION_DRIVER__EVENT_PACKET_DATA_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// An assembled event message as handed to the post-processing stages.
+// The raw data is shared (read only) between all stages.
+//
+struct EventPacketData
+{
+  uint64_t seq{0};       // message sequence number
+  uint64_t stamp{0};     // message ROS time stamp (nsec)
+  uint64_t timeBase{0};  // message time base
+  std::shared_ptr<const std::vector<uint8_t>> events;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVENT_PACKET_DATA_H_
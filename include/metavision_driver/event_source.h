@@ -0,0 +1,79 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVENT_SOURCE_H_
+#define METAVISION_DRIVER__EVENT_SOURCE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "metavision_driver/thread_config.h"
+
+namespace Metavision
+{
+class Camera;  // forward decl
+}
+
+namespace metavision_driver
+{
+//
+// Produces raw (encoded) event data, e.g. from a camera, a file,
+// or a synthetic generator.
+//
+class EventSource
+{
+public:
+  using Callback = std::function<void(const uint8_t *, size_t)>;
+  using RestartCallback = std::function<void()>;
+  explicit EventSource(const std::string & loggerName) : loggerName_(loggerName) {}
+  virtual ~EventSource() {}
+  // open() must be called before any of the getters are valid
+  virtual bool open() = 0;
+  virtual bool start(const Callback & cb) = 0;
+  virtual bool stop() = 0;  // returns true if source was running
+  // seek to sensor time (usec), only supported by some sources
+  virtual bool seek(uint64_t) { return (false); }
+  // called from the data thread when the next data does not continue
+  // the previous data, e.g. after a seek
+  void setRestartCallback(const RestartCallback & cb) { restartCallback_ = cb; }
+  // the SDK camera for configuring the hardware, or null if there is none
+  virtual Metavision::Camera * getCamera() { return (nullptr); }
+  // for sources that run their own thread
+  void setThreadConfig(const ThreadConfig & c) { threadConfig_ = c; }
+  // false if the callbacks come from a thread the source does not
+  // control, the thread config must then be applied by the caller
+  virtual bool ownsCallbackThread() const { return (true); }
+
+  int getWidth() const { return (width_); }
+  int getHeight() const { return (height_); }
+  const std::string & getEncodingFormat() const { return (encodingFormat_); }
+  const std::string & getSerialNumber() const { return (serialNumber_); }
+  const std::string & getSensorVersion() const { return (sensorVersion_); }
+  const std::string & getSensorName() const { return (sensorName_); }
+
+protected:
+  std::string loggerName_;
+  int width_{0};   // image width
+  int height_{0};  // image height
+  std::string encodingFormat_{"unknown"};
+  std::string serialNumber_;
+  std::string sensorVersion_{"0.0"};
+  std::string sensorName_;
+  ThreadConfig threadConfig_;
+  RestartCallback restartCallback_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVENT_SOURCE_H_
@@ -0,0 +1,83 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT21_DECODER_H_
+#define METAVISION_DRIVER__EVT21_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "metavision_driver/event_decoder.h"
+#include "metavision_driver/evt21_utils.h"
+
+namespace metavision_driver
+{
+namespace evt21
+{
+//
+// Decodes EVT2.1 raw data, see EventDecoder for the processor interface
+//
+template <class Processor>
+class Decoder : public EventDecoder<Processor>
+{
+public:
+  void decode(const uint8_t * start, const uint8_t * end, Processor * proc) final
+  {
+    const uint8_t * last = start + ((end - start) & ~static_cast<ptrdiff_t>(7));
+    for (const uint8_t * p = start; p < last; p += sizeof(uint64_t)) {
+      const uint64_t w = readWord(p);
+      const uint32_t u = upper(w);
+      const uint8_t c = code(w);
+      switch (c) {
+        case CD_OFF:
+        case CD_ON:
+          if (hasTime_) {
+            time_ = timeHigh_ | evt2::timeLow(u);
+            const uint16_t x = (u >> 11) & 0x07FF;
+            const uint16_t y = u & 0x07FF;
+            for (uint32_t m = mask(w); m != 0; m &= m - 1) {
+              proc->eventCD(time_, x + __builtin_ctz(m), y, c);
+            }
+          }
+          break;
+        case TIME_HIGH:
+          timeHigh_ = timeHighTracker_.update(u & TIME_HIGH_MASK);
+          time_ = timeHigh_;
+          hasTime_ = true;
+          break;
+        case EXT_TRIGGER:
+          if (hasTime_) {
+            time_ = timeHigh_ | evt2::timeLow(u);
+            proc->eventExtTrigger(time_, (u >> 8) & 0x1F, u & 0x1);
+          }
+          break;
+        default:  // OTHERS, CONTINUED
+          break;
+      }
+    }
+  }
+  uint64_t getTime() const final { return (time_); }
+  bool hasValidTime() const final { return (hasTime_); }
+
+private:
+  // ------------ variables
+  TimeHighTracker timeHighTracker_;
+  uint64_t timeHigh_{0};
+  uint64_t time_{0};
+  bool hasTime_{false};
+};
+}  // namespace evt21
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT21_DECODER_H_
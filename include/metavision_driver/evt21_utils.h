@@ -0,0 +1,77 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT21_UTILS_H_
+#define METAVISION_DRIVER__EVT21_UTILS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "metavision_driver/evt2_utils.h"
+
+namespace metavision_driver
+{
+namespace evt21
+{
+//
+// EVT2.1 words are 64 bits wide. The upper 32 bits are laid out like
+// an EVT2 word, for CD events the lower 32 bits hold a mask of valid
+// pixels starting at x.
+//
+enum Code : uint8_t {
+  CD_OFF = 0x0,
+  CD_ON = 0x1,
+  TIME_HIGH = 0x8,
+  EXT_TRIGGER = 0xA,
+  OTHERS = 0xE,
+  CONTINUED = 0xF
+};
+
+// time handling is the same as for EVT2
+using evt2::TimeHighTracker;
+using evt2::TIME_HIGH_MASK;
+
+// raw data is little endian and not necessarily aligned
+inline uint64_t readWord(const uint8_t * p)
+{
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  return (w);
+}
+inline uint32_t upper(uint64_t w) { return (static_cast<uint32_t>(w >> 32)); }
+inline uint32_t mask(uint64_t w) { return (static_cast<uint32_t>(w)); }
+inline uint8_t code(uint64_t w) { return (w >> 60); }
+
+// finds the TIME_HIGH words, used for indexing raw files
+class TimeHighScanner
+{
+public:
+  static constexpr size_t WORD_SIZE = sizeof(uint64_t);
+  inline bool scan(const uint8_t * p, uint64_t * t)
+  {
+    const uint64_t w = readWord(p);
+    if (code(w) != TIME_HIGH) {
+      return (false);
+    }
+    *t = tracker_.update(upper(w) & TIME_HIGH_MASK);
+    return (true);
+  }
+
+private:
+  TimeHighTracker tracker_;
+};
+}  // namespace evt21
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT21_UTILS_H_
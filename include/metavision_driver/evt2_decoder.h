@@ -0,0 +1,78 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT2_DECODER_H_
+#define METAVISION_DRIVER__EVT2_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "metavision_driver/event_decoder.h"
+#include "metavision_driver/evt2_utils.h"
+
+namespace metavision_driver
+{
+namespace evt2
+{
+//
+// Decodes EVT2 raw data, see EventDecoder for the processor interface
+//
+template <class Processor>
+class Decoder : public EventDecoder<Processor>
+{
+public:
+  void decode(const uint8_t * start, const uint8_t * end, Processor * proc) final
+  {
+    const uint8_t * last = start + ((end - start) & ~static_cast<ptrdiff_t>(3));
+    for (const uint8_t * p = start; p < last; p += sizeof(uint32_t)) {
+      const uint32_t w = readWord(p);
+      const uint8_t c = code(w);
+      switch (c) {
+        case CD_OFF:
+        case CD_ON:
+          if (hasTime_) {
+            time_ = timeHigh_ | timeLow(w);
+            proc->eventCD(time_, (w >> 11) & 0x07FF, w & 0x07FF, c);
+          }
+          break;
+        case TIME_HIGH:
+          timeHigh_ = timeHighTracker_.update(w & TIME_HIGH_MASK);
+          time_ = timeHigh_;
+          hasTime_ = true;
+          break;
+        case EXT_TRIGGER:
+          if (hasTime_) {
+            time_ = timeHigh_ | timeLow(w);
+            proc->eventExtTrigger(time_, (w >> 8) & 0x1F, w & 0x1);
+          }
+          break;
+        default:  // OTHERS, CONTINUED
+          break;
+      }
+    }
+  }
+  uint64_t getTime() const final { return (time_); }
+  bool hasValidTime() const final { return (hasTime_); }
+
+private:
+  // ------------ variables
+  TimeHighTracker timeHighTracker_;
+  uint64_t timeHigh_{0};
+  uint64_t time_{0};
+  bool hasTime_{false};
+};
+}  // namespace evt2
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT2_DECODER_H_
@@ -0,0 +1,93 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT2_UTILS_H_
+#define METAVISION_DRIVER__EVT2_UTILS_H_
+
+#include <cstdint>
+#include <cstring>
+
+namespace metavision_driver
+{
+namespace evt2
+{
+// EVT2 words are 32 bits wide, with the type code in the upper 4 bits
+enum Code : uint8_t {
+  CD_OFF = 0x0,
+  CD_ON = 0x1,
+  TIME_HIGH = 0x8,
+  EXT_TRIGGER = 0xA,
+  OTHERS = 0xE,
+  CONTINUED = 0xF
+};
+
+// events carry the lower 6 bits of the 34 bit sensor time (usec)
+static constexpr int TIME_LOW_BITS = 6;
+static constexpr uint32_t TIME_HIGH_MASK = 0x0FFFFFFF;
+static constexpr uint64_t TIME_ROLLOVER = 1ULL << 34;  // usec
+
+// raw data is little endian and not necessarily aligned
+inline uint32_t readWord(const uint8_t * p)
+{
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  return (w);
+}
+inline uint8_t code(uint32_t w) { return (w >> 28); }
+inline uint32_t timeLow(uint32_t w) { return ((w >> 22) & 0x3F); }
+
+//
+// Extends the 28 bit TIME_HIGH counter to 64 bits by counting roll-overs.
+// Returns the sensor time (usec) corresponding to the TIME_HIGH word.
+//
+class TimeHighTracker
+{
+public:
+  inline uint64_t update(uint32_t timeHigh)
+  {
+    // a large backwards step is a roll-over, a small one is a glitch
+    if (timeHigh < lastTimeHigh_ && lastTimeHigh_ - timeHigh > (TIME_HIGH_MASK >> 1)) {
+      epoch_ += TIME_ROLLOVER;
+    }
+    lastTimeHigh_ = timeHigh;
+    return (epoch_ + (static_cast<uint64_t>(timeHigh) << TIME_LOW_BITS));
+  }
+
+private:
+  uint64_t epoch_{0};
+  uint32_t lastTimeHigh_{0};
+};
+
+// finds the TIME_HIGH words, used for indexing raw files
+class TimeHighScanner
+{
+public:
+  static constexpr size_t WORD_SIZE = sizeof(uint32_t);
+  inline bool scan(const uint8_t * p, uint64_t * t)
+  {
+    const uint32_t w = readWord(p);
+    if (code(w) != TIME_HIGH) {
+      return (false);
+    }
+    *t = tracker_.update(w & TIME_HIGH_MASK);
+    return (true);
+  }
+
+private:
+  TimeHighTracker tracker_;
+};
+}  // namespace evt2
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT2_UTILS_H_
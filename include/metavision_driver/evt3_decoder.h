@@ -0,0 +1,102 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_DECODER_H_
+#define METAVISION_DRIVER__EVT3_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "metavision_driver/event_decoder.h"
+#include "metavision_driver/evt3_utils.h"
+
+namespace metavision_driver
+{
+namespace evt3
+{
+//
+// Decodes EVT3 raw data, see EventDecoder for the processor interface
+//
+template <class Processor>
+class Decoder : public EventDecoder<Processor>
+{
+public:
+  void decode(const uint8_t * start, const uint8_t * end, Processor * proc) final
+  {
+    const uint8_t * last = start + ((end - start) & ~static_cast<ptrdiff_t>(1));
+    for (const uint8_t * p = start; p < last; p += sizeof(uint16_t)) {
+      const uint16_t w = readWord(p);
+      switch (code(w)) {
+        case ADDR_Y:
+          y_ = w & 0x07FF;
+          break;
+        case ADDR_X:
+          if (hasTime_) {
+            proc->eventCD(time_, w & 0x07FF, y_, (w >> 11) & 0x1);
+          }
+          break;
+        case VECT_BASE_X:
+          baseX_ = w & 0x07FF;
+          polarity_ = (w >> 11) & 0x1;
+          break;
+        case VECT_12:
+          emitVector(w & 0x0FFF, 12, proc);
+          break;
+        case VECT_8:
+          emitVector(w & 0x00FF, 8, proc);
+          break;
+        case TIME_LOW:
+          time_ = timeHigh_ | payload(w);
+          break;
+        case TIME_HIGH:
+          timeHigh_ = timeHighTracker_.update(payload(w));
+          time_ = timeHigh_;
+          hasTime_ = true;
+          break;
+        case EXT_TRIGGER:
+          if (hasTime_) {
+            proc->eventExtTrigger(time_, (w >> 8) & 0x0F, w & 0x1);
+          }
+          break;
+        default:  // OTHERS, CONTINUED_4, CONTINUED_12
+          break;
+      }
+    }
+  }
+  uint64_t getTime() const final { return (time_); }
+  bool hasValidTime() const final { return (hasTime_); }
+
+private:
+  inline void emitVector(uint16_t mask, uint16_t numBits, Processor * proc)
+  {
+    if (hasTime_) {
+      for (uint16_t m = mask; m != 0; m &= m - 1) {
+        proc->eventCD(time_, baseX_ + __builtin_ctz(m), y_, polarity_);
+      }
+    }
+    baseX_ += numBits;
+  }
+  // ------------ variables
+  TimeHighTracker timeHighTracker_;
+  uint64_t timeHigh_{0};
+  uint64_t time_{0};
+  uint16_t y_{0};
+  uint16_t baseX_{0};
+  uint8_t polarity_{0};
+  bool hasTime_{false};
+};
+}  // namespace evt3
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_DECODER_H_
@@ -0,0 +1,167 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__EVT3_UTILS_H_
+#define METAVISION_DRIVER__EVT3_UTILS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace metavision_driver
+{
+namespace evt3
+{
+// EVT3 words are 16 bits wide, with the type code in the upper 4 bits
+enum Code : uint8_t {
+  ADDR_Y = 0x0,
+  ADDR_X = 0x2,
+  VECT_BASE_X = 0x3,
+  VECT_12 = 0x4,
+  VECT_8 = 0x5,
+  TIME_LOW = 0x6,
+  CONTINUED_4 = 0x7,
+  TIME_HIGH = 0x8,
+  EXT_TRIGGER = 0xA,
+  OTHERS = 0xE,
+  CONTINUED_12 = 0xF
+};
+
+// the TIME_LOW word holds the lower 12 bits of the 24 bit sensor time (usec)
+static constexpr int TIME_LOW_BITS = 12;
+static constexpr uint64_t TIME_HIGH_PERIOD = 1ULL << TIME_LOW_BITS;  // usec
+static constexpr uint64_t TIME_ROLLOVER = 1ULL << 24;                // usec
+
+// raw data is little endian and not necessarily aligned
+inline uint16_t readWord(const uint8_t * p)
+{
+  uint16_t w;
+  memcpy(&w, p, sizeof(w));
+  return (w);
+}
+inline uint8_t code(uint16_t w) { return (w >> 12); }
+inline uint16_t payload(uint16_t w) { return (w & 0x0FFF); }
+
+//
+// Extends the 12 bit TIME_HIGH counter to 64 bits by counting roll-overs.
+// Returns the sensor time (usec) corresponding to the TIME_HIGH word.
+//
+class TimeHighTracker
+{
+public:
+  inline uint64_t update(uint16_t timeHigh)
+  {
+    // a large backwards step is a roll-over, a small one is a glitch
+    if (timeHigh < lastTimeHigh_ && lastTimeHigh_ - timeHigh > (1 << (TIME_LOW_BITS - 1))) {
+      epoch_ += TIME_ROLLOVER;
+    }
+    lastTimeHigh_ = timeHigh;
+    return (epoch_ + (static_cast<uint64_t>(timeHigh) << TIME_LOW_BITS));
+  }
+  inline void reset()
+  {
+    epoch_ = 0;
+    lastTimeHigh_ = 0;
+  }
+
+private:
+  uint64_t epoch_{0};
+  uint16_t lastTimeHigh_{0};
+};
+
+// finds the TIME_HIGH words, used for indexing raw files
+class TimeHighScanner
+{
+public:
+  static constexpr size_t WORD_SIZE = sizeof(uint16_t);
+  inline bool scan(const uint8_t * p, uint64_t * t)
+  {
+    const uint16_t w = readWord(p);
+    if (code(w) != TIME_HIGH) {
+      return (false);
+    }
+    *t = tracker_.update(payload(w));
+    return (true);
+  }
+
+private:
+  TimeHighTracker tracker_;
+};
+
+//
+// Checks the sensor time for continuity from one raw buffer to the
+// next. The sensor emits at least one TIME_HIGH word per period, so a
+// larger step between the last TIME_HIGH of a buffer and the first one
+// of the following buffer means data was lost on the way. A large step
+// backwards means the sensor clock was reset. Only the ends of the
+// buffers are scanned.
+//
+class TimeGapDetector
+{
+public:
+  enum Result { NONE, GAP, RESET };
+  // threshold (usec) is the largest step that is still continuous
+  explicit TimeGapDetector(uint64_t threshold)
+  : threshold_(threshold > TIME_HIGH_PERIOD ? threshold : TIME_HIGH_PERIOD)
+  {
+  }
+  // returns the discontinuity before the buffer, with the sensor time
+  // (usec) missing in *lostTime for a GAP
+  inline Result check(const uint8_t * start, const uint8_t * end, uint64_t * lostTime)
+  {
+    *lostTime = 0;
+    const size_t numWords = (end - start) / sizeof(uint16_t);
+    size_t i = 0;
+    while (i < numWords && code(readWord(start + i * sizeof(uint16_t))) != TIME_HIGH) {
+      i++;
+    }
+    if (i == numWords) {
+      return (NONE);  // no time information in this buffer
+    }
+    size_t j = numWords - 1;
+    while (j > i && code(readWord(start + j * sizeof(uint16_t))) != TIME_HIGH) {
+      j--;
+    }
+    const uint16_t first = payload(readWord(start + i * sizeof(uint16_t)));
+    const uint16_t last = payload(readWord(start + j * sizeof(uint16_t)));
+    Result result = NONE;
+    if (hasTimeHigh_) {
+      // the counter is 12 bits wide, a forward step of more than half
+      // the range is a step backwards
+      const uint64_t step = (first - lastTimeHigh_) & 0x0FFF;
+      const uint64_t forward = step * TIME_HIGH_PERIOD;
+      const uint64_t backward = ((1 << TIME_LOW_BITS) - step) * TIME_HIGH_PERIOD;
+      if (step < (1 << (TIME_LOW_BITS - 1))) {
+        if (forward > threshold_) {
+          result = GAP;
+          *lostTime = forward - TIME_HIGH_PERIOD;
+        }
+      } else if (backward > threshold_) {
+        result = RESET;
+      }
+    }
+    lastTimeHigh_ = last;
+    hasTimeHigh_ = true;
+    return (result);
+  }
+
+private:
+  uint64_t threshold_;
+  uint16_t lastTimeHigh_{0};
+  bool hasTimeHigh_{false};
+};
+}  // namespace evt3
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__EVT3_UTILS_H_
@@ -22,17 +22,26 @@
 #include <metavision/sdk/stream/camera.h>
 #endif
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
+#include "metavision_driver/buffer_pool.h"
 #include "metavision_driver/callback_handler.h"
+#include "metavision_driver/event_source.h"
+#include "metavision_driver/evt3_utils.h"
+#include "metavision_driver/synthetic_source.h"
+#include "metavision_driver/thread_cpu_monitor.h"
+#include "metavision_driver/thread_config.h"
 
 namespace ph = std::placeholders;
 
@@ -53,6 +62,9 @@ public:
     const void * start{0};
     size_t numBytes{0};
     uint64_t timeStamp{0};
+    bool isRestart{false};    // first data after reconnect
+    bool isTimeReset{false};  // sensor clock was reset before this data
+    uint64_t lostTime{0};     // sensor time (usec) lost before this data
   };
 
   struct Stats
@@ -62,6 +74,39 @@ public:
     size_t bytesSent{0};
     size_t bytesRecv{0};
     size_t maxQueueSize{0};
+    size_t bytesCompressedIn{0};
+    size_t bytesCompressedOut{0};
+    size_t msgsDropped{0};
+    size_t timeGaps{0};
+    size_t timeResets{0};
+    uint64_t timeLost{0};  // usec
+  };
+
+  // what the statistics thread reports every interval, rates are per sec
+  struct StatsReport
+  {
+    double interval{0};          // sec
+    double bytesInRate{0};       // MB/s received from the SDK
+    double bytesOutRate{0};      // MB/s published
+    double msgsInRate{0};        // SDK callbacks
+    double msgsOutRate{0};       // messages published
+    size_t msgsDropped{0};       // messages dropped by the driver
+    size_t queueSize{0};         // processing queue depth at time of report
+    size_t maxQueueSize{0};      // processing queue depth maximum
+    double latencyP50{0};        // usec from SDK callback until handler is done
+    double latencyP90{0};        // usec
+    double latencyP99{0};        // usec
+    double latencyMax{0};        // usec
+    double cpuLoad{0};           // process CPU time in % of one core
+    double pageFaultRate{0};
+    double compressionRatio{0};  // 0 if nothing was compressed
+    double compressedRate{0};    // MB/s after compression
+    size_t numReconnects{0};
+    size_t numTimeGaps{0};       // sensor time discontinuities, i.e. lost data
+    size_t numTimeResets{0};     // sensor clock jumped backwards
+    double lostTime{0};          // msec of sensor time lost
+    // source, processing and stats thread
+    std::vector<ThreadCpuMonitor::Usage> threads;
   };
 
   struct TrailFilter
@@ -72,6 +117,7 @@ public:
   };
 
   typedef std::map<std::string, std::map<std::string, int>> HardwarePinConfig;
+  typedef SyntheticEventGenerator::Config SyntheticConfig;
 
   explicit MetavisionWrapper(const std::string & loggerName);
   ~MetavisionWrapper();
@@ -79,6 +125,14 @@ public:
   int getBias(const std::string & name);
   bool hasBias(const std::string & name);
   int setBias(const std::string & name, int val);
+  // Applies all biases in one pass. If one of them cannot be set, the
+  // others are rolled back and false is returned with the reason in msg.
+  // On success result holds all biases as read back from the camera.
+  bool setBiases(
+    const std::map<std::string, int> & request, std::map<std::string, int> * result,
+    std::string * msg);
+  // false if the bias is read only or the value is out of range for the sensor
+  bool checkBias(const std::string & name, int val, std::string * msg) const;
   bool initialize(bool useMultithreading, const std::string & biasFile);
   bool saveBiases();
   inline void updateMsgsSent(int inc)
@@ -91,6 +145,25 @@ public:
     std::unique_lock<std::mutex> lock(statsMutex_);
     stats_.bytesSent += inc;
   }
+  inline void updateCompressionStats(size_t bytesIn, size_t bytesOut)
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    stats_.bytesCompressedIn += bytesIn;
+    stats_.bytesCompressedOut += bytesOut;
+  }
+  inline void updateMsgsDropped(int inc)
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    stats_.msgsDropped += inc;
+  }
+  // returns unused heap memory to the OS at the next statistics printout
+  void requestHeapTrim() { trimHeap_ = true; }
+  // reporter is called by the statistics thread, empty lines are not printed
+  void addStatsReporter(const std::function<std::string()> & reporter)
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    statsReporters_.push_back(reporter);
+  }
   bool stop();
   int getWidth() const { return (width_); }
   int getHeight() const { return (height_); }
@@ -101,13 +174,57 @@ public:
   const std::string & getSensorVersion() const { return (sensorVersion_); }
   const std::string & getFromFile() const { return (fromFile_); }
   const std::string & getEncodingFormat() const { return (encodingFormat_); }
+  const std::string & getSourceType() const { return (sourceType_); }
+  // true if connected to a camera, i.e. not playing from file or synthetic
+  bool isLiveCamera() const { return (fromFile_.empty() && sourceType_ == "camera"); }
 
   void setSerialNumber(const std::string & sn) { serialNumber_ = sn; }
   void setFromFile(const std::string & f) { fromFile_ = f; }
+  // source type is "camera" (also used for file playback) or "synthetic"
+  void setSourceType(const std::string & s) { sourceType_ = s; }
+  void setRequestedEncoding(const std::string & e) { requestedEncoding_ = e; }
+  void setSyntheticConfig(const SyntheticConfig & c) { syntheticConfig_ = c; }
+  // use an externally created source instead, e.g. for benchmarking
+  void setEventSource(const std::shared_ptr<EventSource> & s) { source_ = s; }
+  void setUseNativeFileReader(bool b) { useNativeFileReader_ = b; }
+  // how long to keep retrying to open a live camera (sec)
+  void setOpenTimeout(double sec) { openTimeout_ = sec; }
+  // start and end time (sensor time in sec) for playback from file, negative = not set
+  void setFileTimeRange(double startTime, double endTime);
+  bool seek(double sensorTime);
   void setSyncMode(const std::string & sm) { syncMode_ = sm; }
   bool startCamera(CallbackHandler * h);
   void setLoggerName(const std::string & s) { loggerName_ = s; }
+  // no statistics thread is started if the interval is <= 0
   void setStatisticsInterval(double sec) { statsInterval_ = sec; }
+  // statistics are written to the log unless disabled here
+  void setStatisticsLogging(bool b) { statsLogging_ = b; }
+  // called by the statistics thread every interval
+  void setStatisticsCallback(const std::function<void(const StatsReport &)> & cb)
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    statsCallback_ = cb;
+  }
+  // returns the counters since the last call and resets them
+  Stats takeStatistics();
+  // mode is one of "none", "malloc", "thp", "hugetlb"
+  void setBufferPool(const std::string & mode, size_t blockSize, size_t numBlocks)
+  {
+    bufferPoolMode_ = mode;
+    bufferPoolBlockSize_ = blockSize;
+    bufferPoolNumBlocks_ = numBlocks;
+  }
+  void setHeapPrefaultSize(size_t n) { heapPrefaultSize_ = n; }
+  // raise the malloc mmap and trim thresholds for the whole process
+  void setTuneHeap(bool b) { tuneHeap_ = b; }
+  // largest step (usec) of the sensor time between buffers that is not
+  // reported as lost data, 0 disables the check (EVT3 live camera only)
+  void setTimeGapThreshold(uint64_t usec) { timeGapThreshold_ = usec; }
+  // thread is one of "processing", "stats", "source"
+  void setThreadConfig(const std::string & thread, const ThreadConfig & c)
+  {
+    threadConfig_[thread] = c;
+  }
 
   // ROI is a double vector with length multiple of 4:
   // (x_top_1, y_top_1, width_1, height_1,
@@ -123,7 +240,26 @@ public:
     ercRate_ = rate;
   }
   void setMIPIFramePeriod(int usec) { mipiFramePeriod_ = usec; }
+  // reopen a live camera after a runtime error, e.g. USB disconnect
+  void setReconnect(bool b) { reconnect_ = b; }
+  size_t getNumReconnects() const { return (numReconnects_); }
+  int64_t getLastReconnectTime() const { return (lastReconnectTime_); }  // msec
   void setTrailFilter(const std::string & type, const uint32_t threshold, const bool state);
+  // Runtime changes that are applied to the hardware while streaming. On
+  // failure nothing is changed and msg holds the reason, on success it
+  // holds the time the hardware took to apply the change.
+  bool updateROI(const std::vector<int> & roi, std::string * msg);
+  bool updateEventRateController(const std::string & mode, const int rate, std::string * msg);
+  bool updateTrailFilter(
+    const std::string & type, const uint32_t threshold, const bool state, std::string * msg);
+  // check the settings without touching the hardware
+  bool checkROI(const std::vector<int> & roi, std::string * msg) const;
+  bool checkEventRateController(const std::string & mode, const int rate, std::string * msg) const;
+  bool checkTrailFilter(const std::string & type, const bool state, std::string * msg) const;
+  const std::vector<int> & getROI() const { return (roi_); }
+  const std::string & getEventRateControllerMode() const { return (ercMode_); }
+  int getEventRateControllerRate() const { return (ercRate_); }
+  const TrailFilter & getTrailFilter() const { return (trailFilter_); }
 
   bool triggerActive() const
   {
@@ -134,6 +270,13 @@ public:
 
 private:
   bool initializeCamera();
+  bool initializeSource();
+  template <class T>
+  T * getFacility()
+  {
+    // facilities are only available when there is an SDK camera
+    return (cam_ ? cam_->get_device().get_facility<T>() : nullptr);
+  }
   void runtimeErrorCallback(const Metavision::CameraException & e);
   void statusChangeCallback(const Metavision::CameraStatus & s);
 
@@ -144,25 +287,45 @@ private:
     const Metavision::EventExtTrigger * start, const Metavision::EventExtTrigger * end);
 
   void processingThread();
+  void configureThread(const std::string & thread, const std::string & name);
+  void configureMemory();
+  void prefaultHeap();
   void statsThread();
-  void applyROI(const std::vector<int> & roi);
+  bool applyROI(const std::vector<int> & roi);
   void applySyncMode(const std::string & mode);
   void configureExternalTriggers(
     const std::string & mode_in, const std::string & mode_out, const int period,
     const double duty_cycle);
   void configureEventRateController(const std::string & mode, const int rate);
-  void activateTrailFilter();
+  bool activateTrailFilter();
+  bool reportUpdate(
+    const std::string & what, bool success, const std::chrono::steady_clock::time_point & t0,
+    std::string * msg);
   void configureMIPIFramePeriod(int usec, const std::string & sensorName);
   void printStatistics();
+  StatsReport makeStatsReport();
+  void recordLatency(uint64_t t);
+  evt3::TimeGapDetector::Result checkTimeContinuity(
+    const uint8_t * data, size_t size, uint64_t * lostTime);
+  static constexpr size_t MAX_LATENCY_SAMPLES = 4096;
+  void removeCameraCallbacks();
+  void refreshBiasCache();
+  bool startSource();
+  void reconnectThread();
+  bool reconnect();
+  // lock on cameraMutex_, not owning it while the camera is reconnecting
+  std::unique_lock<std::mutex> lockCamera();
+  void logTimeToFirstData();
+  void sourceThreadStarted();
+  static int64_t millisecondsSince(const std::chrono::steady_clock::time_point & t);
   // ------------ variables
   CallbackHandler * callbackHandler_{0};
-  Metavision::Camera cam_;
+  std::shared_ptr<EventSource> source_;
+  Metavision::Camera * cam_{nullptr};  // owned by source, null if there is no SDK camera
   Metavision::CallbackId statusChangeCallbackId_;
   bool statusChangeCallbackActive_{false};
   Metavision::CallbackId runtimeErrorCallbackId_;
   bool runtimeErrorCallbackActive_{false};
-  Metavision::CallbackId rawDataCallbackId_;
-  bool rawDataCallbackActive_{false};
   Metavision::CallbackId contrastCallbackId_;
   bool contrastCallbackActive_{false};
   Metavision::CallbackId extTriggerCallbackId_;
@@ -172,6 +335,13 @@ private:
   std::string biasFile_;
   std::string serialNumber_;
   std::string fromFile_;
+  bool useNativeFileReader_{true};
+  double openTimeout_{5.0};
+  int64_t fileStartTime_{-1};  // in usec
+  int64_t fileEndTime_{-1};    // in usec
+  std::string sourceType_{"camera"};
+  std::string requestedEncoding_;  // data format to request from the camera
+  SyntheticConfig syntheticConfig_;
   std::string softwareInfo_;
   std::string syncMode_;
   std::string triggerInMode_;   // disabled, enabled, loopback
@@ -187,10 +357,50 @@ private:
   std::vector<int> roi_;
   std::string encodingFormat_{"unknown"};
   std::string sensorVersion_{"0.0"};
+  std::string sensorName_;
+  std::map<std::string, ThreadConfig> threadConfig_;
+  // -- related to memory allocation
+  std::string bufferPoolMode_{"none"};
+  size_t bufferPoolBlockSize_{1 << 20};
+  size_t bufferPoolNumBlocks_{32};
+  size_t heapPrefaultSize_{16 << 20};
+  bool tuneHeap_{false};
+  std::shared_ptr<BufferPool> bufferPool_;
+  long lastPageFaults_{0};  // NOLINT (type defined by rusage)
+  // --  related to startup timing
+  std::chrono::steady_clock::time_point initStartTime_;
+  std::chrono::steady_clock::time_point cameraStartTime_;
+  bool hasReceivedData_{false};  // only accessed by source thread after start
+  // --  related to detecting lost data
+  uint64_t timeGapThreshold_{10000};  // usec
+  // only accessed by source thread after start
+  std::unique_ptr<evt3::TimeGapDetector> timeGapDetector_;
+  // --  related to reconnecting a lost camera
+  bool reconnect_{true};
+  std::mutex cameraMutex_;  // held while cam_ and source_ are used or replaced
+  std::atomic<bool> reconnecting_{false};  // set for the duration of reconnect()
+  std::shared_ptr<std::thread> reconnectThread_;
+  std::condition_variable reconnectCv_;  // uses mutex_
+  bool keepReconnecting_{false};         // protected by mutex_
+  bool deviceLost_{false};               // protected by mutex_
+  bool restartPending_{false};           // only accessed by source thread after start
+  bool decodingEvents_{false};
+  std::atomic<size_t> numReconnects_{0};
+  std::atomic<int64_t> lastReconnectTime_{0};  // msec
+  std::mutex biasCacheMutex_;
+  std::map<std::string, int> biasCache_;  // all biases, updated on write, restored on reconnect
   // --  related to statistics
   double statsInterval_{2.0};  // time between printouts
   std::chrono::time_point<std::chrono::system_clock> lastPrintTime_;
   Stats stats_;
+  std::vector<std::function<std::string()>> statsReporters_;
+  std::function<void(const StatsReport &)> statsCallback_;
+  bool statsLogging_{true};
+  std::vector<uint32_t> latencies_;  // usec, ring buffer of most recent
+  size_t numLatencies_{0};
+  double lastCpuTime_{0};  // sec of user + system time
+  ThreadCpuMonitor threadCpuMonitor_;
+  std::atomic<bool> trimHeap_{false};
   std::mutex statsMutex_;
   std::shared_ptr<std::thread> statsThread_;
 
@@ -0,0 +1,117 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__MULTI_DRIVER_ROS2_H_
+#define METAVISION_DRIVER__MULTI_DRIVER_ROS2_H_
+
+#include <atomic>
+#include <chrono>
+#include <event_camera_msgs/msg/event_packet.hpp>
+#include <memory>
+#include <rclcpp/rclcpp.hpp>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/callback_handler.h"
+#include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/msg/event_packet_info.hpp"
+#include "metavision_driver/msg/ext_trigger.hpp"
+#include "metavision_driver/packet_sizer.h"
+#include "metavision_driver/raw_scanner.h"
+#include "metavision_driver/reserve_policy.h"
+#include "metavision_driver/ros_time_keeper.h"
+#include "metavision_driver/strand_pool.h"
+
+namespace metavision_driver
+{
+//
+// Drives several cameras from one component. Each camera only has its
+// SDK source thread, which assembles the event messages. Publishing of
+// the completed messages happens on a pool of threads shared by all
+// cameras, with one strand per camera to keep the messages in order.
+//
+class MultiDriverROS2 : public rclcpp::Node
+{
+  using EventPacketMsg = event_camera_msgs::msg::EventPacket;
+  using ExtTriggerMsg = msg::ExtTrigger;
+  using EventPacketInfoMsg = msg::EventPacketInfo;
+
+public:
+  explicit MultiDriverROS2(const rclcpp::NodeOptions & options);
+  ~MultiDriverROS2();
+
+private:
+  class Camera : public CallbackHandler
+  {
+  public:
+    Camera(MultiDriverROS2 * driver, const std::string & name);
+    // ---------------- inherited from CallbackHandler -----------
+    void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override;
+    void eventCDCallback(
+      uint64_t t, const Metavision::EventCD * begin, const Metavision::EventCD * end) override;
+    void sourceRestarted() override;
+    void sensorTimeGap(uint64_t lostTime, bool isReset) override;
+    // ---------------- end of inherited  -----------
+    void initialize();
+    void start();
+    void stop();
+    const std::string & getName() const { return (name_); }
+    const std::string & getSyncMode() const { return (wrapper_->getSyncMode()); }
+    void setSyncMode(const std::string & mode) { wrapper_->setSyncMode(mode); }
+    MetavisionWrapper::Stats takeStatistics() { return (wrapper_->takeStatistics()); }
+    std::vector<std::string> getStatsReport();
+    bool takeTrimRequest() { return (trimHeap_.exchange(false)); }
+
+  private:
+    void publishTriggers(uint64_t t);
+    void resetSensorTime();
+    void sendMessage(uint64_t t);
+    void flushMessage();
+    EventPacketInfoMsg::UniquePtr makePacketInfo() const;
+    // ------------ variables
+    MultiDriverROS2 * driver_{nullptr};
+    std::string name_;
+    std::string loggerName_;
+    std::shared_ptr<MetavisionWrapper> wrapper_;
+    int strand_{0};
+    int width_{0};
+    int height_{0};
+    std::string frameId_;
+    std::string encoding_;
+    uint64_t seq_{0};
+    ReservePolicy reservePolicy_;
+    PacketSizer packetSizer_;
+    EventPacketMsg::UniquePtr msg_;
+    rclcpp::Publisher<EventPacketMsg>::SharedPtr eventPub_;
+    std::shared_ptr<RawScanner> scanner_;
+    bool scanPaused_{false};  // some data was not scanned
+    PacketInfo packetInfo_;
+    uint64_t lostTime_{0};  // usec, since last message was sent
+    bool timeReset_{false};
+    rclcpp::Publisher<EventPacketInfoMsg>::SharedPtr infoPub_;
+    std::vector<TriggerEvent> triggers_;
+    std::shared_ptr<ROSTimeKeeper> timeKeeper_;
+    rclcpp::Publisher<ExtTriggerMsg>::SharedPtr triggerPub_;
+    std::atomic<bool> trimHeap_{false};
+  };
+
+  void printStatistics();
+  // ------------------------  variables ------------------------------
+  std::shared_ptr<StrandPool> pool_;
+  std::vector<std::unique_ptr<Camera>> cameras_;
+  rclcpp::TimerBase::SharedPtr statsTimer_;
+  std::chrono::steady_clock::time_point lastPrintTime_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__MULTI_DRIVER_ROS2_H_
@@ -0,0 +1,318 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__ORDERED_WORKER_POOL_H_
+#define METAVISION_DRIVER__ORDERED_WORKER_POOL_H_
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/logging.h"
+#include "metavision_driver/thread_config.h"
+
+namespace metavision_driver
+{
+//
+// Runs a processing function on jobs in parallel and hands the
+// processed jobs to an emit function strictly in submission order.
+// Each worker has its own queue, idle workers steal from the others.
+// The number of jobs queued, processing or waiting to be emitted is
+// bounded, submit() drops the job beyond that. stop() processes and
+// emits the jobs already submitted before the workers exit.
+//
+template <class Job>
+class OrderedWorkerPool
+{
+public:
+  using ProcessFunc = std::function<void(int worker, Job * job)>;  // called in parallel
+  using EmitFunc = std::function<void(Job * job)>;                 // called in order
+  struct Stats
+  {
+    size_t numProcessed{0};
+    size_t numDropped{0};
+    size_t maxInFlight{0};
+    uint64_t queueTime{0};    // nsec wall time from submit to start of processing
+    uint64_t processTime{0};  // nsec wall time processing
+    uint64_t processCpuTime{0};
+    uint64_t reorderTime{0};  // nsec wall time waiting for earlier jobs
+    uint64_t emitTime{0};     // nsec wall time in emit function
+  };
+
+  OrderedWorkerPool(
+    const std::string & loggerName, const std::string & name, int numThreads, size_t maxInFlight)
+  : loggerName_(loggerName),
+    name_(name),
+    numThreads_(std::max(numThreads, 1)),
+    maxInFlight_(std::max(maxInFlight, static_cast<size_t>(1)))
+  {
+    for (int i = 0; i < numThreads_; i++) {
+      queues_.emplace_back(new WorkerQueue());
+    }
+  }
+  ~OrderedWorkerPool() { stop(); }
+
+  void start(const ProcessFunc & process, const EmitFunc & emit, const ThreadConfig & config)
+  {
+    process_ = process;
+    emit_ = emit;
+    threadConfig_ = config;
+    lastReportTime_ = Clock::now();
+    keepRunning_ = true;
+    for (int i = 0; i < numThreads_; i++) {
+      threads_.emplace_back(&OrderedWorkerPool::workerThread, this, i);
+    }
+  }
+
+  void stop()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepRunning_ = false;
+      cv_.notify_all();
+    }
+    for (auto & th : threads_) {
+      th.join();
+    }
+    threads_.clear();
+    // without workers (never started) the remaining jobs cannot be emitted
+    size_t numLeft = 0;
+    for (auto & q : queues_) {
+      std::unique_lock<std::mutex> qlock(q->mutex);
+      numLeft += q->tasks.size();
+      q->tasks.clear();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    numLeft += done_.size();
+    done_.clear();
+    numQueued_ = 0;
+    nextOut_ = nextIn_;
+    if (numLeft > 0) {
+      std::unique_lock<std::mutex> statsLock(statsMutex_);
+      stats_.numDropped += numLeft;
+    }
+  }
+
+  // returns false if the job was dropped because too many are in flight
+  bool submit(std::unique_ptr<Job> job)
+  {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const size_t inFlight = nextIn_ - nextOut_;
+      if (inFlight >= maxInFlight_) {
+        std::unique_lock<std::mutex> statsLock(statsMutex_);
+        stats_.numDropped++;
+        return (false);
+      }
+      task.ticket = nextIn_++;
+      std::unique_lock<std::mutex> statsLock(statsMutex_);
+      stats_.maxInFlight = std::max(stats_.maxInFlight, inFlight + 1);
+    }
+    task.submitTime = Clock::now();
+    task.job = std::move(job);
+    WorkerQueue & q = *queues_[task.ticket % numThreads_];
+    std::unique_lock<std::mutex> qlock(q.mutex);
+    q.tasks.push_back(std::move(task));
+    std::unique_lock<std::mutex> lock(mutex_);
+    numQueued_++;
+    cv_.notify_one();
+    return (true);
+  }
+
+  // returns statistics since last call
+  Stats getStats()
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    Stats s = stats_;
+    stats_ = Stats();
+    return (s);
+  }
+
+  // one line summary of getStats() with average times per job in msec
+  std::string getStatsReport()
+  {
+    const Stats s = getStats();
+    const auto now = Clock::now();
+    const double dt = std::chrono::duration<double>(now - lastReportTime_).count();
+    lastReportTime_ = now;
+    if (s.numProcessed == 0 && s.numDropped == 0) {
+      return (std::string());
+    }
+    const double f = s.numProcessed > 0 ? 1e-6 / s.numProcessed : 0;
+    const double cpuLoad = dt > 0 ? 1e-7 * s.processCpuTime / dt : 0;  // percent of one core
+    char buf[256];
+    snprintf(
+      buf, sizeof(buf),
+      "%s: jobs: %5zu, drop: %4zu, inflight: %3zu, queue: %6.2fms, proc: %6.2fms, "
+      "reorder: %6.2fms, emit: %6.2fms, cpu: %6.1f%%",
+      name_.c_str(), s.numProcessed, s.numDropped, s.maxInFlight, s.queueTime * f,
+      s.processTime * f, s.reorderTime * f, s.emitTime * f, cpuLoad);
+    return (std::string(buf));
+  }
+  int getNumThreads() const { return (numThreads_); }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Task
+  {
+    uint64_t ticket{0};
+    Clock::time_point submitTime;
+    Clock::time_point doneTime;
+    std::unique_ptr<Job> job;
+  };
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  static uint64_t threadCpuTime()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  static uint64_t toNsec(Clock::duration d)
+  {
+    return (std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+  }
+
+  bool popTask(int id, Task * task)
+  {
+    // own queue first (oldest job), then steal the newest job of others
+    for (int i = 0; i < numThreads_; i++) {
+      WorkerQueue & q = *queues_[(id + i) % numThreads_];
+      std::unique_lock<std::mutex> qlock(q.mutex);
+      if (!q.tasks.empty()) {
+        if (i == 0) {
+          *task = std::move(q.tasks.front());
+          q.tasks.pop_front();
+        } else {
+          *task = std::move(q.tasks.back());
+          q.tasks.pop_back();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        numQueued_--;
+        return (true);
+      }
+    }
+    return (false);
+  }
+
+  void workerThread(int id)
+  {
+    std::string report;
+    if (threadConfig_.apply(name_ + "_" + std::to_string(id), &report)) {
+      LOG_INFO_NAMED(report);
+    } else {
+      LOG_WARN_NAMED(report);
+    }
+    while (true) {
+      Task task;
+      if (!popTask(id, &task)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return (!keepRunning_ || numQueued_ > 0); });
+        if (!keepRunning_ && numQueued_ == 0) {
+          break;  // drained, jobs still processing are emitted by their workers
+        }
+        continue;
+      }
+      const auto t0 = Clock::now();
+      const uint64_t cpu0 = threadCpuTime();
+      process_(id, task.job.get());
+      const uint64_t cpuTime = threadCpuTime() - cpu0;
+      task.doneTime = Clock::now();
+      {
+        std::unique_lock<std::mutex> statsLock(statsMutex_);
+        stats_.numProcessed++;
+        stats_.queueTime += toNsec(t0 - task.submitTime);
+        stats_.processTime += toNsec(task.doneTime - t0);
+        stats_.processCpuTime += cpuTime;
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const uint64_t ticket = task.ticket;
+        done_.emplace(ticket, std::move(task));
+      }
+      emitCompleted();
+    }
+    LOG_INFO_NAMED(name_ << " thread " << id << " exited!");
+  }
+
+  void emitCompleted()
+  {
+    // only one thread emits at a time, and always the oldest job first
+    std::unique_lock<std::mutex> emitLock(emitMutex_);
+    while (true) {
+      Task task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = done_.find(nextOut_);
+        if (it == done_.end()) {
+          break;
+        }
+        task = std::move(it->second);
+        done_.erase(it);
+      }
+      const auto t0 = Clock::now();
+      emit_(task.job.get());
+      const auto t1 = Clock::now();
+      {
+        std::unique_lock<std::mutex> statsLock(statsMutex_);
+        stats_.reorderTime += toNsec(t0 - task.doneTime);
+        stats_.emitTime += toNsec(t1 - t0);
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      nextOut_++;
+    }
+  }
+
+  // ------------ variables
+  std::string loggerName_;
+  std::string name_;
+  int numThreads_{1};
+  size_t maxInFlight_{16};
+  ProcessFunc process_;
+  EmitFunc emit_;
+  ThreadConfig threadConfig_;
+  std::vector<std::thread> threads_;
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::mutex mutex_;  // protects the variables below
+  std::condition_variable cv_;
+  bool keepRunning_{false};
+  size_t numQueued_{0};  // jobs waiting in worker queues
+  uint64_t nextIn_{0};   // ticket of next job submitted
+  uint64_t nextOut_{0};  // ticket of next job to emit
+  std::map<uint64_t, Task> done_;
+  std::mutex emitMutex_;
+  std::mutex statsMutex_;
+  Stats stats_;
+  Clock::time_point lastReportTime_;  // only used by getStatsReport()
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__ORDERED_WORKER_POOL_H_
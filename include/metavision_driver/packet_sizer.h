@@ -0,0 +1,147 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__PACKET_SIZER_H_
+#define METAVISION_DRIVER__PACKET_SIZER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "metavision_driver/raw_scanner.h"
+
+namespace metavision_driver
+{
+//
+// Decides when the event message being assembled is complete. A message
+// is sent when any of the configured thresholds is reached. In adaptive
+// mode the event count threshold is adjusted such that the message rate
+// stays within [minRate, maxRate], and the time threshold is set to
+// 1 / minRate to bound the latency for static scenes.
+//
+class PacketSizer
+{
+public:
+  struct Config
+  {
+    uint64_t timeThreshold{1000000};   // nsec of ROS time
+    size_t sizeThreshold{1000000000};  // bytes
+    uint64_t eventThreshold{0};        // number of CD events, 0 = disabled
+    uint64_t sensorTimeThreshold{0};   // usec of sensor time, 0 = disabled
+    double minRate{0};                 // adaptive mode band (msgs/sec)
+    double maxRate{0};                 // 0 = no adaptive mode
+  };
+  PacketSizer() = default;
+  explicit PacketSizer(const Config & config) { setConfig(config); }
+
+  void setConfig(const Config & config)
+  {
+    config_ = config;
+    timeThreshold_ = config.timeThreshold;
+    eventThreshold_ = config.eventThreshold;
+    if (isAdaptive()) {
+      if (config.minRate > 0) {
+        timeThreshold_ = static_cast<uint64_t>(1e9 / config.minRate);
+      }
+      if (eventThreshold_ == 0) {
+        eventThreshold_ = 1;  // will grow when the rate exceeds the band
+      }
+    }
+  }
+
+  // true if the message should be sent now
+  inline bool isComplete(uint64_t t, size_t numBytes, const PacketInfo & info) const
+  {
+    const uint64_t eventThreshold = eventThreshold_.load(std::memory_order_relaxed);
+    return (
+      t - lastMessageTime_ > timeThreshold_ || numBytes > config_.sizeThreshold ||
+      (eventThreshold != 0 && info.numEvents >= eventThreshold) ||
+      (config_.sensorTimeThreshold != 0 && info.hasStartTime &&
+       info.lastTime - info.startTime >= config_.sensorTimeThreshold));
+  }
+
+  // must be called when a message has been sent at ROS time t (nsec)
+  void messageSent(uint64_t t, uint64_t numEvents)
+  {
+    lastMessageTime_ = t;
+    if (!isAdaptive()) {
+      return;
+    }
+    if (t - windowStart_ > 5 * WINDOW_LENGTH) {
+      resetWindow(t);  // no messages sent for a while, start over
+      return;
+    }
+    windowMessages_++;
+    windowEvents_ += numEvents;
+    if (t - windowStart_ >= WINDOW_LENGTH) {
+      adapt(t);
+    }
+  }
+
+  bool isAdaptive() const { return (config_.maxRate > 0); }
+  // current event count threshold, may be called from any thread
+  uint64_t getEventThreshold() const { return (eventThreshold_.load(std::memory_order_relaxed)); }
+  // message rate measured over the last window (only in adaptive mode)
+  double getMessageRate() const { return (messageRate_.load(std::memory_order_relaxed)); }
+  std::string getStatsReport() const
+  {
+    char buf[128];
+    snprintf(
+      buf, sizeof(buf), "packet sizer: msgs/s: %8.1f, events/msg threshold: %9lu",
+      getMessageRate(), static_cast<unsigned long>(getEventThreshold()));  // NOLINT
+    return (std::string(buf));
+  }
+
+private:
+  static constexpr uint64_t WINDOW_LENGTH = 500000000ULL;  // nsec
+
+  void resetWindow(uint64_t t)
+  {
+    windowStart_ = t;
+    windowMessages_ = 0;
+    windowEvents_ = 0;
+  }
+
+  void adapt(uint64_t t)
+  {
+    const double dt = 1e-9 * (t - windowStart_);
+    const double msgRate = windowMessages_ / dt;
+    const double eventRate = windowEvents_ / dt;
+    messageRate_.store(msgRate, std::memory_order_relaxed);
+    // only change the threshold when leaving the band (hysteresis)
+    if (msgRate > config_.maxRate || msgRate < config_.minRate) {
+      const double target = config_.minRate > 0 ? std::sqrt(config_.minRate * config_.maxRate)
+                                                : 0.5 * config_.maxRate;
+      const uint64_t n = static_cast<uint64_t>(eventRate / target);
+      eventThreshold_.store(std::max(n, static_cast<uint64_t>(1)), std::memory_order_relaxed);
+    }
+    resetWindow(t);
+  }
+
+  // ------------ variables
+  Config config_;
+  uint64_t timeThreshold_{1000000};
+  std::atomic<uint64_t> eventThreshold_{0};
+  std::atomic<double> messageRate_{0};
+  uint64_t lastMessageTime_{0};
+  uint64_t windowStart_{0};
+  uint64_t windowMessages_{0};
+  uint64_t windowEvents_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__PACKET_SIZER_H_
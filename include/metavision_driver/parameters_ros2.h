@@ -0,0 +1,58 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__PARAMETERS_ROS2_H_
+#define METAVISION_DRIVER__PARAMETERS_ROS2_H_
+
+#include <rclcpp/rclcpp.hpp>
+#include <string>
+
+#include "metavision_driver/bias_controller.h"
+#include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/packet_sizer.h"
+#include "metavision_driver/reserve_policy.h"
+#include "metavision_driver/thread_config.h"
+
+namespace metavision_driver
+{
+//
+// Parameter handling shared by the single and multi camera drivers.
+// Camera specific parameters are looked up as "<camera>.<name>" first
+// and then as "<name>", so the multi camera driver can set defaults for
+// all cameras and override them per camera. An empty camera name means
+// the plain parameter name is used.
+//
+template <class T>
+void get_camera_parameter(
+  rclcpp::Node * node, const std::string & camera, const std::string & name, T * value,
+  const T & def)
+{
+  if (!camera.empty() && node->get_parameter(camera + "." + name, *value)) {
+    return;
+  }
+  node->get_parameter_or(name, *value, def);
+}
+
+MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(rclcpp::Node * node);
+// reads <prefix>_cpus, <prefix>_policy, <prefix>_priority
+ThreadConfig get_thread_config(
+  rclcpp::Node * node, const std::string & prefix, const std::string & camera = std::string());
+PacketSizer::Config get_packet_sizer_config(rclcpp::Node * node, const std::string & camera);
+ReservePolicy::Config get_reserve_policy_config(rclcpp::Node * node, const std::string & camera);
+BiasController::Config get_bias_controller_config(rclcpp::Node * node, const std::string & camera);
+// sets everything on the wrapper that must be known before initialize()
+void configure_wrapper(
+  rclcpp::Node * node, const std::string & camera, MetavisionWrapper * wrapper);
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__PARAMETERS_ROS2_H_
@@ -0,0 +1,87 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__PREVIEW_RENDERER_H_
+#define METAVISION_DRIVER__PREVIEW_RENDERER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+
+namespace metavision_driver
+{
+//
+// Renders a low rate mono8 preview image from the raw data. The raw
+// data is only copied in addData(), decoding and rendering happens in
+// render(), which is meant to be called from a timer thread. To bound
+// the work per call, render() only decodes the most recent data, and
+// the decoder starts over after the skipped part.
+//
+class PreviewRenderer
+{
+public:
+  // mode: "count" (event count per pixel) or "time_surface" (decay in sec)
+  PreviewRenderer(
+    const std::string & encoding, int width, int height, const std::string & mode, double decay);
+  void addData(const uint8_t * start, const uint8_t * end);
+  // the sensor time starts over with the next data added
+  void resetTime();
+  // returns false if no events arrived since the last call
+  bool render(std::vector<uint8_t> * image);
+  // bytes of raw data not decoded since the last call
+  size_t takeSkippedBytes() { return (skippedBytes_.exchange(0)); }
+  int getWidth() const { return (width_); }
+  int getHeight() const { return (height_); }
+
+  // ---------- callbacks from the decoder
+  inline void eventCD(uint64_t t, uint16_t x, uint16_t y, uint8_t)
+  {
+    if (x < width_ && y < height_) {
+      const size_t idx = y * width_ + x;
+      counts_[idx]++;  // 32 bits, cannot wrap between two render() calls
+      // truncated to 32 bits, differences are still correct across wrap
+      lastTime_[idx] = static_cast<uint32_t>(t);
+    }
+  }
+  inline void eventExtTrigger(uint64_t, uint8_t, uint8_t) {}
+
+private:
+  static constexpr size_t NO_RESET = static_cast<size_t>(-1);
+  void decode(const uint8_t * start, const uint8_t * end, bool resetDecoder);
+  void renderCount(std::vector<uint8_t> * image);
+  void renderTimeSurface(std::vector<uint8_t> * image);
+  // ------------ variables
+  int width_{0};
+  int height_{0};
+  bool isTimeSurface_{false};
+  uint32_t decay_{30000};  // in usec
+  std::mutex mutex_;
+  std::vector<uint8_t> buffer_;  // raw data received, protected by mutex
+  size_t resetOffset_{NO_RESET};  // where in buffer_ the time starts over
+  bool restartDecoder_{false};    // buffer_ does not continue the decoded data
+  std::vector<uint8_t> decodeBuffer_;
+  std::string encoding_;
+  std::unique_ptr<EventDecoder<PreviewRenderer>> decoder_;
+  std::atomic<size_t> skippedBytes_{0};
+  std::vector<uint32_t> counts_;
+  std::vector<uint32_t> lastTime_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__PREVIEW_RENDERER_H_
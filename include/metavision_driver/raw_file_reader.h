@@ -0,0 +1,93 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__RAW_FILE_READER_H_
+#define METAVISION_DRIVER__RAW_FILE_READER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/event_source.h"
+
+namespace metavision_driver
+{
+//
+// Plays back EVT2, EVT2.1 or EVT3 data from a Metavision .raw file. The
+// file is memory mapped and the callback gets pointers into the mapping,
+// so the reader itself does not copy (the callback still may). An
+// index of the TIME_HIGH words is kept in a sidecar file (<file>.mvidx)
+// such that seeking to a sensor time is a binary search.
+//
+class RawFileReader : public EventSource
+{
+public:
+  struct IndexEntry
+  {
+    uint64_t time;    // sensor time in usec
+    uint64_t offset;  // byte offset into file
+  };
+
+  RawFileReader(const std::string & loggerName, const std::string & fileName);
+  ~RawFileReader();
+
+  // ---------------- inherited from EventSource -----------
+  bool open() override;
+  bool start(const Callback & cb) override;
+  bool stop() override;
+  bool seek(uint64_t sensorTime) override;
+  // ---------------- end of inherited  -----------
+
+  void close();
+  // times are sensor time in usec, negative values mean "not set"
+  void setTimeRange(int64_t startTime, int64_t endTime);
+  uint64_t getFirstTime() const { return (index_.empty() ? 0 : index_.front().time); }
+  uint64_t getLastTime() const { return (index_.empty() ? 0 : index_.back().time); }
+
+private:
+  bool parseHeader();
+  bool loadIndex(const std::string & indexFile);
+  void buildIndex();
+  template <class TimeHighScanner>
+  void scanTimeHigh();
+  void saveIndex(const std::string & indexFile) const;
+  size_t findIndex(uint64_t sensorTime) const;
+  void playbackThread();
+  // ------------ variables
+  std::string fileName_;
+  int fd_{-1};
+  const uint8_t * data_{nullptr};  // start of memory mapped file
+  size_t fileSize_{0};
+  size_t dataStart_{0};  // first byte after header
+  size_t wordSize_{2};   // bytes per word of the encoding
+  std::vector<IndexEntry> index_;
+  int64_t startTime_{-1};
+  int64_t endTime_{-1};
+  Callback callback_;
+  // -------- related to playback thread
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t nextIndex_{0};  // index entry where playback continues
+  bool seekRequested_{false};
+  bool keepRunning_{false};
+  std::shared_ptr<std::thread> thread_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__RAW_FILE_READER_H_
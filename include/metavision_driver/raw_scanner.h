@@ -0,0 +1,102 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__RAW_SCANNER_H_
+#define METAVISION_DRIVER__RAW_SCANNER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+
+namespace metavision_driver
+{
+struct TriggerEvent
+{
+  TriggerEvent(uint64_t t, uint8_t i, bool p) : time(t), id(i), polarity(p) {}
+  uint64_t time;  // sensor time in usec
+  uint8_t id;
+  bool polarity;
+};
+
+// sensor time metadata of an event packet, all times in usec
+struct PacketInfo
+{
+  uint64_t startTime{0};  // sensor time at start of packet
+  uint64_t firstTime{0};  // time of first CD event
+  uint64_t lastTime{0};   // time of last CD event
+  uint64_t numEvents{0};  // number of CD events
+  bool hasStartTime{false};
+};
+
+//
+// Scans the raw stream once for the external trigger events and the
+// packet metadata. Decoder state carries over from one scan to the next.
+//
+class RawScanner
+{
+public:
+  explicit RawScanner(const std::string & encoding)
+  : decoder_(make_decoder<RawScanner>(encoding))
+  {
+  }
+  // appends triggers to trig and updates the packet info, both may be null
+  inline void scan(
+    const uint8_t * start, const uint8_t * end, std::vector<TriggerEvent> * trig,
+    PacketInfo * info)
+  {
+    if (info && !info->hasStartTime && decoder_->hasValidTime()) {
+      info->startTime = decoder_->getTime();
+      info->hasStartTime = true;
+    }
+    triggers_ = trig;
+    info_ = info;
+    decoder_->decode(start, end, this);
+  }
+  // sensor time (usec) at end of last scan
+  uint64_t getTime() const { return (decoder_->getTime()); }
+  bool hasValidTime() const { return (decoder_->hasValidTime()); }
+
+  // ---------- callbacks from the decoder
+  inline void eventCD(uint64_t t, uint16_t, uint16_t, uint8_t)
+  {
+    if (info_) {
+      if (info_->numEvents == 0) {
+        info_->firstTime = t;
+        if (!info_->hasStartTime) {
+          info_->startTime = t;
+          info_->hasStartTime = true;
+        }
+      }
+      info_->lastTime = t;
+      info_->numEvents++;
+    }
+  }
+  inline void eventExtTrigger(uint64_t t, uint8_t id, uint8_t p)
+  {
+    if (triggers_) {
+      triggers_->emplace_back(t, id, p != 0);
+    }
+  }
+
+private:
+  std::unique_ptr<EventDecoder<RawScanner>> decoder_;
+  std::vector<TriggerEvent> * triggers_{nullptr};
+  PacketInfo * info_{nullptr};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__RAW_SCANNER_H_
@@ -0,0 +1,125 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__RESERVE_POLICY_H_
+#define METAVISION_DRIVER__RESERVE_POLICY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Computes how much memory to reserve for the next message from a
+// percentile of the sizes of the most recent messages. A single burst
+// thus inflates the reservation only until it leaves the window.
+//
+class ReservePolicy
+{
+public:
+  struct Config
+  {
+    size_t window{256};       // number of recent messages considered
+    double percentile{0.95};  // fraction of messages that fit the reservation
+    size_t maxSize{0};        // hard cap in bytes, 0 = none
+  };
+  ReservePolicy() { setConfig(Config()); }
+  explicit ReservePolicy(const Config & config) { setConfig(config); }
+
+  void setConfig(const Config & config)
+  {
+    config_ = config;
+    config_.window = std::max(config.window, static_cast<size_t>(1));
+    config_.percentile = std::min(std::max(config.percentile, 0.0), 1.0);
+    sizes_.assign(config_.window, 0);
+    numSizes_ = 0;
+    reserveSize_ = 0;
+  }
+
+  // call when a message is complete, with its used and allocated bytes
+  inline void update(size_t used, size_t reserved)
+  {
+    sizes_[numSizes_ % sizes_.size()] = used;
+    numSizes_++;
+    bytesUsed_.fetch_add(used, std::memory_order_relaxed);
+    bytesReserved_.fetch_add(reserved, std::memory_order_relaxed);
+    // the percentile is expensive, don't recompute for every message
+    if (numSizes_ <= RECOMPUTE_INTERVAL || numSizes_ % RECOMPUTE_INTERVAL == 0) {
+      recompute();
+    }
+  }
+
+  size_t getReserveSize() const { return (reserveSize_); }
+
+  // true once after the reservation dropped well below its peak, time
+  // to give the memory of the peak-sized messages back to the OS
+  bool takeTrimRequest()
+  {
+    if (peakSize_ > MIN_TRIM_SIZE && reserveSize_ * 4 < peakSize_) {
+      peakSize_ = reserveSize_;
+      return (true);
+    }
+    return (false);
+  }
+
+  // may be called from any thread, resets the byte counters
+  std::string getStatsReport()
+  {
+    const uint64_t used = bytesUsed_.exchange(0, std::memory_order_relaxed);
+    const uint64_t reserved = bytesReserved_.exchange(0, std::memory_order_relaxed);
+    char buf[128];
+    snprintf(
+      buf, sizeof(buf), "reserve: %8zu kB, msg bytes used/allocated: %6.1f%%",
+      reportedReserveSize_.load(std::memory_order_relaxed) / 1024,
+      reserved > 0 ? 100.0 * used / reserved : 100.0);
+    return (std::string(buf));
+  }
+
+private:
+  static constexpr uint64_t RECOMPUTE_INTERVAL = 32;
+  static constexpr size_t MIN_TRIM_SIZE = 1 << 20;
+
+  void recompute()
+  {
+    const size_t n = std::min(static_cast<size_t>(numSizes_), sizes_.size());
+    scratch_.assign(sizes_.begin(), sizes_.begin() + n);
+    const size_t k = std::min(static_cast<size_t>(config_.percentile * n), n - 1);
+    std::nth_element(scratch_.begin(), scratch_.begin() + k, scratch_.end());
+    reserveSize_ = scratch_[k];
+    if (config_.maxSize != 0) {
+      reserveSize_ = std::min(reserveSize_, config_.maxSize);
+    }
+    peakSize_ = std::max(peakSize_, reserveSize_);
+    reportedReserveSize_.store(reserveSize_, std::memory_order_relaxed);
+  }
+
+  // ------------ variables
+  Config config_;
+  std::vector<size_t> sizes_;  // ring buffer of recent message sizes
+  std::vector<size_t> scratch_;
+  uint64_t numSizes_{0};
+  size_t reserveSize_{0};
+  size_t peakSize_{0};  // largest reserve size since last trim
+  // ---- read by the statistics thread
+  std::atomic<size_t> reportedReserveSize_{0};
+  std::atomic<uint64_t> bytesUsed_{0};
+  std::atomic<uint64_t> bytesReserved_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__RESERVE_POLICY_H_
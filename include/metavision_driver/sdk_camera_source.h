@@ -0,0 +1,63 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SDK_CAMERA_SOURCE_H_
+#define METAVISION_DRIVER__SDK_CAMERA_SOURCE_H_
+
+#if METAVISION_VERSION < 5
+#include <metavision/sdk/driver/camera.h>
+#else
+#include <metavision/sdk/stream/camera.h>
+#endif
+
+#include <string>
+
+#include "metavision_driver/event_source.h"
+
+namespace metavision_driver
+{
+//
+// Event source backed by the Metavision SDK, either a
+// live camera or playback from file.
+//
+class SDKCameraSource : public EventSource
+{
+public:
+  // encoding: format to request from a live camera, empty = camera default
+  SDKCameraSource(
+    const std::string & loggerName, const std::string & serialNumber,
+    const std::string & fromFile, const std::string & encoding = std::string());
+  ~SDKCameraSource();
+  // how long open() keeps retrying a live camera (sec)
+  void setOpenTimeout(double sec) { openTimeout_ = sec; }
+
+  // ---------------- inherited from EventSource -----------
+  bool open() override;
+  bool start(const Callback & cb) override;
+  bool stop() override;
+  Metavision::Camera * getCamera() override { return (&cam_); }
+  bool ownsCallbackThread() const override { return (false); }
+  // ---------------- end of inherited  -----------
+
+private:
+  Metavision::Camera cam_;
+  std::string fromFile_;
+  std::string requestedEncoding_;
+  Metavision::CallbackId rawDataCallbackId_;
+  bool rawDataCallbackActive_{false};
+  double openTimeout_{5.0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SDK_CAMERA_SOURCE_H_
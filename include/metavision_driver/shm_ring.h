@@ -0,0 +1,145 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SHM_RING_H_
+#define METAVISION_DRIVER__SHM_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Shared memory ring for handing event packets to consumers on the
+// same host without serialization. The driver writes each packet into
+// the ring and publishes a notification message without payload. The
+// consumer uses the sequence number of the notification to look up the
+// packet in the ring. This header and shm_ring.cpp do not depend on ROS
+// and are installed as the metavision_driver_shm library.
+//
+// Memory layout: ShmRingHeader, numSlots * ShmRingSlot, data region.
+// The data region is addressed by a monotonically increasing byte
+// position, the physical offset is position % capacity. A packet whose
+// position is more than capacity bytes behind the write position has
+// been overwritten.
+//
+namespace metavision_driver
+{
+namespace shm_ring
+{
+static constexpr uint32_t MAGIC = 0x5253564D;  // "MVSR"
+static constexpr uint32_t VERSION = 2;
+static constexpr uint64_t INVALID_SEQ = ~static_cast<uint64_t>(0);
+
+struct Slot
+{
+  std::atomic<uint64_t> seq;  // INVALID_SEQ while being written
+  uint64_t pos;               // byte position of data
+  uint64_t size;              // number of bytes
+  uint64_t stamp;             // ROS time (nsec)
+  uint64_t timeBase;          // sensor time (nsec) at start of packet
+  uint64_t firstEventTime;    // sensor time (nsec)
+  uint64_t lastEventTime;     // sensor time (nsec)
+  uint64_t numEvents;
+};
+
+struct Header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;  // size of data region in bytes
+  uint64_t dataOffset;
+  uint32_t numSlots;
+  uint32_t width;
+  uint32_t height;
+  uint32_t isBigEndian;
+  char encoding[32];
+  std::atomic<uint64_t> writePos;  // end position of the data written so far
+  std::atomic<uint64_t> numWritten;
+};
+
+// packet metadata as passed to the writer and returned by the reader
+struct Record
+{
+  uint64_t seq{INVALID_SEQ};
+  uint64_t pos{0};  // set by the writer
+  uint64_t size{0};
+  uint64_t stamp{0};
+  uint64_t timeBase{0};
+  uint64_t firstEventTime{0};
+  uint64_t lastEventTime{0};
+  uint64_t numEvents{0};
+};
+}  // namespace shm_ring
+
+class ShmRingWriter
+{
+public:
+  ShmRingWriter() = default;
+  ~ShmRingWriter();
+  ShmRingWriter(const ShmRingWriter &) = delete;
+  ShmRingWriter & operator=(const ShmRingWriter &) = delete;
+  // name must start with '/', an existing ring of that name is replaced
+  bool create(
+    const std::string & name, size_t capacity, uint32_t numSlots, const std::string & encoding,
+    uint32_t width, uint32_t height, bool isBigEndian, std::string * error);
+  void close();
+  // writes rec.size bytes, returns false if the packet is larger than the ring
+  bool write(const shm_ring::Record & rec, const uint8_t * data);
+  const std::string & getName() const { return (name_); }
+
+private:
+  // ------------ variables
+  std::string name_;
+  shm_ring::Header * header_{nullptr};
+  shm_ring::Slot * slots_{nullptr};
+  uint8_t * data_{nullptr};
+  size_t mapSize_{0};
+};
+
+class ShmRingReader
+{
+public:
+  ShmRingReader() = default;
+  ~ShmRingReader();
+  ShmRingReader(const ShmRingReader &) = delete;
+  ShmRingReader & operator=(const ShmRingReader &) = delete;
+  bool open(const std::string & name, std::string * error);
+  void close();
+  bool isOpen() const { return (header_ != nullptr); }
+  // Zero copy access: returns a pointer into the ring, or nullptr if the
+  // packet is not (or no longer) in the ring. The writer may overwrite
+  // the data at any time, so call isValid() after consuming it.
+  const uint8_t * get(uint64_t seq, shm_ring::Record * rec) const;
+  // true if the data of rec has not been overwritten yet
+  bool isValid(const shm_ring::Record & rec) const;
+  // copies the packet, returns false if it is not (or no longer) available
+  bool read(uint64_t seq, shm_ring::Record * rec, std::vector<uint8_t> * data) const;
+  uint64_t getNumWritten() const;
+  std::string getEncoding() const;
+  uint32_t getWidth() const { return (header_->width); }
+  uint32_t getHeight() const { return (header_->height); }
+  bool isBigEndian() const { return (header_->isBigEndian != 0); }
+
+private:
+  // ------------ variables
+  const shm_ring::Header * header_{nullptr};
+  const shm_ring::Slot * slots_{nullptr};
+  const uint8_t * data_{nullptr};
+  size_t mapSize_{0};
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SHM_RING_H_
@@ -0,0 +1,252 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__STRAND_POOL_H_
+#define METAVISION_DRIVER__STRAND_POOL_H_
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/logging.h"
+#include "metavision_driver/thread_config.h"
+
+namespace metavision_driver
+{
+//
+// A fixed number of threads shared by several strands, e.g. one
+// strand per camera. Tasks of the same strand run one at a time and in
+// submission order, tasks of different strands run in parallel. Ready
+// strands are served round robin, one task at a time, so a busy
+// strand cannot starve the others. The queue of each strand is
+// bounded, submit() drops the task beyond that.
+//
+class StrandPool
+{
+public:
+  using Task = std::function<void()>;
+  struct Stats
+  {
+    size_t numRun{0};
+    size_t numDropped{0};
+    size_t maxQueued{0};
+    uint64_t queueTime{0};  // nsec wall time from submit to start of task
+    uint64_t runTime{0};    // nsec wall time running the task
+    uint64_t cpuTime{0};
+  };
+
+  StrandPool(
+    const std::string & loggerName, const std::string & name, int numThreads, size_t maxQueued)
+  : loggerName_(loggerName),
+    name_(name),
+    numThreads_(std::max(numThreads, 1)),
+    maxQueued_(std::max(maxQueued, static_cast<size_t>(1)))
+  {
+  }
+  ~StrandPool() { stop(); }
+
+  // must be called before start(), returns the strand id
+  int addStrand(const std::string & name)
+  {
+    strands_.emplace_back(new Strand());
+    strands_.back()->name = name;
+    return (static_cast<int>(strands_.size() - 1));
+  }
+
+  void start(const ThreadConfig & config)
+  {
+    threadConfig_ = config;
+    lastReportTime_ = Clock::now();
+    keepRunning_ = true;
+    for (int i = 0; i < numThreads_; i++) {
+      threads_.emplace_back(&StrandPool::workerThread, this, i);
+    }
+  }
+
+  void stop()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepRunning_ = false;
+      cv_.notify_all();
+    }
+    for (auto & th : threads_) {
+      th.join();
+    }
+    threads_.clear();
+  }
+
+  // returns false if the task was dropped because the strand queue is full
+  bool submit(int strand, Task task)
+  {
+    Strand & s = *strands_[strand];
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (s.tasks.size() >= maxQueued_) {
+      s.stats.numDropped++;
+      return (false);
+    }
+    s.tasks.emplace_back(std::move(task), Clock::now());
+    s.stats.maxQueued = std::max(s.stats.maxQueued, s.tasks.size());
+    if (!s.isScheduled) {
+      // the strand is neither running nor waiting, make it ready
+      s.isScheduled = true;
+      ready_.push_back(strand);
+      cv_.notify_one();
+    }
+    return (true);
+  }
+
+  // returns statistics of a strand since last call
+  Stats getStats(int strand)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Strand & s = *strands_[strand];
+    Stats stats = s.stats;
+    s.stats = Stats();
+    return (stats);
+  }
+
+  // one line per strand plus total, average times per task in msec
+  std::vector<std::string> getStatsReport()
+  {
+    const auto now = Clock::now();
+    const double dt = std::chrono::duration<double>(now - lastReportTime_).count();
+    lastReportTime_ = now;
+    std::vector<std::string> lines;
+    Stats total;
+    for (size_t i = 0; i < strands_.size(); i++) {
+      const Stats s = getStats(static_cast<int>(i));
+      total.numRun += s.numRun;
+      total.numDropped += s.numDropped;
+      total.maxQueued = std::max(total.maxQueued, s.maxQueued);
+      total.queueTime += s.queueTime;
+      total.runTime += s.runTime;
+      total.cpuTime += s.cpuTime;
+      if (strands_.size() > 1) {
+        lines.push_back(formatStats(strands_[i]->name, s, dt));
+      }
+    }
+    lines.push_back(formatStats(name_ + "[" + std::to_string(numThreads_) + "]", total, dt));
+    return (lines);
+  }
+  int getNumThreads() const { return (numThreads_); }
+  size_t getNumStrands() const { return (strands_.size()); }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct QueuedTask
+  {
+    QueuedTask() {}
+    QueuedTask(Task && t, Clock::time_point st) : task(std::move(t)), submitTime(st) {}
+    Task task;
+    Clock::time_point submitTime;
+  };
+  struct Strand
+  {
+    std::string name;
+    std::deque<QueuedTask> tasks;
+    bool isScheduled{false};  // in ready queue or running
+    Stats stats;
+  };
+
+  static uint64_t threadCpuTime()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  static uint64_t toNsec(Clock::duration d)
+  {
+    return (std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+  }
+
+  static std::string formatStats(const std::string & name, const Stats & s, double dt)
+  {
+    const double f = s.numRun > 0 ? 1e-6 / s.numRun : 0;
+    const double cpuLoad = dt > 0 ? 1e-7 * s.cpuTime / dt : 0;  // percent of one core
+    char buf[256];
+    snprintf(
+      buf, sizeof(buf),
+      "%s: tasks: %5zu, drop: %4zu, maxq: %3zu, queue: %6.2fms, run: %6.2fms, cpu: %6.1f%%",
+      name.c_str(), s.numRun, s.numDropped, s.maxQueued, s.queueTime * f, s.runTime * f, cpuLoad);
+    return (std::string(buf));
+  }
+
+  void workerThread(int id)
+  {
+    std::string report;
+    if (threadConfig_.apply(name_ + "_" + std::to_string(id), &report)) {
+      LOG_INFO_NAMED(report);
+    } else {
+      LOG_WARN_NAMED(report);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return (!keepRunning_ || !ready_.empty()); });
+      if (!keepRunning_) {
+        break;
+      }
+      const int strand = ready_.front();
+      ready_.pop_front();
+      Strand & s = *strands_[strand];
+      QueuedTask qt = std::move(s.tasks.front());
+      s.tasks.pop_front();
+      lock.unlock();
+      const auto t0 = Clock::now();
+      const uint64_t cpu0 = threadCpuTime();
+      qt.task();
+      const uint64_t cpuTime = threadCpuTime() - cpu0;
+      const auto t1 = Clock::now();
+      lock.lock();
+      s.stats.numRun++;
+      s.stats.queueTime += toNsec(t0 - qt.submitTime);
+      s.stats.runTime += toNsec(t1 - t0);
+      s.stats.cpuTime += cpuTime;
+      if (s.tasks.empty()) {
+        s.isScheduled = false;
+      } else {
+        ready_.push_back(strand);  // to the back for fairness
+        cv_.notify_one();
+      }
+    }
+    LOG_INFO_NAMED(name_ << " thread " << id << " exited!");
+  }
+
+  // ------------ variables
+  std::string loggerName_;
+  std::string name_;
+  int numThreads_{1};
+  size_t maxQueued_{16};
+  ThreadConfig threadConfig_;
+  std::vector<std::thread> threads_;
+  std::vector<std::unique_ptr<Strand>> strands_;
+  std::mutex mutex_;  // protects the variables below and the strands
+  std::condition_variable cv_;
+  bool keepRunning_{false};
+  std::deque<int> ready_;             // strands with tasks that are not running
+  Clock::time_point lastReportTime_;  // only used by getStatsReport()
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__STRAND_POOL_H_
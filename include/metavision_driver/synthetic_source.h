@@ -0,0 +1,100 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__SYNTHETIC_SOURCE_H_
+#define METAVISION_DRIVER__SYNTHETIC_SOURCE_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/event_source.h"
+
+namespace metavision_driver
+{
+//
+// Generates valid EVT3 data with a given event rate, spatial
+// distribution and burstiness. The output is deterministic.
+//
+class SyntheticEventGenerator
+{
+public:
+  struct Config
+  {
+    int width{1280};
+    int height{720};
+    double eventRate{1e6};                // events per second outside of bursts
+    std::string distribution{"uniform"};  // uniform, gaussian
+    double burstPeriod{0};                // seconds, zero means no bursts
+    double burstDutyCycle{0.1};           // fraction of burst period
+    double burstFactor{10.0};             // event rate multiplier during burst
+    double packetTime{4e-3};              // seconds of sensor time per packet
+    bool realtime{true};                  // pace packets to wall clock
+  };
+  explicit SyntheticEventGenerator(const Config & config);
+  // appends EVT3 data for the next dt usec of sensor time, returns number of events
+  size_t generate(uint64_t dt, std::vector<uint8_t> * buf);
+  uint64_t getTime() const { return (time_); }
+  const Config & getConfig() const { return (config_); }
+
+private:
+  inline uint64_t random()
+  {
+    // xorshift64, fast and good enough for test data
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return (state_);
+  }
+  inline double uniform() { return ((random() >> 11) * (1.0 / 9007199254740992.0)); }
+  double getRate(uint64_t t) const;
+  void pickPixel(uint16_t * x, uint16_t * y);
+  // ------------ variables
+  Config config_;
+  uint64_t time_{0};      // sensor time in usec
+  double eventDebt_{0};   // fractional events carried over to next packet
+  uint64_t state_{88172645463325252ULL};
+  uint64_t lastTimeHigh_{~0ULL};
+  uint64_t lastTime_{~0ULL};
+  uint16_t lastY_{0xFFFF};
+};
+
+class SyntheticSource : public EventSource
+{
+public:
+  SyntheticSource(const std::string & loggerName, const SyntheticEventGenerator::Config & config);
+  ~SyntheticSource();
+
+  // ---------------- inherited from EventSource -----------
+  bool open() override;
+  bool start(const Callback & cb) override;
+  bool stop() override;
+  // ---------------- end of inherited  -----------
+
+private:
+  void generatorThread();
+  // ------------ variables
+  SyntheticEventGenerator generator_;
+  Callback callback_;
+  std::mutex mutex_;
+  std::condition_variable cv_;  // to wake up the thread when stopping
+  bool keepRunning_{false};
+  std::shared_ptr<std::thread> thread_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__SYNTHETIC_SOURCE_H_
@@ -0,0 +1,39 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__THREAD_CONFIG_H_
+#define METAVISION_DRIVER__THREAD_CONFIG_H_
+
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// CPU affinity and scheduling policy for a thread
+//
+struct ThreadConfig
+{
+  // Applies the config to the calling thread and names it (max 15 chars).
+  // Returns false if some of the config could not be applied, e.g. due to
+  // missing permissions. The report describes what took hold.
+  bool apply(const std::string & name, std::string * report) const;
+  // ------------ variables
+  std::vector<int> cpus;        // empty = no pinning
+  std::string policy{"other"};  // other, fifo, rr
+  int priority{0};              // only used for fifo and rr
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__THREAD_CONFIG_H_
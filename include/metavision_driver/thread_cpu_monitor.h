@@ -0,0 +1,71 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__THREAD_CPU_MONITOR_H_
+#define METAVISION_DRIVER__THREAD_CPU_MONITOR_H_
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+//
+// Per-thread CPU accounting. A thread registers itself once, which
+// captures its CPU clock and kernel thread id. sample() can then be
+// called from any thread (usually the statistics thread) and returns
+// utilization and context switch rates since the previous call,
+// without adding any work to the monitored threads.
+//
+class ThreadCpuMonitor
+{
+public:
+  struct Usage
+  {
+    std::string name;
+    double cpuLoad{0};                // in % of one core
+    double voluntarySwitchRate{0};    // per sec, thread blocked (waits, locks, I/O)
+    double involuntarySwitchRate{0};  // per sec, thread preempted
+  };
+  // must be called from the thread to be monitored. Registering
+  // again under the same name replaces the previous thread.
+  void registerThread(const std::string & name);
+  // must be called from the monitored thread before it exits
+  void unregisterThread();
+  std::vector<Usage> sample();
+
+private:
+  struct Entry
+  {
+    std::string name;
+    pid_t tid{0};
+    clockid_t clock{0};
+    uint64_t cpuTime{0};  // nsec
+    uint64_t voluntarySwitches{0};
+    uint64_t involuntarySwitches{0};
+    bool isFirst{true};
+  };
+  static bool readSwitches(pid_t tid, uint64_t * voluntary, uint64_t * involuntary);
+  // ------------ variables
+  std::mutex mutex_;
+  std::vector<Entry> threads_;
+  std::chrono::steady_clock::time_point lastSampleTime_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__THREAD_CPU_MONITOR_H_
@@ -0,0 +1,142 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef METAVISION_DRIVER__TRACING_H_
+#define METAVISION_DRIVER__TRACING_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//
+// Per-packet timeline tracing, complements the log output of logging.h.
+// Trace points are compiled in only when METAVISION_DRIVER_TRACING is
+// defined (cmake -DENABLE_TRACING=ON), otherwise the macros expand to
+// nothing. When compiled in but not enabled at runtime, a trace point
+// costs one relaxed atomic load.
+//
+// The name must be a string literal, only the pointer is stored.
+// The argument is a free 64 bit value, e.g. the SDK time stamp of a
+// buffer, which allows following a buffer across threads.
+//
+#ifdef METAVISION_DRIVER_TRACING
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name, arg) \
+  metavision_driver::TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, arg)
+#define TRACE_INSTANT(name, arg)                                                         \
+  {                                                                                      \
+    if (metavision_driver::Tracer::isEnabled()) {                                        \
+      metavision_driver::Tracer::record(name, metavision_driver::Tracer::now(), 0, arg); \
+    }                                                                                    \
+  }
+#else
+#define TRACE_SCOPE(name, arg)
+#define TRACE_INSTANT(name, arg)
+#endif
+
+namespace metavision_driver
+{
+class Tracer
+{
+public:
+  struct Record
+  {
+    const char * name{nullptr};
+    uint64_t start{0};     // nsec, steady clock
+    uint64_t duration{0};  // nsec, zero for instant events
+    uint64_t arg{0};
+  };
+  static bool isCompiledIn();
+  static inline bool isEnabled() { return (enabled_.load(std::memory_order_relaxed)); }
+  // Turning tracing off writes all records to fileName in the Chrome
+  // trace JSON format (chrome://tracing, ui.perfetto.dev).
+  static bool enable(bool enable, const std::string & fileName, std::string * msg);
+  // number of records in the ring of each thread, applies to threads
+  // that record their first event afterwards
+  static void setBufferSize(size_t numRecords);
+  static bool dump(const std::string & fileName, std::string * msg);
+
+  static inline uint64_t now()
+  {
+    return (std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now().time_since_epoch())
+              .count());
+  }
+  static inline void record(const char * name, uint64_t start, uint64_t duration, uint64_t arg)
+  {
+    ThreadBuffer * b = threadBuffer();
+    // single writer per ring, the reader checks head to detect overwrites
+    const uint64_t h = b->head.load(std::memory_order_relaxed);
+    Record & r = b->records[h % b->records.size()];
+    r.name = name;
+    r.start = start;
+    r.duration = duration;
+    r.arg = arg;
+    b->head.store(h + 1, std::memory_order_release);
+  }
+
+private:
+  struct ThreadBuffer
+  {
+    explicit ThreadBuffer(size_t n) : records(n) {}
+    std::vector<Record> records;
+    std::atomic<uint64_t> head{0};  // total number of records written
+    int tid{0};
+    std::string threadName;
+  };
+  static inline ThreadBuffer * threadBuffer()
+  {
+    static thread_local ThreadBuffer * buffer = nullptr;
+    if (!buffer) {
+      buffer = registerThread();  // only once per thread, takes a lock
+    }
+    return (buffer);
+  }
+  static ThreadBuffer * registerThread();
+  // ------------ variables
+  static std::atomic<bool> enabled_;
+  static std::mutex registryMutex_;
+  // buffers outlive their threads such that the records can still be dumped
+  static std::vector<std::shared_ptr<ThreadBuffer>> registry_;
+  static size_t bufferSize_;  // protected by registryMutex_
+};
+
+class TraceScope
+{
+public:
+  TraceScope(const char * name, uint64_t arg)
+  : name_(name), arg_(arg), start_(Tracer::isEnabled() ? Tracer::now() : 0)
+  {
+  }
+  ~TraceScope()
+  {
+    if (start_ != 0 && Tracer::isEnabled()) {
+      Tracer::record(name_, start_, Tracer::now() - start_, arg_);
+    }
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope & operator=(const TraceScope &) = delete;
+
+private:
+  const char * name_;
+  uint64_t arg_;
+  uint64_t start_;
+};
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__TRACING_H_
@@ -0,0 +1,91 @@
+# -----------------------------------------------------------------------------
+# Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os
+
+from ament_index_python.packages import get_package_share_directory
+import launch
+from launch.actions import DeclareLaunchArgument as LaunchArg
+from launch.actions import OpaqueFunction
+from launch.substitutions import LaunchConfiguration as LaunchConfig
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+def launch_setup(context, *args, **kwargs):
+    """Create multi camera composable node."""
+    cam_0_str = LaunchConfig("camera_0_name").perform(context)
+    cam_1_str = LaunchConfig("camera_1_name").perform(context)
+    pkg_name = "metavision_driver"
+    share_dir = get_package_share_directory(pkg_name)
+    bias_config = os.path.join(share_dir, "config", "silky_ev_cam.bias")
+    driver = ComposableNode(
+        package="metavision_driver",
+        plugin="metavision_driver::MultiDriverROS2",
+        name=LaunchConfig("driver_name"),
+        parameters=[
+            {
+                "cameras": [cam_0_str, cam_1_str],
+                "sync": True,  # first camera is primary
+                "num_threads": 2,
+                "max_queued": 64,
+                # parameters without camera prefix apply to all cameras
+                "bias_file": bias_config,
+                "event_message_time_threshold": 1.0e-3,
+                cam_0_str + ".serial": "CenturyArks:evc3a_plugin_gen31:00000198",
+                cam_0_str + ".frame_id": "cam_0",
+                cam_1_str + ".serial": "CenturyArks:evc3a_plugin_gen31:00000293",
+                cam_1_str + ".frame_id": "cam_1",
+            }
+        ],
+        remappings=[
+            ("~/" + cam_0_str + "/events", cam_0_str + "/events"),
+            ("~/" + cam_1_str + "/events", cam_1_str + "/events"),
+        ],
+        extra_arguments=[{"use_intra_process_comms": True}],
+    )
+    container = ComposableNodeContainer(
+        name="metavision_driver_container",
+        namespace="",
+        package="rclcpp_components",
+        executable="component_container",
+        composable_node_descriptions=[driver],
+        output="screen",
+    )
+    return [container]
+
+
+def generate_launch_description():
+    """Create composable node by calling opaque function."""
+    return launch.LaunchDescription(
+        [
+            LaunchArg(
+                "driver_name",
+                default_value=["event_cams"],
+                description="name of the multi camera driver",
+            ),
+            LaunchArg(
+                "camera_0_name",
+                default_value=["event_cam_0"],
+                description="camera name of camera 0",
+            ),
+            LaunchArg(
+                "camera_1_name",
+                default_value=["event_cam_1"],
+                description="camera name of camera 1",
+            ),
+            OpaqueFunction(function=launch_setup),
+        ]
+    )
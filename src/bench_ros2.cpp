@@ -0,0 +1,350 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Throughput and latency benchmark for the raw data pipeline. Feeds
+// pregenerated synthetic EVT3 data through the MetavisionWrapper and
+// through DriverROS2::rawDataCallback, and prints one JSON object per
+// benchmark case to stdout.
+//
+// usage: metavision_driver_bench [seconds_per_case]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <event_camera_msgs/msg/event_packet.hpp>
+#include <memory>
+#include <mutex>
+#include <rclcpp/rclcpp.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/callback_handler.h"
+#include "metavision_driver/driver_ros2.h"
+#include "metavision_driver/event_source.h"
+#include "metavision_driver/evt3_utils.h"
+#include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/synthetic_source.h"
+
+// count heap allocations by interposing on the glibc allocator
+static std::atomic<uint64_t> numAllocs{0};
+
+extern "C" {
+void * __libc_malloc(size_t);
+void * __libc_calloc(size_t, size_t);
+void * __libc_realloc(void *, size_t);
+
+void * malloc(size_t n)
+{
+  numAllocs.fetch_add(1, std::memory_order_relaxed);
+  return (__libc_malloc(n));
+}
+void * calloc(size_t n, size_t s)
+{
+  numAllocs.fetch_add(1, std::memory_order_relaxed);
+  return (__libc_calloc(n, s));
+}
+void * realloc(void * p, size_t n)
+{
+  numAllocs.fetch_add(1, std::memory_order_relaxed);
+  return (__libc_realloc(p, n));
+}
+}
+
+namespace metavision_driver
+{
+using Clock = std::chrono::steady_clock;
+using EventPacketMsg = event_camera_msgs::msg::EventPacket;
+
+static uint64_t system_time_ns()
+{
+  return (std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+}
+
+//
+// EVT3 data stream cut into chunks of fixed size
+//
+struct Chunks
+{
+  std::vector<uint8_t> data;
+  size_t chunkSize{0};
+  double eventsPerByte{0};
+  size_t numChunks() const { return (data.size() / chunkSize); }
+  const uint8_t * chunk(size_t i) const { return (data.data() + i * chunkSize); }
+};
+
+static std::vector<uint8_t> make_stream(size_t minBytes, size_t * numEvents)
+{
+  SyntheticEventGenerator::Config cfg;
+  cfg.eventRate = 20e6;
+  cfg.packetTime = 1e-3;
+  cfg.realtime = false;
+  SyntheticEventGenerator gen(cfg);
+  std::vector<uint8_t> buf;
+  buf.reserve(minBytes + (1 << 20));
+  *numEvents = 0;
+  while (buf.size() < minBytes) {
+    *numEvents += gen.generate(static_cast<uint64_t>(cfg.packetTime * 1e6), &buf);
+  }
+  return (buf);
+}
+
+static Chunks make_chunks(
+  const std::vector<uint8_t> & stream, size_t numEvents, size_t chunkSize)
+{
+  Chunks c;
+  c.chunkSize = chunkSize;
+  // cut on chunk boundary, the raw data stream has no packet structure
+  c.data.assign(stream.begin(), stream.begin() + (stream.size() / chunkSize) * chunkSize);
+  c.eventsPerByte = static_cast<double>(numEvents) / stream.size();
+  return (c);
+}
+
+struct Result
+{
+  uint64_t bytes{0};
+  uint64_t allocs{0};
+  double elapsed{0};
+  std::vector<uint64_t> latency;  // nanoseconds
+};
+
+static double percentile(std::vector<uint64_t> * v, double p)
+{
+  if (v->empty()) {
+    return (0);
+  }
+  const size_t idx = std::min(v->size() - 1, static_cast<size_t>(p * (v->size() - 1) + 0.5));
+  std::nth_element(v->begin(), v->begin() + idx, v->end());
+  return ((*v)[idx] * 1e-3);  // usec
+}
+
+static void print_result(const std::string & caseDescr, const Chunks & c, Result * r)
+{
+  const double mbs = r->bytes / r->elapsed * 1e-6;
+  const double mevs = r->bytes * c.eventsPerByte / r->elapsed * 1e-6;
+  const double p50 = percentile(&r->latency, 0.5);
+  const double p90 = percentile(&r->latency, 0.9);
+  const double p99 = percentile(&r->latency, 0.99);
+  const double pmax = percentile(&r->latency, 1.0);
+  printf(
+    "{%s, \"chunk_bytes\": %zu, \"mb_per_s\": %.2f, \"mev_per_s\": %.3f, "
+    "\"allocs_per_s\": %.1f, \"latency_us\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, "
+    "\"max\": %.2f}}\n",
+    caseDescr.c_str(), c.chunkSize, mbs, mevs, r->allocs / r->elapsed, p50, p90, p99, pmax);
+  fflush(stdout);
+}
+
+// ------------------ wrapper benchmark ------------------------
+
+//
+// Replays the chunks as fast as possible
+//
+class ReplaySource : public EventSource
+{
+public:
+  explicit ReplaySource(const Chunks & c) : EventSource("bench"), chunks_(c)
+  {
+    width_ = 1280;
+    height_ = 720;
+    encodingFormat_ = "evt3";
+    serialNumber_ = "replay";
+  }
+  ~ReplaySource() { stop(); }
+  bool open() override { return (true); }
+  bool start(const Callback & cb) override
+  {
+    keepRunning_ = true;
+    thread_ = std::make_shared<std::thread>([this, cb]() {
+      for (size_t i = 0; keepRunning_; i = (i + 1) % chunks_.numChunks()) {
+        cb(chunks_.chunk(i), chunks_.chunkSize);
+      }
+    });
+    return (true);
+  }
+  bool stop() override
+  {
+    if (!thread_) {
+      return (false);
+    }
+    keepRunning_ = false;
+    thread_->join();
+    thread_.reset();
+    return (true);
+  }
+
+private:
+  const Chunks & chunks_;
+  std::atomic<bool> keepRunning_{false};
+  std::shared_ptr<std::thread> thread_;
+};
+
+class CountingHandler : public CallbackHandler
+{
+public:
+  CountingHandler() { latency_.reserve(1 << 24); }
+  void rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end) override
+  {
+    const uint64_t now = system_time_ns();
+    std::unique_lock<std::mutex> lock(mutex_);
+    bytes_ += end - start;
+    if (latency_.size() < latency_.capacity()) {
+      latency_.push_back(now - t);
+    }
+  }
+  void eventCDCallback(uint64_t, const Metavision::EventCD *, const Metavision::EventCD *) override
+  {
+  }
+  void reset()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bytes_ = 0;
+    latency_.clear();
+  }
+  void get(Result * r)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    r->bytes = bytes_;
+    r->latency = latency_;
+  }
+
+private:
+  std::mutex mutex_;
+  uint64_t bytes_{0};
+  std::vector<uint64_t> latency_;
+};
+
+static void bench_wrapper(const Chunks & c, bool useMT, double duration)
+{
+  auto wrapper = std::make_shared<MetavisionWrapper>("bench");
+  wrapper->setStatisticsInterval(0.5);
+  wrapper->setEventSource(std::make_shared<ReplaySource>(c));
+  if (!wrapper->initialize(useMT, "")) {
+    fprintf(stderr, "wrapper initialization failed!\n");
+    return;
+  }
+  CountingHandler handler;
+  wrapper->startCamera(&handler);
+  // let it warm up before measuring
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  handler.reset();
+  const uint64_t allocs0 = numAllocs;
+  const auto t0 = Clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+  Result r;
+  handler.get(&r);
+  r.allocs = numAllocs - allocs0;
+  r.elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+  wrapper->stop();
+  print_result(
+    std::string("\"group\": \"wrapper\", \"mode\": \"") + (useMT ? "multithreaded" : "single") +
+      "\"",
+    c, &r);
+}
+
+// ------------------ driver benchmark ------------------------
+
+static void bench_driver(const Chunks & c, double timeThreshold, bool withSub, double duration)
+{
+  // the synthetic source with zero rate and a very long packet time
+  // will never call back, so the benchmark owns the callback thread
+  rclcpp::NodeOptions options;
+  options.use_intra_process_comms(true);
+  options.parameter_overrides(
+    {rclcpp::Parameter("source", std::string("synthetic")),
+     rclcpp::Parameter("synthetic_event_rate", 0.0),
+     rclcpp::Parameter("synthetic_packet_time", 3600.0),
+     rclcpp::Parameter("statistics_print_interval", 0.5),
+     rclcpp::Parameter("use_multithreading", false),
+     rclcpp::Parameter("event_message_time_threshold", timeThreshold)});
+  auto driver = std::make_shared<DriverROS2>(options);
+  const std::string topic = std::string(driver->get_fully_qualified_name()) + "/events";
+
+  std::atomic<uint64_t> numRecv{0};
+  rclcpp::executors::SingleThreadedExecutor exec;
+  std::shared_ptr<std::thread> spinThread;
+  rclcpp::Node::SharedPtr subNode;
+  rclcpp::Subscription<EventPacketMsg>::SharedPtr sub;
+  if (withSub) {
+    subNode = std::make_shared<rclcpp::Node>(
+      "bench_subscriber", rclcpp::NodeOptions().use_intra_process_comms(true));
+    sub = subNode->create_subscription<EventPacketMsg>(
+      topic, rclcpp::QoS(rclcpp::KeepLast(1000)).best_effort(),
+      [&numRecv](EventPacketMsg::ConstSharedPtr) { numRecv++; });
+    exec.add_node(subNode);
+    spinThread = std::make_shared<std::thread>([&exec]() { exec.spin(); });
+    // wait for the driver to see the subscriber
+    for (int i = 0; i < 100 && driver->count_subscribers(topic) == 0; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  Result r;
+  r.latency.reserve(1 << 24);
+  const uint64_t allocs0 = numAllocs;
+  const auto t0 = Clock::now();
+  const auto tEnd = t0 + std::chrono::duration<double>(duration);
+  for (size_t i = 0; Clock::now() < tEnd; i = (i + 1) % c.numChunks()) {
+    const auto tStart = Clock::now();
+    driver->rawDataCallback(system_time_ns(), c.chunk(i), c.chunk(i) + c.chunkSize);
+    const uint64_t dt =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tStart).count();
+    if (r.latency.size() < r.latency.capacity()) {
+      r.latency.push_back(dt);
+    }
+    r.bytes += c.chunkSize;
+  }
+  r.elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+  r.allocs = numAllocs - allocs0;
+  if (spinThread) {
+    exec.cancel();
+    spinThread->join();
+  }
+  char buf[256];
+  snprintf(
+    buf, sizeof(buf),
+    "\"group\": \"driver\", \"time_threshold_s\": %g, \"subscriber\": %s, \"msgs_recv\": %lu",
+    timeThreshold, withSub ? "true" : "false", static_cast<unsigned long>(numRecv.load()));
+  print_result(buf, c, &r);
+}
+}  // namespace metavision_driver
+
+int main(int argc, char * argv[])
+{
+  rclcpp::init(argc, argv);
+  const auto args = rclcpp::remove_ros_arguments(argc, argv);
+  const double duration = args.size() > 1 ? std::max(atof(args[1].c_str()), 0.1) : 2.0;
+
+  using namespace metavision_driver;
+  size_t numEvents(0);
+  const auto stream = make_stream(64 << 20, &numEvents);
+  for (const size_t chunkSize : {1024, 16384, 262144}) {
+    const auto chunks = make_chunks(stream, numEvents, chunkSize);
+    for (const bool useMT : {false, true}) {
+      bench_wrapper(chunks, useMT, duration);
+    }
+    for (const double timeThreshold : {1e-4, 1e-3, 1e-2}) {
+      for (const bool withSub : {false, true}) {
+        bench_driver(chunks, timeThreshold, withSub, duration);
+      }
+    }
+  }
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,163 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/buffer_pool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "metavision_driver/logging.h"
+
+namespace metavision_driver
+{
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t round_up(size_t n, size_t align) { return (((n + align - 1) / align) * align); }
+
+BufferPool::BufferPool(const std::string & loggerName) : loggerName_(loggerName) {}
+
+BufferPool::~BufferPool() { unmap(); }
+
+bool BufferPool::initialize(const std::string & mode, size_t blockSize, size_t numBlocks)
+{
+  unmap();
+  if (mode == "none" || blockSize == 0 || numBlocks == 0) {
+    mode_ = "none";
+    return (true);
+  }
+  blockSize_ = round_up(blockSize, 64);  // keep blocks cache line aligned
+  numBlocks_ = numBlocks;
+  const size_t size = round_up(blockSize_ * numBlocks_, HUGE_PAGE_SIZE);
+  std::string m = mode;
+  if (m == "hugetlb") {
+    void * p = mmap(
+      nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+      LOG_WARN_NAMED(
+        "cannot map " << size << " bytes of explicit hugepages (" << strerror(errno)
+                      << "), check /proc/sys/vm/nr_hugepages. Falling back to thp");
+      m = "thp";
+    } else {
+      region_ = static_cast<uint8_t *>(p);
+      regionSize_ = size;
+      blocks_ = region_;
+    }
+  }
+  if (m == "thp") {
+    // over-allocate such that the blocks start on a hugepage boundary
+    const size_t mapSize = size + HUGE_PAGE_SIZE;
+    void * p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      LOG_ERROR_NAMED("cannot map buffer pool memory: " << strerror(errno));
+      return (false);
+    }
+    region_ = static_cast<uint8_t *>(p);
+    regionSize_ = mapSize;
+    blocks_ = reinterpret_cast<uint8_t *>(
+      round_up(reinterpret_cast<uintptr_t>(region_), HUGE_PAGE_SIZE));
+    if (madvise(blocks_, size, MADV_HUGEPAGE) != 0) {
+      LOG_WARN_NAMED("transparent hugepages not available: " << strerror(errno));
+    }
+  } else if (m != "hugetlb") {
+    if (m != "malloc") {
+      LOG_WARN_NAMED("invalid buffer pool mode: " << m << ", using malloc");
+      m = "malloc";
+    }
+    void * p{nullptr};
+    if (posix_memalign(&p, sysconf(_SC_PAGESIZE), size) != 0) {
+      LOG_ERROR_NAMED("cannot allocate buffer pool memory!");
+      return (false);
+    }
+    region_ = static_cast<uint8_t *>(p);
+    regionSize_ = size;
+    blocks_ = region_;
+  }
+  mode_ = m;
+  LOG_INFO_NAMED(
+    "buffer pool: " << numBlocks_ << " blocks of " << blockSize_ << " bytes, mode: " << mode_);
+  return (true);
+}
+
+void BufferPool::prefault()
+{
+  if (!blocks_) {
+    return;
+  }
+  // writing to every page faults it in on the NUMA node of the calling thread
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  const size_t size = blockSize_ * numBlocks_;
+  for (size_t i = 0; i < size; i += pageSize) {
+    blocks_[i] = 0;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  freeList_.clear();
+  freeList_.reserve(numBlocks_);
+  for (size_t i = 0; i < numBlocks_; i++) {
+    // hand out low addresses first
+    freeList_.push_back(blocks_ + (numBlocks_ - 1 - i) * blockSize_);
+  }
+  ready_ = true;
+}
+
+void * BufferPool::allocate(size_t size)
+{
+  if (!ready_ || size > blockSize_) {
+    return (nullptr);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (freeList_.empty()) {
+    return (nullptr);
+  }
+  void * p = freeList_.back();
+  freeList_.pop_back();
+  return (p);
+}
+
+bool BufferPool::release(void * p)
+{
+  uint8_t * b = static_cast<uint8_t *>(p);
+  if (!blocks_ || b < blocks_ || b >= blocks_ + blockSize_ * numBlocks_) {
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  freeList_.push_back(p);
+  return (true);
+}
+
+void BufferPool::unmap()
+{
+  ready_ = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freeList_.clear();
+  }
+  if (region_) {
+    if (mode_ == "malloc") {
+      free(region_);
+    } else {
+      munmap(region_, regionSize_);
+    }
+  }
+  region_ = nullptr;
+  blocks_ = nullptr;
+  regionSize_ = 0;
+  mode_ = "none";
+}
+
+}  // namespace metavision_driver
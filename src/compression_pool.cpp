@@ -0,0 +1,66 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/compression_pool.h"
+
+#include "metavision_driver/logging.h"
+
+namespace metavision_driver
+{
+CompressionPool::CompressionPool(
+  const std::string & loggerName, const std::string & method, int level, int numThreads,
+  size_t maxInFlight)
+: loggerName_(loggerName),
+  method_(method),
+  pool_(loggerName, "mv_compress", numThreads, maxInFlight)
+{
+  for (int i = 0; i < pool_.getNumThreads(); i++) {
+    compressors_.emplace_back(new Compressor(method, level));
+  }
+}
+
+void CompressionPool::start(const Callback & cb, const ThreadConfig & threadConfig)
+{
+  callback_ = cb;
+  pool_.start(
+    std::bind(&CompressionPool::process, this, std::placeholders::_1, std::placeholders::_2),
+    std::bind(&CompressionPool::emit, this, std::placeholders::_1), threadConfig);
+}
+
+void CompressionPool::stop() { pool_.stop(); }
+
+bool CompressionPool::submit(const EventPacketData & packet)
+{
+  std::unique_ptr<Job> job(new Job());
+  job->packet = packet;
+  return (pool_.submit(std::move(job)));
+}
+
+void CompressionPool::process(int worker, Job * job)
+{
+  const auto & data = *job->packet.events;
+  if (!compressors_[worker]->compress(data.data(), data.size(), &job->compressed)) {
+    LOG_WARN_NAMED("compression failed for message " << job->packet.seq);
+  }
+}
+
+void CompressionPool::emit(Job * job)
+{
+  if (!job->compressed.empty()) {
+    callback_(job);
+  }
+}
+
+}  // namespace metavision_driver
@@ -0,0 +1,102 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/compressor.h"
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAS_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <cstring>
+
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+bool Compressor::isSupported(const std::string & method)
+{
+#ifdef HAS_ZSTD
+  if (method == "zstd") {
+    return (true);
+  }
+#endif
+#ifdef HAS_LZ4
+  if (method == "lz4") {
+    return (true);
+  }
+#endif
+  (void)method;
+  return (false);
+}
+
+Compressor::Compressor(const std::string & method, int level) : method_(method), level_(level)
+{
+#ifdef HAS_ZSTD
+  if (method_ == "zstd") {
+    zstdContext_ = ZSTD_createCCtx();
+  }
+#endif
+}
+
+Compressor::~Compressor()
+{
+#ifdef HAS_ZSTD
+  if (zstdContext_) {
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(zstdContext_));
+  }
+#endif
+}
+
+bool Compressor::compress(const uint8_t * data, size_t size, std::vector<uint8_t> * out)
+{
+#ifdef HAS_ZSTD
+  if (method_ == "zstd" && zstdContext_) {
+    resize_hack(*out, ZSTD_compressBound(size));
+    const size_t n = ZSTD_compressCCtx(
+      static_cast<ZSTD_CCtx *>(zstdContext_), out->data(), out->size(), data, size, level_);
+    if (ZSTD_isError(n)) {
+      out->clear();
+      return (false);
+    }
+    out->resize(n);
+    return (true);
+  }
+#endif
+#ifdef HAS_LZ4
+  if (method_ == "lz4") {
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.compressionLevel = level_;
+    prefs.frameInfo.contentSize = size;
+    resize_hack(*out, LZ4F_compressFrameBound(size, &prefs));
+    const size_t n = LZ4F_compressFrame(out->data(), out->size(), data, size, &prefs);
+    if (LZ4F_isError(n)) {
+      out->clear();
+      return (false);
+    }
+    out->resize(n);
+    return (true);
+  }
+#endif
+  (void)data;
+  (void)size;
+  out->clear();
+  return (false);
+}
+
+}  // namespace metavision_driver
@@ -0,0 +1,79 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/decoded_events_worker.h"
+
+#include "metavision_driver/logging.h"
+
+namespace metavision_driver
+{
+DecodedEventsWorker::DecodedEventsWorker(
+  const std::string & loggerName, const std::string & encoding, size_t maxInFlight)
+: loggerName_(loggerName),
+  encoding_(encoding),
+  pool_(loggerName, "mv_decoder", 1, maxInFlight),
+  decoder_(make_decoder<DecodedEventsWorker>(encoding))
+{
+}
+
+void DecodedEventsWorker::start(const Callback & cb, const ThreadConfig & threadConfig)
+{
+  callback_ = cb;
+  pool_.start(
+    std::bind(&DecodedEventsWorker::process, this, std::placeholders::_1, std::placeholders::_2),
+    std::bind(&DecodedEventsWorker::emit, this, std::placeholders::_1), threadConfig);
+}
+
+void DecodedEventsWorker::stop() { pool_.stop(); }
+
+bool DecodedEventsWorker::submit(const EventPacketData & packet)
+{
+  std::unique_ptr<Job> job(new Job());
+  job->packet = packet;
+  job->resetDecoder = resetPending_;
+  if (!pool_.submit(std::move(job))) {
+    return (false);  // a pending reset applies to the next packet
+  }
+  resetPending_ = false;
+  return (true);
+}
+
+void DecodedEventsWorker::process(int, Job * job)
+{
+  DecodedEventArrays & ev = job->events;
+  const size_t n = reservePolicy_.getReserveSize();
+  ev.x.reserve(n);
+  ev.y.reserve(n);
+  ev.polarity.reserve(n);
+  ev.t.reserve(n);
+  events_ = &ev;
+  if (job->resetDecoder) {
+    // otherwise the time tracker takes the step back for a roll-over
+    decoder_ = make_decoder<DecodedEventsWorker>(encoding_);
+  }
+  const auto & data = *job->packet.events;
+  decoder_->decode(data.data(), data.data() + data.size(), this);
+  events_ = nullptr;
+  reservePolicy_.update(ev.t.size(), ev.t.capacity());
+}
+
+void DecodedEventsWorker::emit(Job * job)
+{
+  if (!job->events.t.empty()) {
+    callback_(job);
+  }
+}
+
+}  // namespace metavision_driver
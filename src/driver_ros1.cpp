@@ -16,45 +16,135 @@
 #include "metavision_driver/driver_ros1.h"
 
 #include <event_camera_msgs/EventPacket.h>
+#include <map>
+#include <sstream>
 
 #include "metavision_driver/check_endian.h"
+#include "metavision_driver/compressor.h"
 #include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/tracing.h"
 
 namespace metavision_driver
 {
 namespace ph = std::placeholders;
+
+static diagnostic_msgs::KeyValue make_key_value(const std::string & key, const std::string & value)
+{
+  diagnostic_msgs::KeyValue kv;
+  kv.key = key;
+  kv.value = value;
+  return (kv);
+}
+
+static diagnostic_msgs::DiagnosticStatus make_statistics_status(
+  const MetavisionWrapper::StatsReport & r, const std::string & name, int queueWarnSize)
+{
+  using Status = diagnostic_msgs::DiagnosticStatus;
+  Status status;
+  status.name = name;
+  const bool queueBackedUp = static_cast<int>(r.maxQueueSize) > queueWarnSize;
+  status.level = Status::WARN;
+  if (r.msgsDropped != 0) {
+    status.message = "dropping messages";
+  } else if (r.numTimeGaps != 0) {
+    status.message = "sensor data lost";
+  } else if (r.numTimeResets != 0) {
+    status.message = "sensor clock reset";
+  } else if (queueBackedUp) {
+    status.message = "processing queue backed up";
+  } else {
+    status.level = Status::OK;
+    status.message = "ok";
+  }
+  status.values.push_back(make_key_value("interval", std::to_string(r.interval)));
+  status.values.push_back(make_key_value("bytes_in_rate_mbps", std::to_string(r.bytesInRate)));
+  status.values.push_back(make_key_value("bytes_out_rate_mbps", std::to_string(r.bytesOutRate)));
+  status.values.push_back(make_key_value("msgs_in_rate", std::to_string(r.msgsInRate)));
+  status.values.push_back(make_key_value("msgs_out_rate", std::to_string(r.msgsOutRate)));
+  status.values.push_back(make_key_value("msgs_dropped", std::to_string(r.msgsDropped)));
+  status.values.push_back(make_key_value("queue_size", std::to_string(r.queueSize)));
+  status.values.push_back(make_key_value("max_queue_size", std::to_string(r.maxQueueSize)));
+  status.values.push_back(make_key_value("latency_p50_us", std::to_string(r.latencyP50)));
+  status.values.push_back(make_key_value("latency_p90_us", std::to_string(r.latencyP90)));
+  status.values.push_back(make_key_value("latency_p99_us", std::to_string(r.latencyP99)));
+  status.values.push_back(make_key_value("latency_max_us", std::to_string(r.latencyMax)));
+  status.values.push_back(make_key_value("cpu_load_percent", std::to_string(r.cpuLoad)));
+  status.values.push_back(make_key_value("page_fault_rate", std::to_string(r.pageFaultRate)));
+  status.values.push_back(make_key_value("compression_ratio", std::to_string(r.compressionRatio)));
+  status.values.push_back(make_key_value("compressed_rate_mbps", std::to_string(r.compressedRate)));
+  status.values.push_back(make_key_value("num_reconnects", std::to_string(r.numReconnects)));
+  status.values.push_back(make_key_value("time_gaps", std::to_string(r.numTimeGaps)));
+  status.values.push_back(make_key_value("time_resets", std::to_string(r.numTimeResets)));
+  status.values.push_back(make_key_value("lost_time_ms", std::to_string(r.lostTime)));
+  for (const auto & u : r.threads) {
+    const std::string prefix = "thread_" + u.name;
+    status.values.push_back(make_key_value(prefix + "_cpu_percent", std::to_string(u.cpuLoad)));
+    status.values.push_back(
+      make_key_value(prefix + "_voluntary_switch_rate", std::to_string(u.voluntarySwitchRate)));
+    status.values.push_back(
+      make_key_value(prefix + "_involuntary_switch_rate", std::to_string(u.involuntarySwitchRate)));
+  }
+  return (status);
+}
 DriverROS1::DriverROS1(ros::NodeHandle & nh) : nh_(nh)
 {
   configureWrapper(ros::this_node::getName());
 
   encoding_ = nh.param<std::string>("encoding", "evt3");
-  if (encoding_ != "evt3") {
+  if (!is_supported_encoding(encoding_)) {
     ROS_ERROR_STREAM("invalid encoding: " << encoding_);
     throw std::runtime_error("invalid encoding!");
   }
-  messageThresholdTime_ =
+  wrapper_->setRequestedEncoding(encoding_);
+  PacketSizer::Config sizerConfig;
+  sizerConfig.timeThreshold =
     uint64_t(std::abs(nh_.param<double>("event_message_time_threshold", 1e-3) * 1e9));
-  messageThresholdSize_ =
+  sizerConfig.sizeThreshold =
     static_cast<size_t>(std::abs(nh_.param<int>("event_message_size_threshold", 1024 * 1024)));
+  sizerConfig.eventThreshold =
+    static_cast<uint64_t>(std::abs(nh_.param<int>("event_message_event_threshold", 0)));
+  sizerConfig.sensorTimeThreshold =
+    uint64_t(std::abs(nh_.param<double>("event_message_sensor_time_threshold", 0.0) * 1e6));
+  sizerConfig.minRate = nh_.param<double>("event_message_rate_min", 0.0);
+  sizerConfig.maxRate = nh_.param<double>("event_message_rate_max", 0.0);
+  packetSizer_.setConfig(sizerConfig);
+  if (packetSizer_.isAdaptive()) {
+    wrapper_->addStatsReporter([this]() { return (packetSizer_.getStatsReport()); });
+  }
+  ReservePolicy::Config reserveConfig;
+  reserveConfig.window = static_cast<size_t>(std::max(nh_.param<int>("reserve_window", 256), 1));
+  reserveConfig.percentile = nh_.param<double>("reserve_percentile", 0.95);
+  reserveConfig.maxSize = static_cast<size_t>(std::max(nh_.param<int>("reserve_max_size", 0), 0));
+  reservePolicy_.setConfig(reserveConfig);
+  BiasController::Config biasControlConfig;
+  biasControlConfig.targetRate = nh_.param<double>("bias_control_target_rate", 0.0);
+  biasControlConfig.hysteresis = nh_.param<double>("bias_control_hysteresis", 0.2);
+  biasControlConfig.stepFraction = nh_.param<double>("bias_control_step", 0.05);
+  biasControlConfig.interval = nh_.param<double>("bias_control_interval", 1.0);
+  biasController_.setConfig(biasControlConfig);
+  wrapper_->addStatsReporter([this]() { return (reservePolicy_.getStatsReport()); });
 
   eventPub_ = nh_.advertise<EventPacketMsg>("events", nh_.param<int>("send_queue_size", 1000));
+  infoPub_ =
+    nh_.advertise<EventPacketInfoMsg>("events_info", nh_.param<int>("send_queue_size", 1000));
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(ros::this_node::getName());
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  triggerPub_ = nh_.advertise<ExtTriggerMsg>("trigger", 100);
+  diagnosticsPub_ = ros::NodeHandle().advertise<DiagnosticArrayMsg>("/diagnostics", 10);
 
   if (wrapper_->getSyncMode() == "primary") {
-    // defer starting the primary until the secondary is up
-    ros::ServiceClient client = nh_.serviceClient<Trigger>("ready");
-    Trigger trig;
-    while (!client.call(trig)) {
-      ROS_INFO_STREAM("waiting for secondary to come up...");
-      ros::Duration(0, 1000000000).sleep();  // sleep for a second
-    }
-    ROS_INFO_STREAM("secondary is up: " << trig.response.message);
-    start();  // only now can this be started
+    // defer starting the primary until the secondary is up. The ready
+    // topic is latched, so the message arrives as soon as both are up.
+    ROS_INFO_STREAM("primary waiting for secondary...");
+    readySub_ = nh_.subscribe("ready", 1, &DriverROS1::secondaryReadyCallback, this);
   } else if (wrapper_->getSyncMode() == "secondary") {
-    // on the secondary first start the camera before bringing
-    // up the server
+    // on the secondary first start the camera before signaling ready
     start();
-    secondaryReadyServer_ =
-      nh_.advertiseService("ready", &DriverROS1::secondaryReadyCallback, this);
+    readyPub_ = nh_.advertise<HeaderMsg>("ready", 1, true /* latched */);
+    HeaderMsg ready;
+    ready.stamp = ros::Time::now();
+    ready.frame_id = frameId_;
+    readyPub_.publish(ready);
   } else {  // standalone mode
     start();
   }
@@ -64,6 +154,11 @@ DriverROS1::~DriverROS1()
 {
   stop();
   wrapper_.reset();  // invoke destructor
+  if (Tracer::isEnabled()) {
+    std::string msg;
+    Tracer::enable(false, tracingFile_, &msg);
+    ROS_INFO_STREAM(msg);
+  }
 }
 
 bool DriverROS1::saveBiases(Trigger::Request & req, Trigger::Response & res)
@@ -77,6 +172,67 @@ bool DriverROS1::saveBiases(Trigger::Request & req, Trigger::Response & res)
   return (res.success);
 }
 
+bool DriverROS1::startTracing(Trigger::Request & req, Trigger::Response & res)
+{
+  (void)req;
+  res.success = Tracer::enable(true, tracingFile_, &res.message);
+  ROS_INFO_STREAM(res.message);
+  return (res.success);
+}
+
+bool DriverROS1::stopTracing(Trigger::Request & req, Trigger::Response & res)
+{
+  (void)req;
+  res.success = Tracer::enable(false, tracingFile_, &res.message);
+  ROS_INFO_STREAM(res.message);
+  return (res.success);
+}
+
+bool DriverROS1::setBiases(SetBiases::Request & req, SetBiases::Response & res)
+{
+  res.success = false;
+  if (req.names.size() != req.values.size()) {
+    res.message = "names and values must have the same length";
+    return (false);
+  }
+  std::map<std::string, int> biases;
+  for (size_t i = 0; i < req.names.size(); i++) {
+    biases[req.names[i]] = req.values[i];
+  }
+  std::map<std::string, int> result;
+  if (wrapper_) {
+    res.success = wrapper_->setBiases(biases, &result, &res.message);
+  }
+  for (const auto & b : result) {
+    res.names.push_back(b.first);
+    res.values.push_back(b.second);
+  }
+  if (res.success) {
+    updateConfigBiases();
+  }
+  return (res.success);
+}
+
+void DriverROS1::updateConfigBiases()
+{
+  if (configServer_) {
+    config_.bias_diff_off = getBias("bias_diff_off");
+    config_.bias_diff_on = getBias("bias_diff_on");
+    config_.bias_fo = getBias("bias_fo");
+    config_.bias_hpf = getBias("bias_hpf");
+    config_.bias_pr = getBias("bias_pr");
+    config_.bias_refr = getBias("bias_refr");
+    configServer_->updateConfig(config_);
+  }
+}
+
+bool DriverROS1::seek(Seek::Request & req, Seek::Response & res)
+{
+  res.success = wrapper_ && wrapper_->seek(req.time);
+  res.message = std::string("seek ") + (res.success ? "succeeded" : "failed");
+  return (res.success);
+}
+
 int DriverROS1::getBias(const std::string & name) const
 {
   if (biasParameters_.find(name) != biasParameters_.end()) {
@@ -111,6 +267,17 @@ void DriverROS1::configure(Config & config, int level)
     config.bias_pr = getBias("bias_pr");
     config.bias_refr = getBias("bias_refr");
     ROS_INFO("initialized config to camera biases");
+    std::stringstream roi;
+    for (const auto & v : wrapper_->getROI()) {
+      roi << (roi.tellp() > 0 ? " " : "") << v;
+    }
+    config.roi_string = roi.str();
+    config.erc_mode = wrapper_->getEventRateControllerMode();
+    config.erc_rate = wrapper_->getEventRateControllerRate();
+    const auto & tf = wrapper_->getTrailFilter();
+    config.trail_filter = tf.enabled;
+    config.trail_filter_type = tf.type;
+    config.trail_filter_threshold = static_cast<int>(tf.threshold);
   } else {
     setBias(&config.bias_diff_off, "bias_diff_off");
     setBias(&config.bias_diff_on, "bias_diff_on");
@@ -118,20 +285,86 @@ void DriverROS1::configure(Config & config, int level)
     setBias(&config.bias_hpf, "bias_hpf");
     setBias(&config.bias_pr, "bias_pr");
     setBias(&config.bias_refr, "bias_refr");
+    updateRuntimeConfig(&config, level);
   }
   config_ = config;  // remember current values
 }
 
-bool DriverROS1::secondaryReadyCallback(Trigger::Request &, Trigger::Response & res)
+void DriverROS1::updateRuntimeConfig(Config * config, int level)
 {
-  res.success = true;
-  res.message += "succeeded";
-  return (true);
+  // the level bits are defined in MetaVisionDyn.cfg
+  std::string msg;
+  if (level & 1) {
+    std::vector<int> roi;
+    std::istringstream iss(config->roi_string);
+    int v;
+    while (iss >> v) {
+      roi.push_back(v);
+    }
+    if (!iss.eof()) {
+      ROS_WARN_STREAM("invalid roi string: " << config->roi_string);
+      config->roi_string = config_.roi_string;
+    } else if (!wrapper_->updateROI(roi, &msg)) {
+      ROS_WARN_STREAM("rejected roi: " << msg);
+      config->roi_string = config_.roi_string;
+    }
+  }
+  if (level & 2) {
+    if (!wrapper_->updateEventRateController(config->erc_mode, config->erc_rate, &msg)) {
+      ROS_WARN_STREAM("rejected event rate controller change: " << msg);
+      config->erc_mode = config_.erc_mode;
+      config->erc_rate = config_.erc_rate;
+    }
+  }
+  if (level & 4) {
+    if (!wrapper_->updateTrailFilter(
+          config->trail_filter_type, static_cast<uint32_t>(config->trail_filter_threshold),
+          config->trail_filter, &msg)) {
+      ROS_WARN_STREAM("rejected trail filter change: " << msg);
+      config->trail_filter = config_.trail_filter;
+      config->trail_filter_type = config_.trail_filter_type;
+      config->trail_filter_threshold = config_.trail_filter_threshold;
+    }
+  }
+}
+
+void DriverROS1::secondaryReadyCallback(const HeaderMsg::ConstPtr & msg)
+{
+  if (!secondaryIsReady_) {
+    secondaryIsReady_ = true;  // only start once
+    readySub_.shutdown();
+    ROS_INFO_STREAM("secondary " << msg->frame_id << " is up!");
+    start();  // only now can this be started
+  }
 }
 
 void DriverROS1::start()
 {
   wrapper_->setStatisticsInterval(nh_.param<double>("statistics_print_interval", 1.0));
+  wrapper_->setStatisticsLogging(nh_.param<bool>("statistics_log", true));
+  const int queueWarnSize = nh_.param<int>("statistics_queue_warn_size", 100);
+  const std::string statusName = ros::this_node::getName() + ": statistics";
+  wrapper_->setStatisticsCallback(
+    [this, statusName, queueWarnSize](const MetavisionWrapper::StatsReport & r) {
+      DiagnosticArrayMsg msg;
+      msg.header.stamp = ros::Time::now();
+      msg.status.push_back(make_statistics_status(r, statusName, queueWarnSize));
+      msg.status.back().hardware_id = wrapper_->getSerialNumber();
+      if (previewRenderer_) {
+        msg.status.back().values.push_back(make_key_value(
+          "preview_skipped_bytes", std::to_string(previewRenderer_->takeSkippedBytes())));
+      }
+      diagnosticsPub_.publish(msg);
+    });
+  tracingFile_ = nh_.param<std::string>("tracing_file", "metavision_trace.json");
+  Tracer::setBufferSize(std::max(nh_.param<int>("tracing_buffer_size", 1 << 16), 1));
+  if (nh_.param<bool>("tracing", false)) {
+    std::string msg;
+    Tracer::enable(true, tracingFile_, &msg);
+    ROS_INFO_STREAM(msg);
+  }
+  startTracingService_ = nh_.advertiseService("start_tracing", &DriverROS1::startTracing, this);
+  stopTracingService_ = nh_.advertiseService("stop_tracing", &DriverROS1::stopTracing, this);
   if (!wrapper_->initialize(
         nh_.param<bool>("use_multithreading", false), nh_.param<std::string>("bias_file", ""))) {
     ROS_ERROR("driver initialization failed!");
@@ -161,11 +394,15 @@ void DriverROS1::start()
   width_ = wrapper_->getWidth();
   height_ = wrapper_->getHeight();
   isBigEndian_ = check_endian::isBigEndian();
+  initializePreview();
+  initializeDecodedEvents();
+  initializeCompression();
+  initializeSharedMemory();
 
   // ------ start camera, may get callbacks from then on
   wrapper_->startCamera(this);
 
-  if (wrapper_->getFromFile().empty()) {
+  if (wrapper_->isLiveCamera()) {
     initializeBiasParameters(wrapper_->getSensorVersion());
     // hook up dynamic config server *after* the camera has
     // been initialized so we can read the bias values
@@ -173,6 +410,12 @@ void DriverROS1::start()
     configServer_->setCallback(boost::bind(&DriverROS1::configure, this, _1, _2));
 
     saveBiasService_ = nh_.advertiseService("save_biases", &DriverROS1::saveBiases, this);
+    setBiasesService_ = nh_.advertiseService("set_biases", &DriverROS1::setBiases, this);
+    if (biasController_.getConfig().targetRate > 0) {
+      initializeBiasController();
+    }
+  } else if (!wrapper_->getFromFile().empty()) {
+    seekService_ = nh_.advertiseService("seek", &DriverROS1::seek, this);
   }
 }
 
@@ -187,7 +430,14 @@ void DriverROS1::initializeBiasParameters(const std::string & sensorVersion)
 bool DriverROS1::stop()
 {
   if (wrapper_) {
-    return (wrapper_->stop());
+    const bool status = wrapper_->stop();
+    if (decodedWorker_) {
+      decodedWorker_->stop();  // no more packets arriving now
+    }
+    if (compressionPool_) {
+      compressionPool_->stop();
+    }
+    return (status);
   }
   return (false);
 }
@@ -215,11 +465,40 @@ static MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(
   return (config);
 }
 
+static ThreadConfig get_thread_config(const ros::NodeHandle & nh, const std::string & prefix)
+{
+  ThreadConfig config;
+  config.cpus = nh.param<std::vector<int>>(prefix + "_cpus", std::vector<int>());
+  config.policy = nh.param<std::string>(prefix + "_policy", "other");
+  config.priority = nh.param<int>(prefix + "_priority", 0);
+  return (config);
+}
+
 void DriverROS1::configureWrapper(const std::string & name)
 {
   wrapper_ = std::make_shared<MetavisionWrapper>(name);
   wrapper_->setSerialNumber(nh_.param<std::string>("serial", ""));
+  wrapper_->setOpenTimeout(nh_.param<double>("open_timeout", 5.0));
+  wrapper_->setReconnect(nh_.param<bool>("reconnect", true));
   wrapper_->setFromFile(nh_.param<std::string>("from_file", ""));
+  wrapper_->setUseNativeFileReader(nh_.param<bool>("native_file_reader", true));
+  wrapper_->setFileTimeRange(
+    nh_.param<double>("from_file_start_time", -1.0), nh_.param<double>("from_file_end_time", -1.0));
+  const std::string source = nh_.param<std::string>("source", "camera");
+  wrapper_->setSourceType(source);
+  if (source == "synthetic") {
+    MetavisionWrapper::SyntheticConfig sc;
+    sc.eventRate = nh_.param<double>("synthetic_event_rate", 1e6);
+    sc.width = nh_.param<int>("synthetic_width", 1280);
+    sc.height = nh_.param<int>("synthetic_height", 720);
+    sc.distribution = nh_.param<std::string>("synthetic_distribution", "uniform");
+    sc.burstPeriod = nh_.param<double>("synthetic_burst_period", 0.0);
+    sc.burstDutyCycle = nh_.param<double>("synthetic_burst_duty_cycle", 0.1);
+    sc.burstFactor = nh_.param<double>("synthetic_burst_factor", 10.0);
+    sc.packetTime = nh_.param<double>("synthetic_packet_time", 4e-3);
+    sc.realtime = nh_.param<bool>("synthetic_realtime", true);
+    wrapper_->setSyntheticConfig(sc);
+  }
   wrapper_->setSyncMode(nh_.param<std::string>("sync_mode", "standalone"));
   auto roi = nh_.param<std::vector<int>>("roi", std::vector<int>());
   if (!roi.empty()) {
@@ -240,7 +519,22 @@ void DriverROS1::configureWrapper(const std::string & name)
     nh_.param<std::string>("erc_mode", "na"),  // Event Rate Controller Mode
     nh_.param<int>("erc_rate", 100000000));    // Event Rate Controller Rate
 
+  wrapper_->setTrailFilter(
+    nh_.param<std::string>("trail_filter_type", "trail"),
+    static_cast<uint32_t>(std::max(nh_.param<int>("trail_filter_threshold", 0), 0)),
+    nh_.param<bool>("trail_filter", false));
+
   wrapper_->setMIPIFramePeriod(nh_.param<int>("mipi_frame_period", -1));
+  for (const auto & thread : {"processing", "stats", "source"}) {
+    wrapper_->setThreadConfig(thread, get_thread_config(nh_, std::string(thread) + "_thread"));
+  }
+  wrapper_->setBufferPool(
+    nh_.param<std::string>("buffer_pool_mode", "none"),
+    std::max(nh_.param<int>("buffer_pool_block_size", 1 << 20), 0),
+    std::max(nh_.param<int>("buffer_pool_num_blocks", 32), 0));
+  wrapper_->setHeapPrefaultSize(std::max(nh_.param<int>("heap_prefault_size", 16 << 20), 0));
+  wrapper_->setTuneHeap(nh_.param<bool>("tune_heap", false));
+  wrapper_->setTimeGapThreshold(std::max(nh_.param<int>("time_gap_threshold", 10000), 0));
 
   // Get information on external pin configuration per hardware setup
   if (wrapper_->triggerActive()) {
@@ -250,32 +544,65 @@ void DriverROS1::configureWrapper(const std::string & name)
 
 void DriverROS1::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end)
 {
-  if (eventPub_.getNumSubscribers() != 0) {
-    if (!msg_) {
-      msg_.reset(new EventPacketMsg());
-      msg_->header.frame_id = frameId_;
-      msg_->header.seq = seq_++;
-      msg_->time_base = 0;  // not used here
-      msg_->encoding = encoding_;
-      msg_->seq = msg_->header.seq;
-      msg_->width = width_;
-      msg_->height = height_;
-      msg_->header.stamp = ros::Time().fromNSec(t);
-      msg_->events.reserve(reserveSize_);
+  if (previewRenderer_ && previewPub_.getNumSubscribers() != 0) {
+    previewRenderer_->addData(start, end);  // decoded later by timer
+  }
+  const bool sendTriggers = triggerPub_.getNumSubscribers() != 0;
+  const bool sendRaw = eventPub_.getNumSubscribers() != 0;
+  const bool sendCompressed = compressionPool_ && compressedPub_.getNumSubscribers() != 0;
+  const bool sendDecoded = decodedWorker_ && decodedPub_.getNumSubscribers() != 0;
+  const bool sendShm = shmWriter_ && shmPub_.getNumSubscribers() != 0;
+  const bool assemble = sendRaw || sendCompressed || sendDecoded || sendShm;
+  if (assemble && !msg_) {
+    msg_.reset(new EventPacketMsg());
+    msg_->header.frame_id = frameId_;
+    msg_->header.seq = seq_++;
+    msg_->encoding = encoding_;
+    msg_->seq = msg_->header.seq;
+    msg_->width = width_;
+    msg_->height = height_;
+    msg_->header.stamp = ros::Time().fromNSec(t);
+    msg_->events.reserve(reservePolicy_.getReserveSize());
+    packetInfo_ = PacketInfo();
+  }
+  const bool countEvents = biasController_.isEnabled();
+  if (sendTriggers || assemble || countEvents) {
+    if (scanPaused_) {
+      // the scanner has missed data, possibly TIME_HIGH roll-overs as well
+      scanner_ = std::make_shared<RawScanner>(encoding_);
+      timeKeeper_ = std::make_shared<ROSTimeKeeper>(ros::this_node::getName());
+      scanPaused_ = false;
+    }
+    // one pass over the raw data for triggers, packet metadata and event count
+    triggers_.clear();
+    PacketInfo countInfo;
+    PacketInfo * info = assemble ? &packetInfo_ : (countEvents ? &countInfo : nullptr);
+    const uint64_t numEventsBefore = info ? info->numEvents : 0;
+    scanner_->scan(start, end, sendTriggers ? &triggers_ : nullptr, info);
+    if (countEvents) {
+      biasController_.addEvents(info->numEvents - numEventsBefore);
+    }
+    if (sendTriggers) {
+      publishTriggers(t);
     }
+  } else {
+    scanPaused_ = true;
+  }
+  if (decodedWorker_ && !sendDecoded) {
+    decodePaused_ = true;
+  }
+  if (assemble) {
     const size_t n = end - start;
     auto & events = msg_->events;
-    const size_t oldSize = events.size();
-    resize_hack(events, oldSize + n);
-    memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
-
-    if (t - lastMessageTime_ > messageThresholdTime_ || events.size() > messageThresholdSize_) {
-      reserveSize_ = std::max(reserveSize_, events.size());
-      wrapper_->updateBytesSent(events.size());
-      wrapper_->updateMsgsSent(1);
-      eventPub_.publish(std::move(msg_));
-      lastMessageTime_ = t;
-      msg_.reset();
+    {
+      TRACE_SCOPE("append", t);
+      const size_t oldSize = events.size();
+      resize_hack(events, oldSize + n);
+      memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
+    }
+
+    if (packetSizer_.isComplete(t, events.size(), packetInfo_)) {
+      sendMessage(t, sendRaw, sendCompressed, sendDecoded, sendShm);
     }
   } else {
     if (msg_) {
@@ -284,6 +611,344 @@ void DriverROS1::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_
   }
 }
 
+void DriverROS1::sendMessage(
+  uint64_t t, bool sendRaw, bool sendCompressed, bool sendDecoded, bool sendShm)
+{
+  auto & events = msg_->events;
+  reservePolicy_.update(events.size(), events.capacity());
+  if (reservePolicy_.takeTrimRequest()) {
+    wrapper_->requestHeapTrim();
+  }
+  msg_->time_base = packetInfo_.startTime * 1000;  // usec -> nsec
+  if (infoPub_.getNumSubscribers() != 0) {
+    publishPacketInfo();
+  }
+  if (sendShm) {
+    writeSharedMemory();
+  }
+  if (sendDecoded && decodePaused_) {
+    decodedWorker_->resetTime();  // the decoder has missed data
+    decodePaused_ = false;
+  }
+  if (sendCompressed || sendDecoded) {
+    // only copy the events if the raw message is sent as well
+    submitPacket(sendRaw, sendCompressed, sendDecoded);
+  }
+  if (sendRaw) {
+    wrapper_->updateBytesSent(events.size());
+    wrapper_->updateMsgsSent(1);
+    TRACE_SCOPE("publish", msg_->seq);
+    eventPub_.publish(std::move(msg_));
+  }
+  packetSizer_.messageSent(t, packetInfo_.numEvents);
+  lostTime_ = 0;
+  timeReset_ = false;
+  msg_.reset();
+}
+
+void DriverROS1::flushMessage()
+{
+  if (!msg_) {
+    return;
+  }
+  const bool sendRaw = eventPub_.getNumSubscribers() != 0;
+  const bool sendCompressed = compressionPool_ && compressedPub_.getNumSubscribers() != 0;
+  const bool sendDecoded = decodedWorker_ && decodedPub_.getNumSubscribers() != 0;
+  const bool sendShm = shmWriter_ && shmPub_.getNumSubscribers() != 0;
+  if (!(sendRaw || sendCompressed || sendDecoded || sendShm)) {
+    msg_.reset();
+    return;
+  }
+  sendMessage(ros::WallTime::now().toNSec(), sendRaw, sendCompressed, sendDecoded, sendShm);
+}
+
+void DriverROS1::publishPacketInfo()
+{
+  EventPacketInfoMsg::Ptr msg(new EventPacketInfoMsg());
+  msg->header = msg_->header;
+  msg->seq = msg_->seq;
+  msg->time_base = msg_->time_base;
+  msg->first_event_time = packetInfo_.firstTime * 1000;
+  msg->last_event_time = packetInfo_.lastTime * 1000;
+  msg->num_events = packetInfo_.numEvents;
+  msg->num_bytes = msg_->events.size();
+  msg->lost_time = lostTime_ * 1000;
+  msg->time_reset = timeReset_;
+  infoPub_.publish(msg);
+}
+
+void DriverROS1::publishTriggers(uint64_t t)
+{
+  // publish right away rather than waiting for the event message to fill up
+  if (!scanner_->hasValidTime()) {
+    return;
+  }
+  // scanner time is in usec, time keeper works in nanoseconds
+  const uint64_t rosTimeOffset = timeKeeper_->updateROSTimeOffset(scanner_->getTime() * 1e3, t);
+  for (const auto & trig : triggers_) {
+    ExtTriggerMsg::Ptr msg(new ExtTriggerMsg());
+    msg->sensor_time = trig.time * 1000;
+    const uint64_t stamp = rosTimeOffset + msg->sensor_time;
+    msg->header.frame_id = frameId_;
+    msg->header.stamp = ros::Time().fromNSec(stamp);
+    msg->id = trig.id;
+    msg->polarity = trig.polarity;
+    timeKeeper_->setLastROSTime(stamp);
+    triggerPub_.publish(msg);
+  }
+}
+
+void DriverROS1::initializePreview()
+{
+  const double rate = nh_.param<double>("preview_rate", 0.0);
+  if (rate <= 0) {
+    return;
+  }
+  std::string mode = nh_.param<std::string>("preview_mode", "count");
+  if (mode != "count" && mode != "time_surface") {
+    ROS_WARN_STREAM("invalid preview mode: " << mode << ", using count");
+    mode = "count";
+  }
+  const double decay = nh_.param<double>("preview_decay", 0.03);
+  ROS_INFO_STREAM("preview image with rate " << rate << "Hz, mode: " << mode);
+  previewPub_ = nh_.advertise<ImageMsg>("preview", 1);
+  previewRenderer_ = std::make_shared<PreviewRenderer>(encoding_, width_, height_, mode, decay);
+  previewTimer_ =
+    nh_.createWallTimer(ros::WallDuration(1.0 / rate), &DriverROS1::previewTimerExpired, this);
+}
+
+void DriverROS1::initializeBiasController()
+{
+  std::map<std::string, int> biases;
+  for (const auto & bp : biasParameters_) {
+    if (wrapper_->hasBias(bp.first)) {
+      biases[bp.first] = wrapper_->getBias(bp.first);
+    }
+  }
+  biasController_.initialize(wrapper_->getSensorVersion(), biases);
+  if (!biasController_.isEnabled()) {
+    ROS_WARN_STREAM(
+      "automatic bias control not supported for sensor " << wrapper_->getSensorVersion());
+    return;
+  }
+  const auto & config = biasController_.getConfig();
+  ROS_INFO_STREAM(
+    "bias control target: " << config.targetRate << " ev/s +- " << config.hysteresis * 100 << "%");
+  biasControlTimer_ = nh_.createWallTimer(
+    ros::WallDuration(config.interval), &DriverROS1::biasControlTimerExpired, this);
+}
+
+void DriverROS1::biasControlTimerExpired(const ros::WallTimerEvent &)
+{
+  std::map<std::string, int> current;
+  for (const auto & name : biasController_.getControlledBiases()) {
+    current[name] = wrapper_->getBias(name);
+  }
+  const auto changes = biasController_.update(current);
+  if (!changes.empty()) {
+    std::map<std::string, int> result;
+    std::string msg;
+    if (wrapper_->setBiases(changes, &result, &msg)) {
+      updateConfigBiases();
+      for (const auto & c : changes) {
+        current[c.first] = result[c.first];
+      }
+    }
+  }
+  DiagnosticArrayMsg msg;
+  msg.header.stamp = ros::Time::now();
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = ros::this_node::getName() + ": bias controller";
+  status.hardware_id = wrapper_->getSerialNumber();
+  status.level = biasController_.getState() == BiasController::SATURATED
+                   ? diagnostic_msgs::DiagnosticStatus::WARN
+                   : diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = biasController_.getStateName();
+  const auto & config = biasController_.getConfig();
+  status.values.push_back(make_key_value("target_rate", std::to_string(config.targetRate)));
+  status.values.push_back(
+    make_key_value("measured_rate", std::to_string(biasController_.getRate())));
+  for (const auto & b : current) {
+    status.values.push_back(make_key_value(b.first, std::to_string(b.second)));
+    status.values.push_back(make_key_value(
+      b.first + "_baseline", std::to_string(biasController_.getBaseline().at(b.first))));
+  }
+  msg.status.push_back(status);
+  diagnosticsPub_.publish(msg);
+}
+
+void DriverROS1::previewTimerExpired(const ros::WallTimerEvent &)
+{
+  if (previewPub_.getNumSubscribers() == 0) {
+    return;
+  }
+  ImageMsg::Ptr img(new ImageMsg());
+  if (!previewRenderer_->render(&img->data)) {
+    return;  // no new data
+  }
+  img->header.frame_id = frameId_;
+  img->header.stamp = ros::Time::now();
+  img->width = width_;
+  img->height = height_;
+  img->encoding = "mono8";
+  img->is_bigendian = isBigEndian_;
+  img->step = width_;
+  previewPub_.publish(img);
+}
+
+void DriverROS1::initializeDecodedEvents()
+{
+  if (!nh_.param<bool>("publish_decoded_events", false)) {
+    return;
+  }
+  ROS_INFO_STREAM("publishing decoded events");
+  decodedPub_ = nh_.advertise<DecodedEventsMsg>("decoded_events", 100);
+  const int maxInFlight = nh_.param<int>("decoder_max_in_flight", 16);
+  decodedWorker_ = std::make_shared<DecodedEventsWorker>(
+    ros::this_node::getName(), encoding_, static_cast<size_t>(std::max(maxInFlight, 1)));
+  decodedWorker_->start(
+    std::bind(&DriverROS1::publishDecodedEvents, this, std::placeholders::_1),
+    get_thread_config(nh_, "decoder_thread"));
+  auto worker = decodedWorker_;
+  wrapper_->addStatsReporter([worker]() { return (worker->getStatsReport()); });
+}
+
+void DriverROS1::publishDecodedEvents(DecodedEventsWorker::Job * job)
+{
+  // runs on the decoder thread, called in message order
+  DecodedEventsMsg::Ptr msg(new DecodedEventsMsg());
+  msg->header.frame_id = frameId_;
+  msg->header.seq = job->packet.seq;
+  msg->header.stamp = ros::Time().fromNSec(job->packet.stamp);
+  msg->width = width_;
+  msg->height = height_;
+  msg->seq = job->packet.seq;
+  msg->time_base = job->events.timeBase;
+  msg->x.swap(job->events.x);
+  msg->y.swap(job->events.y);
+  msg->polarity.swap(job->events.polarity);
+  msg->t.swap(job->events.t);
+  decodedPub_.publish(msg);
+}
+
+void DriverROS1::initializeCompression()
+{
+  const std::string method = nh_.param<std::string>("compression", "none");
+  if (method == "none") {
+    return;
+  }
+  if (!Compressor::isSupported(method)) {
+    ROS_WARN_STREAM("compression method " << method << " not available, not compressing!");
+    return;
+  }
+  const int level = nh_.param<int>("compression_level", 1);
+  const int numThreads = nh_.param<int>("compression_threads", 2);
+  const int maxInFlight = nh_.param<int>("compression_max_in_flight", 16);
+  ROS_INFO_STREAM(
+    "compressing with " << method << " level " << level << " on " << numThreads << " threads");
+  compressedPub_ =
+    nh_.advertise<EventPacketMsg>("events_compressed", nh_.param<int>("send_queue_size", 1000));
+  compressionPool_ = std::make_shared<CompressionPool>(
+    ros::this_node::getName(), method, level, numThreads,
+    static_cast<size_t>(std::max(maxInFlight, 1)));
+  compressionPool_->start(
+    std::bind(&DriverROS1::publishCompressed, this, std::placeholders::_1),
+    get_thread_config(nh_, "compression_thread"));
+  auto pool = compressionPool_;
+  wrapper_->addStatsReporter([pool]() { return (pool->getStatsReport()); });
+}
+
+void DriverROS1::submitPacket(bool copyEvents, bool compress, bool decode)
+{
+  // hands the current message to the post-processing stages
+  auto events = std::make_shared<std::vector<uint8_t>>();
+  if (copyEvents) {
+    events->assign(msg_->events.begin(), msg_->events.end());
+  } else {
+    events->swap(msg_->events);
+  }
+  EventPacketData packet;
+  packet.seq = msg_->seq;
+  packet.stamp = msg_->header.stamp.toNSec();
+  packet.timeBase = msg_->time_base;
+  packet.events = events;
+  if (compress && !compressionPool_->submit(packet)) {
+    ROS_WARN_THROTTLE(1.0, "compression falling behind, dropping message!");
+    wrapper_->updateMsgsDropped(1);
+  }
+  if (decode && !decodedWorker_->submit(packet)) {
+    ROS_WARN_THROTTLE(1.0, "decoder falling behind, dropping message!");
+    wrapper_->updateMsgsDropped(1);
+  }
+}
+
+void DriverROS1::publishCompressed(CompressionPool::Job * job)
+{
+  // runs on a compression thread, called in message order
+  wrapper_->updateCompressionStats(job->packet.events->size(), job->compressed.size());
+  EventPacketMsg::Ptr msg(new EventPacketMsg());
+  msg->header.frame_id = frameId_;
+  msg->header.seq = job->packet.seq;
+  msg->header.stamp = ros::Time().fromNSec(job->packet.stamp);
+  msg->time_base = job->packet.timeBase;
+  msg->encoding = encoding_ + "-" + compressionPool_->getMethod();
+  msg->seq = job->packet.seq;
+  msg->width = width_;
+  msg->height = height_;
+  msg->is_bigendian = isBigEndian_;
+  msg->events.swap(job->compressed);
+  compressedPub_.publish(msg);
+}
+
+void DriverROS1::initializeSharedMemory()
+{
+  const std::string name = nh_.param<std::string>("shm_ring_name", "");
+  if (name.empty()) {
+    return;
+  }
+  const int size = nh_.param<int>("shm_ring_size", 256 << 20);
+  const int numSlots = nh_.param<int>("shm_ring_slots", 1024);
+  shmWriter_ = std::make_shared<ShmRingWriter>();
+  std::string error;
+  if (!shmWriter_->create(
+        name, static_cast<size_t>(std::max(size, 0)),
+        static_cast<uint32_t>(std::max(numSlots, 0)), encoding_, width_, height_, isBigEndian_,
+        &error)) {
+    ROS_ERROR_STREAM("cannot create shared memory ring: " << error);
+    shmWriter_.reset();
+    return;
+  }
+  ROS_INFO_STREAM("writing events to shared memory ring " << name << " of size " << size);
+  shmPub_ = nh_.advertise<EventPacketMsg>("events_shm", nh_.param<int>("send_queue_size", 1000));
+}
+
+void DriverROS1::writeSharedMemory()
+{
+  // the payload goes into the ring, the notification has no events
+  shm_ring::Record rec;
+  rec.seq = msg_->seq;
+  rec.size = msg_->events.size();
+  rec.stamp = msg_->header.stamp.toNSec();
+  rec.timeBase = msg_->time_base;
+  rec.firstEventTime = packetInfo_.firstTime * 1000;
+  rec.lastEventTime = packetInfo_.lastTime * 1000;
+  rec.numEvents = packetInfo_.numEvents;
+  if (!shmWriter_->write(rec, msg_->events.data())) {
+    ROS_WARN_THROTTLE(1.0, "message too large for shared memory ring, dropped!");
+    wrapper_->updateMsgsDropped(1);
+    return;
+  }
+  EventPacketMsg::Ptr msg(new EventPacketMsg());
+  msg->header = msg_->header;
+  msg->time_base = msg_->time_base;
+  msg->encoding = msg_->encoding;
+  msg->seq = msg_->seq;
+  msg->width = width_;
+  msg->height = height_;
+  msg->is_bigendian = isBigEndian_;
+  shmPub_.publish(msg);
+}
+
 void DriverROS1::eventCDCallback(
   uint64_t, const Metavision::EventCD * start, const Metavision::EventCD * end)
 {
@@ -304,4 +969,37 @@ void DriverROS1::eventCDCallback(
   }
 }
 
+void DriverROS1::sourceRestarted()
+{
+  resetSensorTime();
+  ROS_INFO_STREAM("source restarted, continuing with sequence number " << seq_);
+}
+
+void DriverROS1::sensorTimeGap(uint64_t lostTime, bool isReset)
+{
+  if (isReset) {
+    // the message being assembled has the data from before the reset,
+    // so the reset is reported with the next one
+    resetSensorTime();
+    timeReset_ = true;
+  }
+  // reported in the packet info of the next message sent
+  lostTime_ += lostTime;
+}
+
+void DriverROS1::resetSensorTime()
+{
+  // sensor time starts over: send the partial message first
+  flushMessage();
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(ros::this_node::getName());
+  // the decoders downstream would take the step back for a roll-over
+  if (decodedWorker_) {
+    decodedWorker_->resetTime();
+  }
+  if (previewRenderer_) {
+    previewRenderer_->resetTime();
+  }
+}
+
 }  // namespace metavision_driver
@@ -15,20 +15,90 @@
 
 #include "metavision_driver/driver_ros2.h"
 
+#include <algorithm>
 #include <chrono>
 #include <event_camera_msgs/msg/event_packet.hpp>
+#include <limits>
 #include <map>
 #include <rclcpp/parameter_events_filter.hpp>
 #include <rclcpp_components/register_node_macro.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "metavision_driver/check_endian.h"
+#include "metavision_driver/compressor.h"
 #include "metavision_driver/logging.h"
 #include "metavision_driver/metavision_wrapper.h"
+#include "metavision_driver/parameters_ros2.h"
+#include "metavision_driver/tracing.h"
 
 namespace metavision_driver
 {
+// parameters that can be changed while the camera is streaming
+static const std::set<std::string> runtimeParameters = {
+  "roi", "erc_mode", "erc_rate", "trail_filter", "trail_filter_type", "trail_filter_threshold"};
+
+static diagnostic_msgs::msg::KeyValue make_key_value(
+  const std::string & key, const std::string & value)
+{
+  diagnostic_msgs::msg::KeyValue kv;
+  kv.key = key;
+  kv.value = value;
+  return (kv);
+}
+
+static diagnostic_msgs::msg::DiagnosticStatus make_statistics_status(
+  const MetavisionWrapper::StatsReport & r, const std::string & name, int queueWarnSize)
+{
+  using Status = diagnostic_msgs::msg::DiagnosticStatus;
+  Status status;
+  status.name = name;
+  const bool queueBackedUp = static_cast<int>(r.maxQueueSize) > queueWarnSize;
+  status.level = Status::WARN;
+  if (r.msgsDropped != 0) {
+    status.message = "dropping messages";
+  } else if (r.numTimeGaps != 0) {
+    status.message = "sensor data lost";
+  } else if (r.numTimeResets != 0) {
+    status.message = "sensor clock reset";
+  } else if (queueBackedUp) {
+    status.message = "processing queue backed up";
+  } else {
+    status.level = Status::OK;
+    status.message = "ok";
+  }
+  status.values.push_back(make_key_value("interval", std::to_string(r.interval)));
+  status.values.push_back(make_key_value("bytes_in_rate_mbps", std::to_string(r.bytesInRate)));
+  status.values.push_back(make_key_value("bytes_out_rate_mbps", std::to_string(r.bytesOutRate)));
+  status.values.push_back(make_key_value("msgs_in_rate", std::to_string(r.msgsInRate)));
+  status.values.push_back(make_key_value("msgs_out_rate", std::to_string(r.msgsOutRate)));
+  status.values.push_back(make_key_value("msgs_dropped", std::to_string(r.msgsDropped)));
+  status.values.push_back(make_key_value("queue_size", std::to_string(r.queueSize)));
+  status.values.push_back(make_key_value("max_queue_size", std::to_string(r.maxQueueSize)));
+  status.values.push_back(make_key_value("latency_p50_us", std::to_string(r.latencyP50)));
+  status.values.push_back(make_key_value("latency_p90_us", std::to_string(r.latencyP90)));
+  status.values.push_back(make_key_value("latency_p99_us", std::to_string(r.latencyP99)));
+  status.values.push_back(make_key_value("latency_max_us", std::to_string(r.latencyMax)));
+  status.values.push_back(make_key_value("cpu_load_percent", std::to_string(r.cpuLoad)));
+  status.values.push_back(make_key_value("page_fault_rate", std::to_string(r.pageFaultRate)));
+  status.values.push_back(make_key_value("compression_ratio", std::to_string(r.compressionRatio)));
+  status.values.push_back(make_key_value("compressed_rate_mbps", std::to_string(r.compressedRate)));
+  status.values.push_back(make_key_value("num_reconnects", std::to_string(r.numReconnects)));
+  status.values.push_back(make_key_value("time_gaps", std::to_string(r.numTimeGaps)));
+  status.values.push_back(make_key_value("time_resets", std::to_string(r.numTimeResets)));
+  status.values.push_back(make_key_value("lost_time_ms", std::to_string(r.lostTime)));
+  for (const auto & u : r.threads) {
+    const std::string prefix = "thread_" + u.name;
+    status.values.push_back(make_key_value(prefix + "_cpu_percent", std::to_string(u.cpuLoad)));
+    status.values.push_back(
+      make_key_value(prefix + "_voluntary_switch_rate", std::to_string(u.voluntarySwitchRate)));
+    status.values.push_back(
+      make_key_value(prefix + "_involuntary_switch_rate", std::to_string(u.involuntarySwitchRate)));
+  }
+  return (status);
+}
+
 DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
 : Node(
     "metavision_driver",
@@ -37,45 +107,52 @@ DriverROS2::DriverROS2(const rclcpp::NodeOptions & options)
   configureWrapper(get_name());
 
   this->get_parameter_or("encoding", encoding_, std::string("evt3"));
-  if (encoding_ != "evt3") {
+  if (!is_supported_encoding(encoding_)) {
     LOG_ERROR("invalid encoding: " << encoding_);
     throw std::runtime_error("invalid encoding!");
   }
-  double mtt;
-  this->get_parameter_or("event_message_time_threshold", mtt, 1e-3);
-  messageThresholdTime_ = uint64_t(std::abs(mtt) * 1e9);
-  int64_t mts;
-  this->get_parameter_or("event_message_size_threshold", mts, int64_t(1000000000));
-  messageThresholdSize_ = static_cast<size_t>(std::abs(mts));
+  wrapper_->setRequestedEncoding(encoding_);
+  packetSizer_.setConfig(get_packet_sizer_config(this, std::string()));
+  if (packetSizer_.isAdaptive()) {
+    wrapper_->addStatsReporter([this]() { return (packetSizer_.getStatsReport()); });
+  }
+  reservePolicy_.setConfig(get_reserve_policy_config(this, std::string()));
+  biasController_.setConfig(get_bias_controller_config(this, std::string()));
+  wrapper_->addStatsReporter([this]() { return (reservePolicy_.getStatsReport()); });
 
   int qs;
   this->get_parameter_or("send_queue_size", qs, 1000);
   eventPub_ = this->create_publisher<EventPacketMsg>(
     "~/events", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  infoPub_ = this->create_publisher<EventPacketInfoMsg>(
+    "~/events_info", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(get_name());
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  triggerPub_ = this->create_publisher<ExtTriggerMsg>("~/trigger", rclcpp::QoS(100));
+  diagnosticsPub_ = this->create_publisher<DiagnosticArrayMsg>("/diagnostics", rclcpp::QoS(10));
 
   if (wrapper_->getSyncMode() == "primary") {
-    // delay primary until secondary is up and running
-    // need to delay this to finish the constructor and release the thread
-    oneOffTimer_ = this->create_wall_timer(std::chrono::seconds(1), [=]() {
-      oneOffTimer_->cancel();
-      auto client = this->create_client<Trigger>("~/ready");
-      while (!client->wait_for_service(std::chrono::seconds(1))) {
-        if (!rclcpp::ok()) {
-          RCLCPP_ERROR(this->get_logger(), "Interrupted!");
-          throw std::runtime_error("interrupted!");
+    // delay primary until secondary is up and running. The ready topic
+    // is transient local, so the message arrives as soon as both are up.
+    LOG_INFO("primary waiting for secondary...");
+    readySub_ = this->create_subscription<HeaderMsg>(
+      "~/ready", rclcpp::QoS(1).reliable().transient_local(),
+      [this](HeaderMsg::ConstSharedPtr msg) {
+        if (!secondaryIsReady_) {
+          secondaryIsReady_ = true;  // only start once
+          LOG_INFO("secondary " << msg->frame_id << " is up!");
+          start();  // only now can this be started
         }
-        RCLCPP_INFO(this->get_logger(), "primary waiting for secondary...");
-      }
-      RCLCPP_INFO_STREAM(this->get_logger(), "secondary is up!");
-      start();  // only now can this be started
-    });
+      });
   } else if (wrapper_->getSyncMode() == "secondary") {
     start();
-    // creation of server signals to primary that we are ready.
-    // We don't handle the callback
-    secondaryReadyServer_ = this->create_service<Trigger>(
-      "~/ready",
-      [=](const std::shared_ptr<Trigger::Request>, std::shared_ptr<Trigger::Response>) {});
+    // signal to the primary that we are ready
+    readyPub_ = this->create_publisher<HeaderMsg>(
+      "~/ready", rclcpp::QoS(1).reliable().transient_local());
+    HeaderMsg::UniquePtr ready(new HeaderMsg());
+    ready->stamp = this->get_clock()->now();
+    ready->frame_id = frameId_;
+    readyPub_->publish(std::move(ready));
   } else {
     // standalone mode
     start();
@@ -86,6 +163,11 @@ DriverROS2::~DriverROS2()
 {
   stop();
   wrapper_.reset();  // invoke destructor
+  if (Tracer::isEnabled()) {
+    std::string msg;
+    Tracer::enable(false, tracingFile_, &msg);
+    LOG_INFO(msg);
+  }
 }
 
 void DriverROS2::saveBiases(
@@ -101,6 +183,22 @@ void DriverROS2::saveBiases(
   response->message += (response->success ? "succeeded" : "failed");
 }
 
+void DriverROS2::enableTracing(
+  bool enable, const std::shared_ptr<Trigger::Request> request,
+  const std::shared_ptr<Trigger::Response> response)
+{
+  (void)request;
+  response->success = Tracer::enable(enable, tracingFile_, &response->message);
+  LOG_INFO(response->message);
+}
+
+void DriverROS2::seek(
+  const std::shared_ptr<Seek::Request> request, const std::shared_ptr<Seek::Response> response)
+{
+  response->success = wrapper_ && wrapper_->seek(request->time);
+  response->message = std::string("seek ") + (response->success ? "succeeded" : "failed");
+}
+
 rcl_interfaces::msg::SetParametersResult DriverROS2::parameterChanged(
   const std::vector<rclcpp::Parameter> & params)
 {
@@ -111,10 +209,31 @@ rcl_interfaces::msg::SetParametersResult DriverROS2::parameterChanged(
     const auto it = biasParameters_.find(p.get_name());
     if (it != biasParameters_.end()) {
       if (wrapper_) {
-        // TODO(Bernd): check value if possible and reject if out of bounds
-        res.successful = true;
+        // same check as for the set_biases service
+        if (p.get_type() != rclcpp::ParameterType::PARAMETER_INTEGER) {
+          res.successful = false;
+          res.reason = "wrong type for " + p.get_name();
+        } else {
+          // clamp such that large values don't wrap into the valid range
+          const int64_t v = std::min(
+            std::max(p.as_int(), static_cast<int64_t>(std::numeric_limits<int>::min())),
+            static_cast<int64_t>(std::numeric_limits<int>::max()));
+          res.successful = wrapper_->checkBias(p.get_name(), static_cast<int>(v), &res.reason);
+        }
+        if (!res.successful) {
+          LOG_WARN("rejected change of " << p.get_name() << ": " << res.reason);
+          return (res);  // rejects the whole set
+        }
         res.reason = "successfully set";
       }
+    } else if (runtimeParameters.count(p.get_name()) != 0) {
+      if (wrapper_) {
+        // only check here, the hardware is changed in onParameterEvent()
+        res = checkRuntimeParameter(p);
+        if (!res.successful) {
+          return (res);  // rejects the whole set
+        }
+      }
     } else {
       res.successful = true;
       res.reason = "ignored unknown bias";
@@ -123,6 +242,152 @@ rcl_interfaces::msg::SetParametersResult DriverROS2::parameterChanged(
   return (res);
 }
 
+rcl_interfaces::msg::SetParametersResult DriverROS2::checkRuntimeParameter(
+  const rclcpp::Parameter & p)
+{
+  rcl_interfaces::msg::SetParametersResult res;
+  res.successful = false;
+  const std::string & name = p.get_name();
+  try {
+    if (name == "roi") {
+      const auto roi = p.as_integer_array();
+      res.successful = wrapper_->checkROI(std::vector<int>(roi.begin(), roi.end()), &res.reason);
+    } else if (name == "erc_mode") {
+      res.successful = wrapper_->checkEventRateController(
+        p.as_string(), wrapper_->getEventRateControllerRate(), &res.reason);
+    } else if (name == "erc_rate") {
+      if (p.as_int() > std::numeric_limits<int>::max()) {
+        res.reason = "erc_rate is too large";
+      } else {
+        res.successful = wrapper_->checkEventRateController(
+          wrapper_->getEventRateControllerMode(), static_cast<int>(p.as_int()), &res.reason);
+      }
+    } else if (name == "trail_filter") {
+      p.as_bool();  // throws if wrong type
+      res.successful = true;
+    } else if (name == "trail_filter_type") {
+      res.successful = wrapper_->checkTrailFilter(p.as_string(), true, &res.reason);
+    } else if (name == "trail_filter_threshold") {
+      if (p.as_int() < 0 || p.as_int() > std::numeric_limits<uint32_t>::max()) {
+        res.reason = "trail_filter_threshold must be a positive 32 bit number";
+      } else {
+        res.successful = true;
+      }
+    }
+  } catch (const rclcpp::ParameterTypeException & e) {
+    res.reason = "wrong type for " + name;
+  }
+  if (res.successful) {
+    res.reason = "successfully set";
+  } else {
+    LOG_WARN("rejected change of " << name << ": " << res.reason);
+  }
+  return (res);
+}
+
+void DriverROS2::applyRuntimeParameters(const std::map<std::string, rclcpp::Parameter> & changed)
+{
+  // the values have been checked, but the hardware may still refuse them
+  const auto has = [&changed](const std::string & name) { return (changed.count(name) != 0); };
+  std::string msg;
+  if (has("roi")) {
+    const auto v = changed.at("roi").as_integer_array();
+    const std::vector<int> roi(v.begin(), v.end());
+    if (roi != wrapper_->getROI() && !wrapper_->updateROI(roi, &msg)) {
+      LOG_WARN("cannot change roi: " << msg);
+    }
+  }
+  if (has("erc_mode") || has("erc_rate")) {
+    const std::string mode =
+      has("erc_mode") ? changed.at("erc_mode").as_string() : wrapper_->getEventRateControllerMode();
+    const int rate = has("erc_rate") ? static_cast<int>(changed.at("erc_rate").as_int())
+                                     : wrapper_->getEventRateControllerRate();
+    if (
+      (mode != wrapper_->getEventRateControllerMode() ||
+       rate != wrapper_->getEventRateControllerRate()) &&
+      !wrapper_->updateEventRateController(mode, rate, &msg)) {
+      LOG_WARN("cannot change event rate controller: " << msg);
+    }
+  }
+  if (has("trail_filter") || has("trail_filter_type") || has("trail_filter_threshold")) {
+    const auto tf = wrapper_->getTrailFilter();
+    const bool enabled = has("trail_filter") ? changed.at("trail_filter").as_bool() : tf.enabled;
+    const std::string type =
+      has("trail_filter_type") ? changed.at("trail_filter_type").as_string() : tf.type;
+    const uint32_t threshold =
+      has("trail_filter_threshold")
+        ? static_cast<uint32_t>(changed.at("trail_filter_threshold").as_int())
+        : tf.threshold;
+    if (
+      (enabled != tf.enabled || type != tf.type || threshold != tf.threshold) &&
+      !wrapper_->updateTrailFilter(type, threshold, enabled, &msg)) {
+      LOG_WARN("cannot change trail filter: " << msg);
+    }
+  }
+  // On failure the wrapper keeps the previous settings, so feed them
+  // back. This causes another event, but without changes.
+  updateRuntimeParameters();
+}
+
+void DriverROS2::updateRuntimeParameters()
+{
+  const auto & roi = wrapper_->getROI();
+  const auto & tf = wrapper_->getTrailFilter();
+  const std::vector<rclcpp::Parameter> current = {
+    rclcpp::Parameter("roi", std::vector<int64_t>(roi.begin(), roi.end())),
+    rclcpp::Parameter("erc_mode", wrapper_->getEventRateControllerMode()),
+    rclcpp::Parameter("erc_rate", static_cast<int64_t>(wrapper_->getEventRateControllerRate())),
+    rclcpp::Parameter("trail_filter", tf.enabled),
+    rclcpp::Parameter("trail_filter_type", tf.type),
+    rclcpp::Parameter("trail_filter_threshold", static_cast<int64_t>(tf.threshold))};
+  std::vector<rclcpp::Parameter> params;
+  for (const auto & p : current) {
+    if (
+      this->has_parameter(p.get_name()) &&
+      this->get_parameter(p.get_name()).get_parameter_value() != p.get_parameter_value()) {
+      params.push_back(p);
+    }
+  }
+  if (!params.empty()) {
+    this->set_parameters(params);
+  }
+}
+
+void DriverROS2::declareRuntimeParameter(
+  const std::string & name, const rclcpp::ParameterValue & value, const std::string & info)
+{
+  if (this->has_parameter(name)) {
+    return;  // already declared from launch file overrides
+  }
+  rcl_interfaces::msg::ParameterDescriptor pd;
+  pd.name = name;
+  pd.description = info;
+  this->declare_parameter(name, value, pd, false);
+}
+
+void DriverROS2::declareRuntimeParameters()
+{
+  const auto & roi = wrapper_->getROI();
+  const auto & tf = wrapper_->getTrailFilter();
+  declareRuntimeParameter(
+    "roi", rclcpp::ParameterValue(std::vector<int64_t>(roi.begin(), roi.end())),
+    "regions of interest as x, y, width, height, ..., empty for full sensor");
+  declareRuntimeParameter(
+    "erc_mode", rclcpp::ParameterValue(wrapper_->getEventRateControllerMode()),
+    "event rate controller: enabled, disabled, na");
+  const int64_t ercRate = wrapper_->getEventRateControllerRate();
+  declareRuntimeParameter(
+    "erc_rate", rclcpp::ParameterValue(ercRate), "event rate controller limit in events/sec");
+  declareRuntimeParameter(
+    "trail_filter", rclcpp::ParameterValue(tf.enabled), "trail filter on/off");
+  declareRuntimeParameter(
+    "trail_filter_type", rclcpp::ParameterValue(tf.type),
+    "trail filter type: trail, stc_cut_trail, stc_keep_trail");
+  declareRuntimeParameter(
+    "trail_filter_threshold", rclcpp::ParameterValue(static_cast<int64_t>(tf.threshold)),
+    "trail filter threshold in usec");
+}
+
 void DriverROS2::onParameterEvent(std::shared_ptr<const rcl_interfaces::msg::ParameterEvent> event)
 {
   if (event->node != this->get_fully_qualified_name()) {
@@ -132,39 +397,84 @@ void DriverROS2::onParameterEvent(std::shared_ptr<const rcl_interfaces::msg::Par
   for (auto it = biasParameters_.begin(); it != biasParameters_.end(); ++it) {
     validEvents.push_back(it->first);
   }
+  validEvents.insert(validEvents.end(), runtimeParameters.begin(), runtimeParameters.end());
   // need to make copy to work around Foxy API
   auto ev = std::make_shared<rcl_interfaces::msg::ParameterEvent>(*event);
   rclcpp::ParameterEventsFilter filter(
     ev, validEvents, {rclcpp::ParameterEventsFilter::EventType::CHANGED});
+  std::map<std::string, int> changed;
+  std::map<std::string, rclcpp::Parameter> changedRuntime;
   for (auto & it : filter.get_events()) {
     const std::string & name = it.second->name;
     const auto bp_it = biasParameters_.find(name);
     if (bp_it != biasParameters_.end()) {
       if (wrapper_) {
-        // apply bias to SDK. The driver may adjust the parameter value!
-        const int oldVal = wrapper_->getBias(name);
         const int val = it.second->value.integer_value;
-        if (oldVal != val) {
-          const int newVal = wrapper_->setBias(name, val);
-          if (val != newVal) {
-            // communicate adjusted value to ROS world
-            this->set_parameter(rclcpp::Parameter(name, newVal));
-          }
+        if (wrapper_->getBias(name) != val) {
+          changed[name] = val;
         }
       }
+    } else if (runtimeParameters.count(name) != 0) {
+      changedRuntime.emplace(name, rclcpp::Parameter::from_parameter_msg(*it.second));
+    }
+  }
+  if (wrapper_ && !changedRuntime.empty()) {
+    applyRuntimeParameters(changedRuntime);
+  }
+  if (changed.empty()) {
+    return;
+  }
+  // biases set atomically arrive in one event and go to the SDK in one pass
+  std::map<std::string, int> result;
+  std::string msg;
+  wrapper_->setBiases(changed, &result, &msg);
+  // The driver may adjust or reject the values, so feed back what the
+  // camera now has. This causes another event, but without changes.
+  for (auto & b : changed) {
+    b.second = wrapper_->getBias(b.first);
+  }
+  updateBiasParameters(changed);
+}
+
+void DriverROS2::updateBiasParameters(const std::map<std::string, int> & biases)
+{
+  std::vector<rclcpp::Parameter> params;
+  for (const auto & b : biases) {
+    if (
+      biasParameters_.count(b.first) != 0 && this->has_parameter(b.first) &&
+      this->get_parameter(b.first).as_int() != b.second) {
+      params.push_back(rclcpp::Parameter(b.first, b.second));
     }
   }
+  if (!params.empty()) {
+    this->set_parameters(params);
+  }
 }
 
-std::vector<std::string> split_string(const std::string & s)
+void DriverROS2::setBiases(
+  const std::shared_ptr<SetBiases::Request> request,
+  const std::shared_ptr<SetBiases::Response> response)
 {
-  std::stringstream ss(s);
-  std::string tmp;
-  std::vector<std::string> words;
-  while (getline(ss, tmp, '.')) {
-    words.push_back(tmp);
+  response->success = false;
+  if (request->names.size() != request->values.size()) {
+    response->message = "names and values must have the same length";
+    return;
+  }
+  std::map<std::string, int> biases;
+  for (size_t i = 0; i < request->names.size(); i++) {
+    biases[request->names[i]] = request->values[i];
+  }
+  std::map<std::string, int> result;
+  if (wrapper_) {
+    response->success = wrapper_->setBiases(biases, &result, &response->message);
+  }
+  for (const auto & b : result) {
+    response->names.push_back(b.first);
+    response->values.push_back(b.second);
+  }
+  if (response->success) {
+    updateBiasParameters(result);
   }
-  return (words);
 }
 
 void DriverROS2::addBiasParameter(const std::string & name, const BiasParameter & bp)
@@ -224,6 +534,25 @@ void DriverROS2::start()
   double printInterval;
   this->get_parameter_or("statistics_print_interval", printInterval, 1.0);
   wrapper_->setStatisticsInterval(printInterval);
+  bool logStatistics;
+  this->get_parameter_or("statistics_log", logStatistics, true);
+  wrapper_->setStatisticsLogging(logStatistics);
+  int queueWarnSize;
+  this->get_parameter_or("statistics_queue_warn_size", queueWarnSize, 100);
+  const std::string statusName = std::string(this->get_name()) + ": statistics";
+  wrapper_->setStatisticsCallback(
+    [this, statusName, queueWarnSize](const MetavisionWrapper::StatsReport & r) {
+      DiagnosticArrayMsg::UniquePtr msg(new DiagnosticArrayMsg());
+      msg->header.stamp = this->now();
+      msg->status.push_back(make_statistics_status(r, statusName, queueWarnSize));
+      msg->status.back().hardware_id = wrapper_->getSerialNumber();
+      if (previewRenderer_) {
+        msg->status.back().values.push_back(make_key_value(
+          "preview_skipped_bytes", std::to_string(previewRenderer_->takeSkippedBytes())));
+      }
+      diagnosticsPub_->publish(std::move(msg));
+    });
+  initializeTracing();
   std::string biasFile;
   this->get_parameter_or("bias_file", biasFile, std::string(""));
   if (!wrapper_->initialize(useMT, biasFile)) {
@@ -257,12 +586,20 @@ void DriverROS2::start()
   width_ = wrapper_->getWidth();
   height_ = wrapper_->getHeight();
   isBigEndian_ = check_endian::isBigEndian();
+  initializePreview();
+  initializeDecodedEvents();
+  initializeCompression();
+  initializeSharedMemory();
 
   // ------ start camera, may get callbacks from then on
   wrapper_->startCamera(this);
 
-  if (wrapper_->getFromFile().empty()) {
+  if (wrapper_->isLiveCamera()) {
     declareBiasParameters(wrapper_->getSensorVersion());
+    declareRuntimeParameters();
+    if (biasController_.getConfig().targetRate > 0) {
+      initializeBiasController();
+    }
     callbackHandle_ = this->add_on_set_parameters_callback(
       std::bind(&DriverROS2::parameterChanged, this, std::placeholders::_1));
     parameterSubscription_ = rclcpp::AsyncParametersClient::on_parameter_event(
@@ -272,136 +609,119 @@ void DriverROS2::start()
     saveBiasesService_ = this->create_service<Trigger>(
       "save_biases",
       std::bind(&DriverROS2::saveBiases, this, std::placeholders::_1, std::placeholders::_2));
+    setBiasesService_ = this->create_service<SetBiases>(
+      "set_biases",
+      std::bind(&DriverROS2::setBiases, this, std::placeholders::_1, std::placeholders::_2));
+  } else if (!wrapper_->getFromFile().empty()) {
+    seekService_ = this->create_service<Seek>(
+      "~/seek", std::bind(&DriverROS2::seek, this, std::placeholders::_1, std::placeholders::_2));
   }
 }
 
-bool DriverROS2::stop()
+void DriverROS2::initializeTracing()
 {
-  if (wrapper_) {
-    return (wrapper_->stop());
+  this->get_parameter_or("tracing_file", tracingFile_, std::string("metavision_trace.json"));
+  int bufferSize;
+  this->get_parameter_or("tracing_buffer_size", bufferSize, 1 << 16);
+  Tracer::setBufferSize(std::max(bufferSize, 1));
+  bool tracing;
+  this->get_parameter_or("tracing", tracing, false);
+  if (tracing) {
+    std::string msg;
+    Tracer::enable(true, tracingFile_, &msg);
+    LOG_INFO(msg);
   }
-  return false;
+  startTracingService_ = this->create_service<Trigger>(
+    "start_tracing", std::bind(
+                       &DriverROS2::enableTracing, this, true, std::placeholders::_1,
+                       std::placeholders::_2));
+  stopTracingService_ = this->create_service<Trigger>(
+    "stop_tracing", std::bind(
+                      &DriverROS2::enableTracing, this, false, std::placeholders::_1,
+                      std::placeholders::_2));
 }
 
-static MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(rclcpp::Node * node)
+bool DriverROS2::stop()
 {
-  MetavisionWrapper::HardwarePinConfig config;
-  // builds map, e.g:
-  // config["evc3a_plugin_gen31"]["external"] = 0
-  // config["evc3a_plugin_gen31"]["loopback"] = 6
-  const auto params = node->list_parameters({"prophesee_pin_config"}, 10 /* 10 deep */);
-  for (const auto & name : params.names) {
-    auto a = split_string(name);
-    if (a.size() != 3) {
-      RCLCPP_ERROR_STREAM(node->get_logger(), "invalid pin config found: " << name);
-    } else {
-      int64_t pin;
-      node->get_parameter(name, pin);
-      auto it_bool = config.insert({a[1], std::map<std::string, int>()});
-      it_bool.first->second.insert({a[2], static_cast<int>(pin)});
+  if (wrapper_) {
+    const bool status = wrapper_->stop();
+    if (decodedWorker_) {
+      decodedWorker_->stop();  // no more packets arriving now
+    }
+    if (compressionPool_) {
+      compressionPool_->stop();
     }
+    return (status);
   }
-  return (config);
+  return false;
 }
 
 void DriverROS2::configureWrapper(const std::string & name)
 {
   wrapper_ = std::make_shared<MetavisionWrapper>(name);
-  std::string sn;
-  this->get_parameter_or("serial", sn, std::string(""));
-  wrapper_->setSerialNumber(sn);
-  std::string fromFile;
-  this->get_parameter_or("from_file", fromFile, std::string(""));
-  wrapper_->setFromFile(fromFile);
-  std::string syncMode;
-  this->get_parameter_or("sync_mode", syncMode, std::string("standalone"));
-  wrapper_->setSyncMode(syncMode);
-  LOG_INFO("sync mode: " << syncMode);
-  bool trailFilter;
-  this->get_parameter_or("trail_filter", trailFilter, false);
-  std::string trailFilterType;
-  this->get_parameter_or("trail_filter_type", trailFilterType, std::string("trail"));
-  int trailFilterThreshold;
-  this->get_parameter_or("trail_filter_threshold", trailFilterThreshold, 0);
-  if (trailFilter) {
-    LOG_INFO(
-      "Using tail filter in " << trailFilterType << " mode with threshold "
-                              << trailFilterThreshold);
-    wrapper_->setTrailFilter(
-      trailFilterType, static_cast<uint32_t>(trailFilterThreshold), trailFilter);
-  }
-  std::vector<int64_t> roi_long;
-  this->get_parameter_or("roi", roi_long, std::vector<int64_t>());
-  std::vector<int> r(roi_long.begin(), roi_long.end());
-  if (!r.empty()) {
-    LOG_INFO("using ROI with " << (r.size() / 4) << " rectangle(s)");
-    for (size_t i = 0; i < r.size() / 4; i += 4) {
-      LOG_INFO(r[4 * i] << " " << r[4 * i + 1] << " " << r[4 * i + 2] << " " << r[4 * i + 3]);
-    }
-  }
-  wrapper_->setROI(r);
-  std::string tInMode;
-  this->get_parameter_or("trigger_in_mode", tInMode, std::string("disabled"));
-  if (tInMode != "disabled") {
-    LOG_INFO("trigger in mode:        " << tInMode);
-  }
-  // disabled, enabled, loopback
-  wrapper_->setExternalTriggerInMode(tInMode);
-  // disabled, enabled
-  std::string tOutMode;
-  this->get_parameter_or("trigger_out_mode", tOutMode, std::string("disabled"));
-  int64_t tOutPeriod;
-  this->get_parameter_or("trigger_out_period", tOutPeriod, 100000L);  // trigger out period in usec
-  double tOutCycle;
-  this->get_parameter_or("trigger_duty_cycle", tOutCycle, 0.5);  // fraction of cycle trigger HIGH
-  if (tOutMode != "disabled") {
-    LOG_INFO("trigger out mode:       " << tOutMode);
-    LOG_INFO("trigger out period:     " << tOutPeriod);
-    LOG_INFO("trigger out duty cycle: " << tOutCycle);
-  }
-  wrapper_->setExternalTriggerOutMode(tOutMode, tOutPeriod, tOutCycle);
-
-  // disabled, enabled, na
-  std::string ercMode;  // Event Rate Controller Mode
-  this->get_parameter_or("erc_mode", ercMode, std::string("na"));
-  int ercRate;  // Event Rate Controller Rate
-  this->get_parameter_or("erc_rate", ercRate, 100000000);
-  wrapper_->setEventRateController(ercMode, ercRate);
-
-  if (wrapper_->triggerActive()) {
-    wrapper_->setHardwarePinConfig(get_hardware_pin_config(this));
-  }
-  int mipiFramePeriod{-1};
-  this->get_parameter_or("mipi_frame_period", mipiFramePeriod, -1);
-  wrapper_->setMIPIFramePeriod(mipiFramePeriod);
+  configure_wrapper(this, std::string(), wrapper_.get());
 }
 
 void DriverROS2::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_t * end)
 {
-  if (eventPub_->get_subscription_count() > 0) {
-    if (!msg_) {
-      msg_.reset(new EventPacketMsg());
-      msg_->header.frame_id = frameId_;
-      msg_->time_base = 0;  // not used here
-      msg_->encoding = encoding_;
-      msg_->seq = seq_++;
-      msg_->width = width_;
-      msg_->height = height_;
-      msg_->header.stamp = rclcpp::Time(t, RCL_SYSTEM_TIME);
-      msg_->events.reserve(reserveSize_);
+  if (previewRenderer_ && previewPub_->get_subscription_count() > 0) {
+    previewRenderer_->addData(start, end);  // decoded later by timer
+  }
+  const bool sendTriggers = triggerPub_->get_subscription_count() > 0;
+  const bool sendRaw = eventPub_->get_subscription_count() > 0;
+  const bool sendCompressed = compressionPool_ && compressedPub_->get_subscription_count() > 0;
+  const bool sendDecoded = decodedWorker_ && decodedPub_->get_subscription_count() > 0;
+  const bool sendShm = shmWriter_ && shmPub_->get_subscription_count() > 0;
+  const bool assemble = sendRaw || sendCompressed || sendDecoded || sendShm;
+  if (assemble && !msg_) {
+    msg_.reset(new EventPacketMsg());
+    msg_->header.frame_id = frameId_;
+    msg_->encoding = encoding_;
+    msg_->seq = seq_++;
+    msg_->width = width_;
+    msg_->height = height_;
+    msg_->header.stamp = rclcpp::Time(t, RCL_SYSTEM_TIME);
+    msg_->events.reserve(reservePolicy_.getReserveSize());
+    packetInfo_ = PacketInfo();
+  }
+  const bool countEvents = biasController_.isEnabled();
+  if (sendTriggers || assemble || countEvents) {
+    if (scanPaused_) {
+      // the scanner has missed data, possibly TIME_HIGH roll-overs as well
+      scanner_ = std::make_shared<RawScanner>(encoding_);
+      timeKeeper_ = std::make_shared<ROSTimeKeeper>(get_name());
+      scanPaused_ = false;
+    }
+    // one pass over the raw data for triggers, packet metadata and event count
+    triggers_.clear();
+    PacketInfo countInfo;
+    PacketInfo * info = assemble ? &packetInfo_ : (countEvents ? &countInfo : nullptr);
+    const uint64_t numEventsBefore = info ? info->numEvents : 0;
+    scanner_->scan(start, end, sendTriggers ? &triggers_ : nullptr, info);
+    if (countEvents) {
+      biasController_.addEvents(info->numEvents - numEventsBefore);
+    }
+    if (sendTriggers) {
+      publishTriggers(t);
     }
+  } else {
+    scanPaused_ = true;
+  }
+  if (decodedWorker_ && !sendDecoded) {
+    decodePaused_ = true;
+  }
+  if (assemble) {
     const size_t n = end - start;
     auto & events = msg_->events;
-    const size_t oldSize = events.size();
-    resize_hack(events, oldSize + n);
-    memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
-
-    if (t - lastMessageTime_ > messageThresholdTime_ || events.size() > messageThresholdSize_) {
-      reserveSize_ = std::max(reserveSize_, events.size());
-      wrapper_->updateBytesSent(events.size());
-      eventPub_->publish(std::move(msg_));
-      lastMessageTime_ = t;
-      wrapper_->updateMsgsSent(1);
+    {
+      TRACE_SCOPE("append", t);
+      const size_t oldSize = events.size();
+      resize_hack(events, oldSize + n);
+      memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
+    }
+
+    if (packetSizer_.isComplete(t, events.size(), packetInfo_)) {
+      sendMessage(t, sendRaw, sendCompressed, sendDecoded, sendShm);
     }
   } else {
     if (msg_) {
@@ -410,6 +730,363 @@ void DriverROS2::rawDataCallback(uint64_t t, const uint8_t * start, const uint8_
   }
 }
 
+void DriverROS2::sendMessage(
+  uint64_t t, bool sendRaw, bool sendCompressed, bool sendDecoded, bool sendShm)
+{
+  auto & events = msg_->events;
+  reservePolicy_.update(events.size(), events.capacity());
+  if (reservePolicy_.takeTrimRequest()) {
+    wrapper_->requestHeapTrim();
+  }
+  msg_->time_base = packetInfo_.startTime * 1000;  // usec -> nsec
+  if (infoPub_->get_subscription_count() > 0) {
+    publishPacketInfo();
+  }
+  if (sendShm) {
+    writeSharedMemory();
+  }
+  if (sendDecoded && decodePaused_) {
+    decodedWorker_->resetTime();  // the decoder has missed data
+    decodePaused_ = false;
+  }
+  if (sendCompressed || sendDecoded) {
+    // only copy the events if the raw message is sent as well
+    submitPacket(sendRaw, sendCompressed, sendDecoded);
+  }
+  if (sendRaw) {
+    wrapper_->updateBytesSent(events.size());
+    TRACE_SCOPE("publish", msg_->seq);
+    eventPub_->publish(std::move(msg_));
+    wrapper_->updateMsgsSent(1);
+  } else {
+    msg_.reset();
+  }
+  packetSizer_.messageSent(t, packetInfo_.numEvents);
+  lostTime_ = 0;
+  timeReset_ = false;
+}
+
+void DriverROS2::flushMessage()
+{
+  if (!msg_) {
+    return;
+  }
+  const bool sendRaw = eventPub_->get_subscription_count() > 0;
+  const bool sendCompressed = compressionPool_ && compressedPub_->get_subscription_count() > 0;
+  const bool sendDecoded = decodedWorker_ && decodedPub_->get_subscription_count() > 0;
+  const bool sendShm = shmWriter_ && shmPub_->get_subscription_count() > 0;
+  if (!(sendRaw || sendCompressed || sendDecoded || sendShm)) {
+    msg_.reset();
+    return;
+  }
+  const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  sendMessage(t, sendRaw, sendCompressed, sendDecoded, sendShm);
+}
+
+void DriverROS2::publishPacketInfo()
+{
+  EventPacketInfoMsg::UniquePtr msg(new EventPacketInfoMsg());
+  msg->header = msg_->header;
+  msg->seq = msg_->seq;
+  msg->time_base = msg_->time_base;
+  msg->first_event_time = packetInfo_.firstTime * 1000;
+  msg->last_event_time = packetInfo_.lastTime * 1000;
+  msg->num_events = packetInfo_.numEvents;
+  msg->num_bytes = msg_->events.size();
+  msg->lost_time = lostTime_ * 1000;
+  msg->time_reset = timeReset_;
+  infoPub_->publish(std::move(msg));
+}
+
+void DriverROS2::publishTriggers(uint64_t t)
+{
+  // publish right away rather than waiting for the event message to fill up
+  if (!scanner_->hasValidTime()) {
+    return;
+  }
+  // scanner time is in usec, time keeper works in nanoseconds
+  const uint64_t rosTimeOffset = timeKeeper_->updateROSTimeOffset(scanner_->getTime() * 1e3, t);
+  for (const auto & trig : triggers_) {
+    ExtTriggerMsg::UniquePtr msg(new ExtTriggerMsg());
+    msg->sensor_time = trig.time * 1000;
+    const uint64_t stamp = rosTimeOffset + msg->sensor_time;
+    msg->header.frame_id = frameId_;
+    msg->header.stamp = rclcpp::Time(stamp, RCL_SYSTEM_TIME);
+    msg->id = trig.id;
+    msg->polarity = trig.polarity;
+    timeKeeper_->setLastROSTime(stamp);
+    triggerPub_->publish(std::move(msg));
+  }
+}
+
+void DriverROS2::initializePreview()
+{
+  double rate;
+  this->get_parameter_or("preview_rate", rate, 0.0);
+  if (rate <= 0) {
+    return;
+  }
+  std::string mode;
+  this->get_parameter_or("preview_mode", mode, std::string("count"));
+  if (mode != "count" && mode != "time_surface") {
+    LOG_WARN("invalid preview mode: " << mode << ", using count");
+    mode = "count";
+  }
+  double decay;
+  this->get_parameter_or("preview_decay", decay, 0.03);
+  LOG_INFO("preview image with rate " << rate << "Hz, mode: " << mode);
+  previewPub_ = this->create_publisher<ImageMsg>("~/preview", rclcpp::QoS(1));
+  previewRenderer_ = std::make_shared<PreviewRenderer>(encoding_, width_, height_, mode, decay);
+  previewTimer_ = this->create_wall_timer(
+    std::chrono::duration<double>(1.0 / rate), std::bind(&DriverROS2::publishPreview, this));
+}
+
+void DriverROS2::initializeBiasController()
+{
+  std::map<std::string, int> biases;
+  for (const auto & bp : biasParameters_) {
+    biases[bp.first] = wrapper_->getBias(bp.first);
+  }
+  biasController_.initialize(wrapper_->getSensorVersion(), biases);
+  if (!biasController_.isEnabled()) {
+    LOG_WARN("automatic bias control not supported for sensor " << wrapper_->getSensorVersion());
+    return;
+  }
+  const auto & config = biasController_.getConfig();
+  LOG_INFO(
+    "bias control target: " << config.targetRate << " ev/s +- " << config.hysteresis * 100 << "%");
+  biasControlTimer_ = this->create_wall_timer(
+    std::chrono::duration<double>(config.interval),
+    std::bind(&DriverROS2::updateBiasController, this));
+}
+
+void DriverROS2::updateBiasController()
+{
+  std::map<std::string, int> current;
+  for (const auto & name : biasController_.getControlledBiases()) {
+    current[name] = wrapper_->getBias(name);
+  }
+  const auto changes = biasController_.update(current);
+  if (!changes.empty()) {
+    std::map<std::string, int> result;
+    std::string msg;
+    if (wrapper_->setBiases(changes, &result, &msg)) {
+      updateBiasParameters(result);  // so the ROS parameters show the new values
+      for (const auto & c : changes) {
+        current[c.first] = result[c.first];
+      }
+    }
+  }
+  DiagnosticArrayMsg::UniquePtr msg(new DiagnosticArrayMsg());
+  msg->header.stamp = this->now();
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.name = std::string(this->get_name()) + ": bias controller";
+  status.hardware_id = wrapper_->getSerialNumber();
+  status.level = biasController_.getState() == BiasController::SATURATED
+                   ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                   : diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.message = biasController_.getStateName();
+  const auto & config = biasController_.getConfig();
+  status.values.push_back(make_key_value("target_rate", std::to_string(config.targetRate)));
+  status.values.push_back(
+    make_key_value("measured_rate", std::to_string(biasController_.getRate())));
+  for (const auto & b : current) {
+    status.values.push_back(make_key_value(b.first, std::to_string(b.second)));
+    status.values.push_back(make_key_value(
+      b.first + "_baseline", std::to_string(biasController_.getBaseline().at(b.first))));
+  }
+  msg->status.push_back(status);
+  diagnosticsPub_->publish(std::move(msg));
+}
+
+void DriverROS2::publishPreview()
+{
+  if (previewPub_->get_subscription_count() == 0) {
+    return;
+  }
+  ImageMsg::UniquePtr img(new ImageMsg());
+  if (!previewRenderer_->render(&img->data)) {
+    return;  // no new data
+  }
+  img->header.frame_id = frameId_;
+  img->header.stamp = this->get_clock()->now();
+  img->width = width_;
+  img->height = height_;
+  img->encoding = "mono8";
+  img->is_bigendian = isBigEndian_;
+  img->step = width_;
+  previewPub_->publish(std::move(img));
+}
+
+void DriverROS2::initializeDecodedEvents()
+{
+  bool publishDecoded;
+  this->get_parameter_or("publish_decoded_events", publishDecoded, false);
+  if (!publishDecoded) {
+    return;
+  }
+  LOG_INFO("publishing decoded events");
+  decodedPub_ = this->create_publisher<DecodedEventsMsg>(
+    "~/decoded_events", rclcpp::QoS(rclcpp::KeepLast(100)).best_effort().durability_volatile());
+  int maxInFlight;
+  this->get_parameter_or("decoder_max_in_flight", maxInFlight, 16);
+  decodedWorker_ = std::make_shared<DecodedEventsWorker>(
+    get_name(), encoding_, static_cast<size_t>(std::max(maxInFlight, 1)));
+  decodedWorker_->start(
+    std::bind(&DriverROS2::publishDecodedEvents, this, std::placeholders::_1),
+    get_thread_config(this, "decoder_thread"));
+  auto worker = decodedWorker_;
+  wrapper_->addStatsReporter([worker]() { return (worker->getStatsReport()); });
+}
+
+void DriverROS2::publishDecodedEvents(DecodedEventsWorker::Job * job)
+{
+  // runs on the decoder thread, called in message order
+  DecodedEventsMsg::UniquePtr msg(new DecodedEventsMsg());
+  msg->header.frame_id = frameId_;
+  msg->header.stamp = rclcpp::Time(job->packet.stamp, RCL_SYSTEM_TIME);
+  msg->width = width_;
+  msg->height = height_;
+  msg->seq = job->packet.seq;
+  msg->time_base = job->events.timeBase;
+  msg->x.swap(job->events.x);
+  msg->y.swap(job->events.y);
+  msg->polarity.swap(job->events.polarity);
+  msg->t.swap(job->events.t);
+  decodedPub_->publish(std::move(msg));
+}
+
+void DriverROS2::initializeCompression()
+{
+  std::string method;
+  this->get_parameter_or("compression", method, std::string("none"));
+  if (method == "none") {
+    return;
+  }
+  if (!Compressor::isSupported(method)) {
+    LOG_WARN("compression method " << method << " not available, not compressing!");
+    return;
+  }
+  int level, numThreads, maxInFlight;
+  this->get_parameter_or("compression_level", level, 1);
+  this->get_parameter_or("compression_threads", numThreads, 2);
+  this->get_parameter_or("compression_max_in_flight", maxInFlight, 16);
+  LOG_INFO(
+    "compressing with " << method << " level " << level << " on " << numThreads << " threads");
+  int qs;
+  this->get_parameter_or("send_queue_size", qs, 1000);
+  compressedPub_ = this->create_publisher<EventPacketMsg>(
+    "~/events_compressed", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  compressionPool_ = std::make_shared<CompressionPool>(
+    get_name(), method, level, numThreads, static_cast<size_t>(std::max(maxInFlight, 1)));
+  compressionPool_->start(
+    std::bind(&DriverROS2::publishCompressed, this, std::placeholders::_1),
+    get_thread_config(this, "compression_thread"));
+  auto pool = compressionPool_;
+  wrapper_->addStatsReporter([pool]() { return (pool->getStatsReport()); });
+}
+
+void DriverROS2::submitPacket(bool copyEvents, bool compress, bool decode)
+{
+  // hands the current message to the post-processing stages
+  auto events = std::make_shared<std::vector<uint8_t>>();
+  if (copyEvents) {
+    events->assign(msg_->events.begin(), msg_->events.end());
+  } else {
+    events->swap(msg_->events);
+  }
+  EventPacketData packet;
+  packet.seq = msg_->seq;
+  packet.stamp = rclcpp::Time(msg_->header.stamp).nanoseconds();
+  packet.timeBase = msg_->time_base;
+  packet.events = events;
+  if (compress && !compressionPool_->submit(packet)) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "compression falling behind, dropping message!");
+    wrapper_->updateMsgsDropped(1);
+  }
+  if (decode && !decodedWorker_->submit(packet)) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "decoder falling behind, dropping message!");
+    wrapper_->updateMsgsDropped(1);
+  }
+}
+
+void DriverROS2::publishCompressed(CompressionPool::Job * job)
+{
+  // runs on a compression thread, called in message order
+  wrapper_->updateCompressionStats(job->packet.events->size(), job->compressed.size());
+  EventPacketMsg::UniquePtr msg(new EventPacketMsg());
+  msg->header.frame_id = frameId_;
+  msg->header.stamp = rclcpp::Time(job->packet.stamp, RCL_SYSTEM_TIME);
+  msg->time_base = job->packet.timeBase;
+  msg->encoding = encoding_ + "-" + compressionPool_->getMethod();
+  msg->seq = job->packet.seq;
+  msg->width = width_;
+  msg->height = height_;
+  msg->is_bigendian = isBigEndian_;
+  msg->events.swap(job->compressed);
+  compressedPub_->publish(std::move(msg));
+}
+
+void DriverROS2::initializeSharedMemory()
+{
+  std::string name;
+  this->get_parameter_or("shm_ring_name", name, std::string(""));
+  if (name.empty()) {
+    return;
+  }
+  int64_t size;
+  int numSlots;
+  this->get_parameter_or("shm_ring_size", size, int64_t(256) << 20);
+  this->get_parameter_or("shm_ring_slots", numSlots, 1024);
+  shmWriter_ = std::make_shared<ShmRingWriter>();
+  std::string error;
+  if (!shmWriter_->create(
+        name, static_cast<size_t>(std::max(size, int64_t(0))),
+        static_cast<uint32_t>(std::max(numSlots, 0)), encoding_, width_, height_, isBigEndian_,
+        &error)) {
+    LOG_ERROR("cannot create shared memory ring: " << error);
+    shmWriter_.reset();
+    return;
+  }
+  LOG_INFO("writing events to shared memory ring " << name << " of size " << size);
+  int qs;
+  this->get_parameter_or("send_queue_size", qs, 1000);
+  shmPub_ = this->create_publisher<EventPacketMsg>(
+    "~/events_shm", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+}
+
+void DriverROS2::writeSharedMemory()
+{
+  // the payload goes into the ring, the notification has no events
+  shm_ring::Record rec;
+  rec.seq = msg_->seq;
+  rec.size = msg_->events.size();
+  rec.stamp = rclcpp::Time(msg_->header.stamp).nanoseconds();
+  rec.timeBase = msg_->time_base;
+  rec.firstEventTime = packetInfo_.firstTime * 1000;
+  rec.lastEventTime = packetInfo_.lastTime * 1000;
+  rec.numEvents = packetInfo_.numEvents;
+  if (!shmWriter_->write(rec, msg_->events.data())) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "message too large for shared memory ring, dropped!");
+    wrapper_->updateMsgsDropped(1);
+    return;
+  }
+  EventPacketMsg::UniquePtr msg(new EventPacketMsg());
+  msg->header = msg_->header;
+  msg->time_base = msg_->time_base;
+  msg->encoding = msg_->encoding;
+  msg->seq = msg_->seq;
+  msg->width = width_;
+  msg->height = height_;
+  msg->is_bigendian = isBigEndian_;
+  shmPub_->publish(std::move(msg));
+}
+
 void DriverROS2::eventCDCallback(
   uint64_t, const Metavision::EventCD * start, const Metavision::EventCD * end)
 {
@@ -430,6 +1107,41 @@ void DriverROS2::eventCDCallback(
   }
 }
 
+void DriverROS2::sourceRestarted()
+{
+  // the camera was reopened or playback jumped, the sensor time starts over
+  resetSensorTime();
+  LOG_INFO("source restarted, continuing with sequence number " << seq_);
+}
+
+void DriverROS2::sensorTimeGap(uint64_t lostTime, bool isReset)
+{
+  if (isReset) {
+    // the message being assembled has the data from before the reset,
+    // so the reset is reported with the next one
+    resetSensorTime();
+    timeReset_ = true;
+  }
+  // reported in the packet info of the next message sent
+  lostTime_ += lostTime;
+}
+
+void DriverROS2::resetSensorTime()
+{
+  // the scanner and time keeper must not mix times from before and
+  // after, so send whatever was assembled with the old sensor time
+  flushMessage();
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(get_name());
+  // the decoders downstream would take the step back for a roll-over
+  if (decodedWorker_) {
+    decodedWorker_->resetTime();
+  }
+  if (previewRenderer_) {
+    previewRenderer_->resetTime();
+  }
+}
+
 }  // namespace metavision_driver
 
 RCLCPP_COMPONENTS_REGISTER_NODE(metavision_driver::DriverROS2)
@@ -15,7 +15,11 @@
 
 #include "metavision_driver/metavision_wrapper.h"
 
+#include "metavision_driver/bias_parameter.h"
 #include "metavision_driver/logging.h"
+#include "metavision_driver/raw_file_reader.h"
+#include "metavision_driver/sdk_camera_source.h"
+#include "metavision_driver/tracing.h"
 
 #if METAVISION_VERSION < 4
 #include <metavision/hal/facilities/i_device_control.h>
@@ -26,7 +30,6 @@
 #endif
 
 #include <metavision/hal/facilities/i_event_trail_filter_module.h>
-#include <metavision/hal/facilities/i_hw_identification.h>
 #include <metavision/hal/facilities/i_hw_register.h>
 #include <metavision/hal/facilities/i_ll_biases.h>
 #include <metavision/hal/facilities/i_plugin_software_info.h>
@@ -34,9 +37,15 @@
 #include <metavision/hal/facilities/i_trigger_in.h>
 #include <metavision/hal/facilities/i_trigger_out.h>
 
+#include <malloc.h>
+#include <sys/resource.h>
+
 #include <chrono>
+#include <cstring>
+#include <iomanip>
 #include <map>
 #include <set>
+#include <sstream>
 #include <thread>
 
 #ifdef USING_ROS_1
@@ -69,32 +78,30 @@ static const std::map<std::string, Metavision::I_TriggerIn::Channel> channelMap
 static const std::map<std::string, uint32_t> sensorToMIPIAddress = {
   {"IMX636", 0xB028}, {"Gen3.1", 0x1508}};
 
+// biases that are never written by the driver
+static const std::set<std::string> readOnlyBiases = {"bias_diff"};
+
 static const std::map<std::string, Metavision::I_EventTrailFilterModule::Type> trailFilterMap = {
   {"trail", Metavision::I_EventTrailFilterModule::Type::TRAIL},
   {"stc_cut_trail", Metavision::I_EventTrailFilterModule::Type::STC_CUT_TRAIL},
   {"stc_keep_trail", Metavision::I_EventTrailFilterModule::Type::STC_KEEP_TRAIL}};
 
-static std::string to_lower(const std::string upper)
-{
-  std::string lower(upper);
-  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-  return (lower);
-}
-
 MetavisionWrapper::MetavisionWrapper(const std::string & loggerName)
 {
   setLoggerName(loggerName);
   lastPrintTime_ = std::chrono::system_clock::now();
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  lastPageFaults_ = usage.ru_minflt + usage.ru_majflt;
 }
 
 MetavisionWrapper::~MetavisionWrapper() { stop(); }
 
 int MetavisionWrapper::getBias(const std::string & name)
 {
-  const auto biases = cam_.get_device().get_facility<Metavision::I_LL_Biases>();
-  const auto pmap = biases->get_all_biases();
-  auto it = pmap.find(name);
-  if (it == pmap.end()) {
+  std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+  const auto it = biasCache_.find(name);
+  if (it == biasCache_.end()) {
     LOG_ERROR_NAMED("unknown bias parameter: " << name);
     throw(std::runtime_error("bias parameter not found!"));
   }
@@ -103,31 +110,174 @@ int MetavisionWrapper::getBias(const std::string & name)
 
 bool MetavisionWrapper::hasBias(const std::string & name)
 {
-  const auto biases = cam_.get_device().get_facility<Metavision::I_LL_Biases>();
-  const auto pmap = biases->get_all_biases();
-  auto it = pmap.find(name);
-  return (it != pmap.end());
+  std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+  return (biasCache_.count(name) != 0);
 }
 
 int MetavisionWrapper::setBias(const std::string & name, int val)
 {
-  std::set<std::string> dont_touch_set = {{"bias_diff"}};
-  if (dont_touch_set.count(name) != 0) {
+  if (readOnlyBiases.count(name) != 0) {
     LOG_WARN_NAMED("ignoring change to parameter: " << name);
     return (val);
   }
-  const auto biases = cam_.get_device().get_facility<Metavision::I_LL_Biases>();
-  const int prev = biases->get(name);
-  if (val != prev) {
-    if (!biases->set(name, val)) {
-      LOG_WARN_NAMED("cannot set parameter " << name << " to " << val);
+  int prev;
+  {
+    std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+    const auto it = biasCache_.find(name);
+    if (it == biasCache_.end()) {
+      LOG_WARN_NAMED("ignoring change to unknown bias: " << name);
+      return (val);
+    }
+    if (it->second == val) {
+      return (val);  // already set, avoid the register access
     }
+    prev = it->second;
+  }
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    // reconnect() writes the cache to the new device, unless it is
+    // already past that point
+    std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+    if (reconnecting_) {
+      LOG_WARN_NAMED("camera is reconnecting, will set " << name << " to " << val << " then");
+      biasCache_[name] = val;
+      return (val);
+    }
+    cacheLock.unlock();
+    lock.lock();
+  }
+  const auto biases = getFacility<Metavision::I_LL_Biases>();
+  if (!biases) {
+    LOG_WARN_NAMED("source has no biases, ignoring change to: " << name);
+    return (val);
+  }
+  if (!biases->set(name, val)) {
+    LOG_WARN_NAMED("cannot set parameter " << name << " to " << val);
   }
   const int now = biases->get(name);  // read back what actually took hold
   LOG_INFO_NAMED("changed  " << name << " from " << prev << " to " << val << " adj to: " << now);
+  std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+  biasCache_[name] = now;
   return (now);
 }
 
+std::unique_lock<std::mutex> MetavisionWrapper::lockCamera()
+{
+  // Blocks while another caller uses the camera, but returns without
+  // the lock while the camera is being reconnected.
+  std::unique_lock<std::mutex> lock(cameraMutex_, std::defer_lock);
+  if (!reconnecting_) {
+    lock.lock();
+    if (reconnecting_) {
+      lock.unlock();  // reconnect started while waiting for the lock
+    }
+  }
+  return (lock);
+}
+
+bool MetavisionWrapper::checkBias(const std::string & name, int val, std::string * msg) const
+{
+  if (readOnlyBiases.count(name) != 0) {
+    *msg = "cannot change bias: " + name;
+    return (false);
+  }
+  const auto & limits = BiasParameter::getAll(sensorVersion_);
+  const auto it = limits.find(name);
+  if (it != limits.end() && (val < it->second.minVal || val > it->second.maxVal)) {
+    *msg = name + " must be in [" + std::to_string(it->second.minVal) + ", " +
+           std::to_string(it->second.maxVal) + "]";
+    return (false);
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::setBiases(
+  const std::map<std::string, int> & request, std::map<std::string, int> * result,
+  std::string * msg)
+{
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    *msg = "camera is reconnecting, try again later";
+    return (false);
+  }
+  const auto biases = getFacility<Metavision::I_LL_Biases>();
+  if (!biases) {
+    *msg = "source has no biases";
+    return (false);
+  }
+  // validate everything up front so nothing is written for a bad request
+  std::map<std::string, int> prev;
+  {
+    std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+    for (const auto & b : request) {
+      const auto it = biasCache_.find(b.first);
+      if (it == biasCache_.end()) {
+        *msg = "cannot change bias: " + b.first;
+        return (false);
+      }
+      if (!checkBias(b.first, b.second, msg)) {
+        return (false);
+      }
+      prev[b.first] = it->second;
+    }
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::string> written;  // possibly changed on the sensor
+  bool success = false;
+  try {
+    for (const auto & b : request) {
+      if (b.second != prev[b.first]) {
+        written.push_back(b.first);  // before set(), which may throw half way
+        if (!biases->set(b.first, b.second)) {
+          throw std::runtime_error("cannot set " + b.first + " to " + std::to_string(b.second));
+        }
+      }
+    }
+    success = true;
+  } catch (const std::exception & e) {
+    *msg = std::string("error setting biases: ") + e.what();
+  }
+  {
+    // on failure roll back, then read back what took hold such that the
+    // cache matches the sensor no matter where the update failed
+    std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+    for (const auto & name : written) {
+      try {
+        if (!success) {
+          biases->set(name, prev[name]);
+        }
+        biasCache_[name] = biases->get(name);  // the sensor may adjust the value
+      } catch (const std::exception & e) {
+        LOG_WARN_NAMED("cannot restore or read back bias " << name << ": " << e.what());
+      }
+    }
+    *result = biasCache_;
+  }
+  if (success) {
+    const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - t0)
+                        .count();
+    *msg = "changed " + std::to_string(written.size()) + " biases in " + std::to_string(usec) +
+           "us";
+    LOG_INFO_NAMED(*msg);
+  } else {
+    LOG_WARN_NAMED("bias update rejected: " << *msg);
+  }
+  return (success);
+}
+
+void MetavisionWrapper::refreshBiasCache()
+{
+  const auto biases = getFacility<Metavision::I_LL_Biases>();
+  std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+  biasCache_.clear();
+  if (biases) {
+    for (const auto & b : biases->get_all_biases()) {
+      biasCache_.insert(b);
+    }
+  }
+}
+
 void MetavisionWrapper::setTrailFilter(
   const std::string & type, const uint32_t threshold, const bool state)
 {
@@ -136,37 +286,61 @@ void MetavisionWrapper::setTrailFilter(
   trailFilter_.threshold = threshold;
 }
 
+void MetavisionWrapper::removeCameraCallbacks()
+{
+  if (!cam_) {
+    return;
+  }
+  if (statusChangeCallbackActive_) {
+    cam_->remove_status_change_callback(statusChangeCallbackId_);
+    statusChangeCallbackActive_ = false;
+  }
+  if (runtimeErrorCallbackActive_) {
+    cam_->remove_runtime_error_callback(runtimeErrorCallbackId_);
+    runtimeErrorCallbackActive_ = false;
+  }
+  if (contrastCallbackActive_) {
+    cam_->cd().remove_callback(contrastCallbackId_);
+    contrastCallbackActive_ = false;
+  }
+  if (extTriggerCallbackActive_) {
+    cam_->ext_trigger().remove_callback(extTriggerCallbackId_);
+    extTriggerCallbackActive_ = false;
+  }
+}
+
 bool MetavisionWrapper::initialize(bool useMultithreading, const std::string & biasFile)
 {
+  initStartTime_ = std::chrono::steady_clock::now();
   biasFile_ = biasFile;
   useMultithreading_ = useMultithreading;
+  configureMemory();
 
   if (!initializeCamera()) {
     LOG_ERROR_NAMED("could not initialize camera!");
     return (false);
   }
+  refreshBiasCache();  // from here on biases are read from the cache
+  LOG_INFO_NAMED("camera initialized in " << millisecondsSince(initStartTime_) << "ms");
   return (true);
 }
 
 bool MetavisionWrapper::stop()
 {
-  bool status = false;
-  if (cam_.is_running()) {
-    cam_.stop();
-    status = true;
-  }
-  if (rawDataCallbackActive_) {
-    cam_.raw_data().remove_callback(rawDataCallbackId_);
-  }
-  if (statusChangeCallbackActive_) {
-    cam_.remove_status_change_callback(statusChangeCallbackId_);
-  }
-  if (contrastCallbackActive_) {
-    cam_.cd().remove_callback(contrastCallbackId_);
+  if (reconnectThread_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepReconnecting_ = false;
+      reconnectCv_.notify_all();
+    }
+    reconnectThread_->join();
+    reconnectThread_.reset();
   }
-  if (extTriggerCallbackActive_) {
-    cam_.ext_trigger().remove_callback(extTriggerCallbackId_);
+  bool status = false;
+  if (source_) {
+    status = source_->stop();
   }
+  removeCameraCallbacks();
 
   keepRunning_ = false;
   if (processingThread_) {
@@ -188,11 +362,12 @@ bool MetavisionWrapper::stop()
   return (status);
 }
 
-void MetavisionWrapper::applyROI(const std::vector<int> & roi)
+bool MetavisionWrapper::applyROI(const std::vector<int> & roi)
 {
   if (!roi.empty()) {
     if (roi.size() % 4 != 0) {
       LOG_ERROR_NAMED("ROI vec must be multiple of 4, but is: " << roi.size());
+      return (false);
     } else {
 #ifdef CHECK_IF_OUTSIDE_ROI
       x_min_ = std::numeric_limits<uint16_t>::max();
@@ -215,7 +390,13 @@ void MetavisionWrapper::applyROI(const std::vector<int> & roi)
         y_max_ = std::max(static_cast<uint16_t>(rect.y + rect.height), y_max_);
 #endif
       }
-      cam_.get_device().get_facility<Metavision::I_ROI>()->set_windows(rects);
+      auto * i_roi = getFacility<Metavision::I_ROI>();
+      if (i_roi) {
+        return (i_roi->set_windows(rects));
+      } else {
+        LOG_WARN_NAMED("cannot set ROI for this source!");
+        return (false);
+      }
     }
   } else {
 #ifdef CHECK_IF_OUTSIDE_ROI
@@ -225,12 +406,59 @@ void MetavisionWrapper::applyROI(const std::vector<int> & roi)
     y_max_ = std::numeric_limits<uint16_t>::max();
 #endif
   }
+  return (true);
+}
+
+bool MetavisionWrapper::checkROI(const std::vector<int> & roi, std::string * msg) const
+{
+  if (roi.size() % 4 != 0) {
+    *msg = "roi length must be a multiple of 4";
+    return (false);
+  }
+  for (size_t i = 0; i < roi.size(); i += 4) {
+    const int x = roi[i], y = roi[i + 1], w = roi[i + 2], h = roi[i + 3];
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > width_ || y + h > height_) {
+      *msg = "roi rectangle " + std::to_string(i / 4) + " is outside of the sensor area " +
+             std::to_string(width_) + "x" + std::to_string(height_);
+      return (false);
+    }
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::updateROI(const std::vector<int> & roi, std::string * msg)
+{
+  if (!checkROI(roi, msg)) {
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    *msg = "camera is reconnecting, try again later";
+    return (false);
+  }
+  auto * i_roi = getFacility<Metavision::I_ROI>();
+  if (!i_roi) {
+    *msg = "this source does not support ROI";
+    return (false);
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  bool success = false;
+  try {
+    // an empty ROI switches the windows off, the sensor streams full frame again
+    success = applyROI(roi) && i_roi->enable(!roi.empty());
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("setting ROI failed: " << e.what());
+  }
+  if (success) {
+    roi_ = roi;  // also applied after reconnect
+  }
+  return (reportUpdate("ROI", success, t0, msg));
 }
 
 void MetavisionWrapper::applySyncMode(const std::string & mode)
 {
-  auto * sync = cam_.get_device().get_facility<CameraSynchronization>();
-  if (!sync) {  // happens when playing from file
+  auto * sync = getFacility<CameraSynchronization>();
+  if (!sync) {  // happens when playing from file or synthetic source
     if (mode != "standalone") {
       LOG_WARN_NAMED("cannot set sync mode to: " << mode);
     }
@@ -256,8 +484,7 @@ void MetavisionWrapper::configureExternalTriggers(
   const double duty_cycle)
 {
   if (mode_out == "enabled") {
-    Metavision::I_TriggerOut * i_trigger_out =
-      cam_.get_device().get_facility<Metavision::I_TriggerOut>();
+    Metavision::I_TriggerOut * i_trigger_out = getFacility<Metavision::I_TriggerOut>();
     if (i_trigger_out) {
       i_trigger_out->set_period(period);  // in usec
       i_trigger_out->set_duty_cycle(duty_cycle);
@@ -269,8 +496,7 @@ void MetavisionWrapper::configureExternalTriggers(
   }
 
   if (mode_in != "disabled") {
-    Metavision::I_TriggerIn * i_trigger_in =
-      cam_.get_device().get_facility<Metavision::I_TriggerIn>();
+    Metavision::I_TriggerIn * i_trigger_in = getFacility<Metavision::I_TriggerIn>();
     if (i_trigger_in) {
 #ifdef USING_METAVISION_3
       auto it = hardwarePinConfig_[softwareInfo_].find(mode_in);
@@ -299,7 +525,7 @@ void MetavisionWrapper::configureEventRateController(
   const std::string & mode, const int events_per_sec)
 {
   if (mode == "enabled" || mode == "disabled") {
-    auto * i_erc = cam_.get_device().get_facility<ErcModule>();
+    auto * i_erc = getFacility<ErcModule>();
     if (i_erc) {
       i_erc->enable(mode == "enabled");
       i_erc->set_cd_event_rate(events_per_sec);
@@ -309,58 +535,139 @@ void MetavisionWrapper::configureEventRateController(
   }
 }
 
-bool MetavisionWrapper::initializeCamera()
+bool MetavisionWrapper::checkEventRateController(
+  const std::string & mode, const int rate, std::string * msg) const
 {
-  const int num_tries = 5;
-  for (int i = 0; i < num_tries; i++) {
-    try {
-      if (!fromFile_.empty()) {
-        LOG_INFO_NAMED("reading events from file: " << fromFile_);
-        const auto cfg = Metavision::FileConfigHints().real_time_playback(true);
-        cam_ = Metavision::Camera::from_file(fromFile_, cfg);
-      } else {
-        if (!serialNumber_.empty()) {
-          cam_ = Metavision::Camera::from_serial(serialNumber_);
-        } else {
-          cam_ = Metavision::Camera::from_first_available();
-        }
-      }
-      break;  // were able to open the camera, exit the for loop
-    } catch (const Metavision::CameraException & e) {
-      const std::string src =
-        fromFile_.empty() ? (serialNumber_.empty() ? "default" : serialNumber_) : fromFile_;
-      if (i < num_tries - 1) {
-        LOG_WARN_NAMED(
-          "cannot open " << src << " on attempt " << i + 1 << ", retrying " << num_tries - i - 1
-                         << " more times");
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+  if (mode != "enabled" && mode != "disabled" && mode != "na") {
+    *msg = "erc_mode must be one of enabled, disabled, na";
+    return (false);
+  }
+  if (rate <= 0) {
+    *msg = "erc_rate must be positive";
+    return (false);
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::updateEventRateController(
+  const std::string & mode, const int rate, std::string * msg)
+{
+  if (!checkEventRateController(mode, rate, msg)) {
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    *msg = "camera is reconnecting, try again later";
+    return (false);
+  }
+  if (mode != "na" && !getFacility<ErcModule>()) {
+    *msg = "this camera has no event rate controller";
+    return (false);
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  bool success = true;
+  try {
+    configureEventRateController(mode, rate);
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("setting event rate controller failed: " << e.what());
+    success = false;
+  }
+  if (success) {
+    ercMode_ = mode;
+    ercRate_ = rate;
+  }
+  return (reportUpdate("event rate controller", success, t0, msg));
+}
+
+void MetavisionWrapper::setFileTimeRange(double startTime, double endTime)
+{
+  fileStartTime_ = startTime < 0 ? -1 : static_cast<int64_t>(startTime * 1e6);
+  fileEndTime_ = endTime < 0 ? -1 : static_cast<int64_t>(endTime * 1e6);
+}
+
+bool MetavisionWrapper::seek(double sensorTime)
+{
+  if (!source_ || !source_->seek(static_cast<uint64_t>(std::max(sensorTime, 0.0) * 1e6))) {
+    LOG_WARN_NAMED("seek is only supported when playing from file with native reader!");
+    return (false);
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::initializeSource()
+{
+  bool isOpen = false;
+  if (source_) {
+    LOG_INFO_NAMED("using externally provided event source");
+  } else if (sourceType_ == "synthetic") {
+    source_ = std::make_shared<SyntheticSource>(loggerName_, syntheticConfig_);
+    if (!fromFile_.empty()) {
+      LOG_WARN_NAMED("using synthetic source, ignoring file " << fromFile_);
+      fromFile_.clear();
+    }
+  } else if (sourceType_ != "camera") {
+    LOG_ERROR_NAMED("invalid source type: " << sourceType_);
+    return (false);
+  } else {
+    if (!fromFile_.empty() && useNativeFileReader_) {
+      auto reader = std::make_shared<RawFileReader>(loggerName_, fromFile_);
+      if (reader->open()) {
+        LOG_INFO_NAMED("reading events from file with native reader: " << fromFile_);
+        reader->setTimeRange(fileStartTime_, fileEndTime_);
+        source_ = reader;
+        isOpen = true;
       } else {
-        LOG_ERROR_NAMED("cannot open " << src << ", giving up!");
+        LOG_WARN_NAMED("native reader cannot play " << fromFile_ << ", falling back to SDK!");
       }
     }
+    if (!source_) {
+      auto sdkSource = std::make_shared<SDKCameraSource>(
+        loggerName_, serialNumber_, fromFile_, requestedEncoding_);
+      sdkSource->setOpenTimeout(openTimeout_);
+      source_ = sdkSource;
+    }
   }
+  if (!isOpen && !source_->open()) {
+    return (false);
+  }
+  cam_ = source_->getCamera();
+  encodingFormat_ = source_->getEncodingFormat();
+  LOG_INFO_NAMED("encoding format: " << encodingFormat_);
+  sensorVersion_ = source_->getSensorVersion();
+  LOG_INFO_NAMED("sensor version: " << sensorVersion_);
+  sensorName_ = source_->getSensorName();
+  LOG_INFO_NAMED("sensor name: " << sensorName_);
+  if (!source_->getSerialNumber().empty()) {
+    // overwrite serial in case it was not set
+    serialNumber_ = source_->getSerialNumber();
+  }
+  LOG_INFO_NAMED("camera serial number: " << serialNumber_);
+  width_ = source_->getWidth();
+  height_ = source_->getHeight();
+  LOG_INFO_NAMED("sensor geometry: " << width_ << " x " << height_);
+  return (true);
+}
 
+bool MetavisionWrapper::initializeCamera()
+{
+  if (!initializeSource()) {
+    return (false);
+  }
+  if (!cam_) {
+    return (true);  // no hardware to configure
+  }
   try {
     // Record the plugin software information about the camera.
     using PSI = Metavision::I_PluginSoftwareInfo;
-    const PSI * psi = cam_.get_device().get_facility<PSI>();
+    const PSI * psi = getFacility<PSI>();
     softwareInfo_ = psi->get_plugin_name();
     LOG_INFO_NAMED("plugin software name: " << softwareInfo_);
-    using HWI = Metavision::I_HW_Identification;
-    const HWI * hwi = cam_.get_device().get_facility<HWI>();
-    const auto sinfo = hwi->get_sensor_info();
-    encodingFormat_ = to_lower(hwi->get_current_data_encoding_format());
-    LOG_INFO_NAMED("encoding format: " << encodingFormat_);
-    sensorVersion_ =
-      std::to_string(sinfo.major_version_) + "." + std::to_string(sinfo.minor_version_);
-    LOG_INFO_NAMED("sensor version: " << sensorVersion_);
-    LOG_INFO_NAMED("sensor name: " << sinfo.name_);
     if (!biasFile_.empty()) {
       try {
 #if METAVISION_VERSION < 5
-        cam_.biases().set_from_file(biasFile_);
+        cam_->biases().set_from_file(biasFile_);
 #else
-        cam_.get_device().get_facility<Metavision::I_LL_Biases>()->load_from_file(biasFile_);
+        getFacility<Metavision::I_LL_Biases>()->load_from_file(biasFile_);
 #endif
         LOG_INFO_NAMED("using bias file: " << biasFile_);
       } catch (const Metavision::CameraException & e) {
@@ -369,24 +676,12 @@ bool MetavisionWrapper::initializeCamera()
       }
     } else if (fromFile_.empty()) {  // only load biases when not playing from file!
       LOG_INFO_NAMED("no bias file provided, using camera defaults:");
-      const auto biases = cam_.get_device().get_facility<Metavision::I_LL_Biases>();
+      const auto biases = getFacility<Metavision::I_LL_Biases>();
       const auto pmap = biases->get_all_biases();
       for (const auto & bp : pmap) {
         LOG_INFO_NAMED("found bias param: " << bp.first << " " << bp.second);
       }
     }
-    // overwrite serial in case it was not set
-    serialNumber_ = cam_.get_camera_configuration().serial_number;
-    LOG_INFO_NAMED("camera serial number: " << serialNumber_);
-    const auto & g = cam_.geometry();
-#if METAVISION_VERSION < 5
-    width_ = g.width();
-    height_ = g.height();
-#else
-    width_ = g.get_width();
-    height_ = g.get_height();
-#endif
-    LOG_INFO_NAMED("sensor geometry: " << width_ << " x " << height_);
     if (fromFile_.empty()) {
       applySyncMode(syncMode_);
       applyROI(roi_);
@@ -394,20 +689,15 @@ bool MetavisionWrapper::initializeCamera()
         triggerInMode_, triggerOutMode_, triggerOutPeriod_, triggerOutDutyCycle_);
       configureEventRateController(ercMode_, ercRate_);
       if (mipiFramePeriod_ > 0) {
-        configureMIPIFramePeriod(mipiFramePeriod_, sinfo.name_);
+        configureMIPIFramePeriod(mipiFramePeriod_, sensorName_);
       }
     }
-    statusChangeCallbackId_ = cam_.add_status_change_callback(
+    statusChangeCallbackId_ = cam_->add_status_change_callback(
       std::bind(&MetavisionWrapper::statusChangeCallback, this, ph::_1));
     statusChangeCallbackActive_ = true;
-    runtimeErrorCallbackId_ = cam_.add_runtime_error_callback(
+    runtimeErrorCallbackId_ = cam_->add_runtime_error_callback(
       std::bind(&MetavisionWrapper::runtimeErrorCallback, this, ph::_1));
     runtimeErrorCallbackActive_ = true;
-    rawDataCallbackId_ = cam_.raw_data().add_callback(std::bind(
-      useMultithreading_ ? &MetavisionWrapper::rawDataCallbackMultithreaded
-                         : &MetavisionWrapper::rawDataCallback,
-      this, ph::_1, ph::_2));
-    rawDataCallbackActive_ = true;
   } catch (const Metavision::CameraException & e) {
     LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
     return (false);
@@ -422,7 +712,7 @@ void MetavisionWrapper::configureMIPIFramePeriod(int usec, const std::string & s
     LOG_WARN_NAMED("cannot configure mipi frame period for sensor " << sensorName);
   } else {
     const uint32_t mfpa = it->second;
-    auto hwrf = cam_.get_device().get_facility<Metavision::I_HW_Register>();
+    auto hwrf = getFacility<Metavision::I_HW_Register>();
     const int prev_mfp = hwrf->read_register(mfpa);
     hwrf->write_register(mfpa, usec);
     const int new_mfp = hwrf->read_register(mfpa);
@@ -432,56 +722,121 @@ void MetavisionWrapper::configureMIPIFramePeriod(int usec, const std::string & s
 
 void MetavisionWrapper::setDecodingEvents(bool decodeEvents)
 {
+  decodingEvents_ = decodeEvents;
+  if (!cam_) {
+    LOG_WARN_NAMED("this source does not support decoding events!");
+    return;
+  }
   if (decodeEvents && !contrastCallbackActive_) {
     contrastCallbackId_ =
-      cam_.cd().add_callback(std::bind(&MetavisionWrapper::cdCallback, this, ph::_1, ph::_2));
+      cam_->cd().add_callback(std::bind(&MetavisionWrapper::cdCallback, this, ph::_1, ph::_2));
     contrastCallbackActive_ = true;
   }
   if (decodeEvents && !extTriggerCallbackActive_) {
-    extTriggerCallbackId_ = cam_.ext_trigger().add_callback(
+    extTriggerCallbackId_ = cam_->ext_trigger().add_callback(
       std::bind(&MetavisionWrapper::extTriggerCallback, this, ph::_1, ph::_2));
     extTriggerCallbackActive_ = true;
   }
 
   if (!decodeEvents && contrastCallbackActive_) {
-    cam_.cd().remove_callback(contrastCallbackId_);
+    cam_->cd().remove_callback(contrastCallbackId_);
     contrastCallbackActive_ = false;
   }
   if (!decodeEvents && extTriggerCallbackActive_) {
-    cam_.ext_trigger().remove_callback(extTriggerCallbackId_);
+    cam_->ext_trigger().remove_callback(extTriggerCallbackId_);
     extTriggerCallbackActive_ = false;
   }
 }
 
-void MetavisionWrapper::activateTrailFilter()
+bool MetavisionWrapper::activateTrailFilter()
 {
   Metavision::I_EventTrailFilterModule * i_trail_filter =
-    cam_.get_device().get_facility<Metavision::I_EventTrailFilterModule>();
+    getFacility<Metavision::I_EventTrailFilterModule>();
 
   if (!i_trail_filter) {
     LOG_WARN_NAMED("this camera does not support trail filtering!");
-    return;
+    return (false);
   }
+  bool success = true;
   if (trailFilter_.enabled) {
     const auto it = trailFilterMap.find(trailFilter_.type);
     if (it == trailFilterMap.end()) {
       LOG_WARN_NAMED("unknown trail filter type: " << trailFilter_.type);
+      success = false;
     } else {
       // Set filter type
       if (!i_trail_filter->set_type(it->second)) {
         LOG_WARN_NAMED("cannot set type of trail filter!")
+        success = false;
       }
       if (!i_trail_filter->set_threshold(trailFilter_.threshold)) {
         LOG_WARN_NAMED("cannot set threshold of trail filter!")
+        success = false;
       }
     }
   }
-  i_trail_filter->enable(trailFilter_.enabled);
+  return (i_trail_filter->enable(trailFilter_.enabled) && success);
+}
+
+bool MetavisionWrapper::checkTrailFilter(
+  const std::string & type, const bool state, std::string * msg) const
+{
+  if (state && trailFilterMap.count(type) == 0) {
+    *msg = "trail_filter_type must be one of trail, stc_cut_trail, stc_keep_trail";
+    return (false);
+  }
+  return (true);
+}
+
+bool MetavisionWrapper::updateTrailFilter(
+  const std::string & type, const uint32_t threshold, const bool state, std::string * msg)
+{
+  if (!checkTrailFilter(type, state, msg)) {
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    *msg = "camera is reconnecting, try again later";
+    return (false);
+  }
+  if (!getFacility<Metavision::I_EventTrailFilterModule>()) {
+    *msg = "this camera does not support trail filtering";
+    return (false);
+  }
+  const TrailFilter prev = trailFilter_;
+  setTrailFilter(type, threshold, state);
+  const auto t0 = std::chrono::steady_clock::now();
+  bool success = false;
+  try {
+    success = activateTrailFilter();
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("setting trail filter failed: " << e.what());
+  }
+  if (!success) {
+    trailFilter_ = prev;  // keep reporting what the hardware most likely runs
+  }
+  return (reportUpdate("trail filter", success, t0, msg));
+}
+
+bool MetavisionWrapper::reportUpdate(
+  const std::string & what, bool success, const std::chrono::steady_clock::time_point & t0,
+  std::string * msg)
+{
+  if (!success) {
+    *msg = "camera rejected new " + what + " settings";
+    return (false);
+  }
+  const auto usec =
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0)
+      .count();
+  *msg = "applied in " + std::to_string(usec) + "us";
+  LOG_INFO_NAMED(what << " " << *msg);
+  return (true);
 }
 
 bool MetavisionWrapper::startCamera(CallbackHandler * h)
 {
-  if (trailFilter_.enabled) {
+  if (trailFilter_.enabled && cam_) {
     activateTrailFilter();
   }
 
@@ -490,9 +845,14 @@ bool MetavisionWrapper::startCamera(CallbackHandler * h)
     if (useMultithreading_) {
       processingThread_ = std::make_shared<std::thread>(&MetavisionWrapper::processingThread, this);
     }
-    statsThread_ = std::make_shared<std::thread>(&MetavisionWrapper::statsThread, this);
-    // this will actually start the camera
-    cam_.start();
+    if (statsInterval_ > 0) {
+      statsThread_ = std::make_shared<std::thread>(&MetavisionWrapper::statsThread, this);
+    }
+    if (reconnect_ && isLiveCamera()) {
+      keepReconnecting_ = true;
+      reconnectThread_ = std::make_shared<std::thread>(&MetavisionWrapper::reconnectThread, this);
+    }
+    return (startSource());
   } catch (const Metavision::CameraException & e) {
     LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
     return (false);
@@ -500,9 +860,121 @@ bool MetavisionWrapper::startCamera(CallbackHandler * h)
   return (true);
 }
 
+bool MetavisionWrapper::startSource()
+{
+  cameraStartTime_ = std::chrono::steady_clock::now();
+  hasReceivedData_ = false;
+  // The sensor time of a reopened camera starts over, begin with a fresh
+  // detector. Playback from file and synthetic data can jump in time.
+  timeGapDetector_.reset(
+    (timeGapThreshold_ > 0 && encodingFormat_ == "evt3" && isLiveCamera())
+      ? new evt3::TimeGapDetector(timeGapThreshold_)
+      : nullptr);
+  const auto it = threadConfig_.find("source");
+  if (it != threadConfig_.end()) {
+    source_->setThreadConfig(it->second);
+  }
+  // a seek makes the sensor time jump, the handler must start over
+  source_->setRestartCallback([this]() { restartPending_ = true; });
+  // this will actually start the source
+  return (source_->start(std::bind(
+    useMultithreading_ ? &MetavisionWrapper::rawDataCallbackMultithreaded
+                       : &MetavisionWrapper::rawDataCallback,
+    this, ph::_1, ph::_2)));
+}
+
+void MetavisionWrapper::reconnectThread()
+{
+  configureThread("reconnect", "mv_reconnect");
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    reconnectCv_.wait(lock, [this] { return (!keepReconnecting_ || deviceLost_); });
+    if (!keepReconnecting_) {
+      break;
+    }
+    lock.unlock();
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool success = reconnect();
+    lock.lock();
+    if (success) {
+      numReconnects_++;
+      lastReconnectTime_ = millisecondsSince(t0);
+      LOG_INFO_NAMED(
+        "reconnected in " << lastReconnectTime_ << "ms, number of reconnects: " << numReconnects_);
+    }
+  }
+  LOG_INFO_NAMED("reconnect thread exited!");
+}
+
+bool MetavisionWrapper::reconnect()
+{
+  LOG_WARN_NAMED("camera lost, reconnecting to serial " << serialNumber_);
+  reconnecting_ = true;  // other users of the camera back off from here
+  std::unique_lock<std::mutex> camLock(cameraMutex_);
+  try {
+    source_->stop();
+  } catch (const Metavision::CameraException & e) {
+    LOG_WARN_NAMED("error when stopping lost camera: " << e.what());
+  }
+  removeCameraCallbacks();
+  cam_ = nullptr;
+  source_.reset();  // closes the device
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    deviceLost_ = false;  // no more callbacks from the old device
+  }
+  // opening the device retries with backoff for up to the open timeout,
+  // and it reapplies bias file, sync mode, ROI, triggers, ERC and MIPI period
+  while (!initializeCamera()) {
+    source_.reset();
+    cam_ = nullptr;
+    camLock.unlock();  // don't hold up shutdown or other callers while waiting
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (reconnectCv_.wait_for(
+            lock, std::chrono::seconds(1), [this] { return (!keepReconnecting_); })) {
+        reconnecting_ = false;  // shutting down, camera stays closed
+        return (false);
+      }
+    }
+    camLock.lock();
+  }
+  {
+    // bias changes deferred during the reconnect are in the cache as well
+    std::unique_lock<std::mutex> cacheLock(biasCacheMutex_);
+    const auto biases = getFacility<Metavision::I_LL_Biases>();
+    for (const auto & b : biasCache_) {
+      if (biases && readOnlyBiases.count(b.first) == 0 && !biases->set(b.first, b.second)) {
+        LOG_WARN_NAMED("cannot restore bias " << b.first << " to " << b.second);
+      }
+    }
+    reconnecting_ = false;  // callers now wait for camLock and write to the device
+  }
+  refreshBiasCache();
+  if (trailFilter_.enabled) {
+    activateTrailFilter();
+  }
+  if (decodingEvents_) {
+    setDecodingEvents(true);
+  }
+  restartPending_ = true;  // handler resets its state before the next data
+  try {
+    return (startSource());
+  } catch (const Metavision::CameraException & e) {
+    LOG_ERROR_NAMED("cannot restart camera: " << e.what());
+  }
+  return (false);
+}
+
 void MetavisionWrapper::runtimeErrorCallback(const Metavision::CameraException & e)
 {
   LOG_ERROR_NAMED("camera runtime error occured: " << e.what());
+  // the device stops streaming after a runtime error, e.g. USB disconnect
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (keepReconnecting_ && !deviceLost_) {
+    deviceLost_ = true;
+    reconnectCv_.notify_all();
+  }
 }
 
 void MetavisionWrapper::statusChangeCallback(const Metavision::CameraStatus & s)
@@ -512,15 +984,24 @@ void MetavisionWrapper::statusChangeCallback(const Metavision::CameraStatus & s)
 
 bool MetavisionWrapper::saveBiases()
 {
+  std::unique_lock<std::mutex> lock = lockCamera();
+  if (!lock.owns_lock()) {
+    LOG_WARN_NAMED("camera is reconnecting, no biases saved!");
+    return (false);
+  }
+  if (!cam_) {
+    LOG_WARN_NAMED("source has no biases, no biases saved!");
+    return (false);
+  }
   if (biasFile_.empty()) {
     LOG_WARN_NAMED("no bias file specified at startup, no biases saved!");
     return (false);
   } else {
     try {
 #if METAVISION_VERSION < 5
-      cam_.biases().save_to_file(biasFile_);
+      cam_->biases().save_to_file(biasFile_);
 #else
-      cam_.get_device().get_facility<Metavision::I_LL_Biases>()->save_to_file(biasFile_);
+      getFacility<Metavision::I_LL_Biases>()->save_to_file(biasFile_);
 #endif
       LOG_INFO_NAMED("biases written to file: " << biasFile_);
     } catch (const Metavision::CameraException & e) {
@@ -534,33 +1015,87 @@ bool MetavisionWrapper::saveBiases()
 void MetavisionWrapper::rawDataCallback(const uint8_t * data, size_t size)
 {
   if (size != 0) {
+    if (!hasReceivedData_) {
+      sourceThreadStarted();
+    }
+    if (restartPending_) {
+      restartPending_ = false;
+      callbackHandler_->sourceRestarted();
+    }
+    uint64_t lostTime;
+    const auto gap = checkTimeContinuity(data, size, &lostTime);
+    if (gap != evt3::TimeGapDetector::NONE) {
+      callbackHandler_->sensorTimeGap(lostTime, gap == evt3::TimeGapDetector::RESET);
+    }
     const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
                          std::chrono::system_clock::now().time_since_epoch())
                          .count();
+    TRACE_SCOPE("sdk_callback", t);
     callbackHandler_->rawDataCallback(t, data, data + size);
     {
       std::unique_lock<std::mutex> lock(statsMutex_);
       stats_.msgsRecv++;
       stats_.bytesRecv += size;
+      recordLatency(t);
     }
   }
 }
 
+int64_t MetavisionWrapper::millisecondsSince(const std::chrono::steady_clock::time_point & t)
+{
+  return (
+    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t)
+      .count());
+}
+
+void MetavisionWrapper::logTimeToFirstData()
+{
+  // runs on the source thread
+  hasReceivedData_ = true;
+  LOG_INFO_NAMED(
+    "first events " << millisecondsSince(cameraStartTime_) << "ms after camera start, "
+                    << millisecondsSince(initStartTime_) << "ms after initialization start");
+}
+
+void MetavisionWrapper::sourceThreadStarted()
+{
+  // runs on the source thread when the first data arrives
+  logTimeToFirstData();
+  threadCpuMonitor_.registerThread("source");  // replaces thread from before reconnect
+  if (!source_->ownsCallbackThread()) {
+    // the SDK created this thread, so the source could not configure it
+    configureThread("source", "mv_sdk_source");
+  }
+}
+
 void MetavisionWrapper::rawDataCallbackMultithreaded(const uint8_t * data, size_t size)
 {
   // queue stuff away quickly to prevent events from being
   // dropped at the SDK level
   if (size != 0) {
+    if (!hasReceivedData_) {
+      sourceThreadStarted();
+    }
     const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
                          std::chrono::system_clock::now().time_since_epoch())
                          .count();
+    TRACE_SCOPE("sdk_callback", t);
     {
-      void * memblock = malloc(size);
+      void * memblock = bufferPool_ ? bufferPool_->allocate(size) : nullptr;
+      if (!memblock) {
+        memblock = malloc(size);
+      }
       memcpy(memblock, data, size);
+      QueueElement qe(memblock, size, t);
+      qe.isRestart = restartPending_;  // processing thread calls the handler
+      restartPending_ = false;
+      qe.isTimeReset =
+        checkTimeContinuity(data, size, &qe.lostTime) == evt3::TimeGapDetector::RESET;
       std::unique_lock<std::mutex> lock(mutex_);
-      queue_.push_front(QueueElement(memblock, size, t));
+      queue_.push_front(qe);
       cv_.notify_all();
     }
+    TRACE_INSTANT("enqueue", t);
     {
       std::unique_lock<std::mutex> lock(statsMutex_);
       stats_.msgsRecv++;
@@ -586,8 +1121,61 @@ void MetavisionWrapper::extTriggerCallback(
   // do nothing for now
 }
 
+void MetavisionWrapper::configureThread(const std::string & thread, const std::string & name)
+{
+  const auto it = threadConfig_.find(thread);
+  const ThreadConfig cfg = (it == threadConfig_.end()) ? ThreadConfig() : it->second;
+  std::string report;
+  if (cfg.apply(name, &report)) {
+    LOG_INFO_NAMED(report);
+  } else {
+    LOG_WARN_NAMED(report);
+  }
+}
+
+void MetavisionWrapper::configureMemory()
+{
+  if (tuneHeap_) {
+    // Keep large freed blocks (message storage) in the heap rather than
+    // returning them to the OS, so they don't have to be faulted in again.
+    // This changes the allocator of the whole process, hence opt-in.
+    mallopt(M_MMAP_THRESHOLD, 32 << 20);
+    mallopt(M_TRIM_THRESHOLD, 256 << 20);
+  }
+  if (useMultithreading_ && bufferPoolMode_ != "none") {
+    bufferPool_ = std::make_shared<BufferPool>(loggerName_);
+    if (!bufferPool_->initialize(bufferPoolMode_, bufferPoolBlockSize_, bufferPoolNumBlocks_)) {
+      bufferPool_.reset();
+    }
+  }
+}
+
+void MetavisionWrapper::prefaultHeap()
+{
+  // Touch and free a large block such that the heap of the calling
+  // thread's arena is populated before the first messages are built.
+  // Without the raised heap thresholds the block is mmapped and unmapped
+  // again on free, so this only helps with tuneHeap_.
+  if (!tuneHeap_ || heapPrefaultSize_ == 0) {
+    return;
+  }
+  void * p = malloc(heapPrefaultSize_);
+  if (p) {
+    memset(p, 0, heapPrefaultSize_);
+    free(p);
+  }
+}
+
 void MetavisionWrapper::processingThread()
 {
+  configureThread("processing", "mv_processing");
+  threadCpuMonitor_.registerThread("processing");
+  // Now that the thread runs on its final CPU, fault in the memory
+  // such that it lands on the local NUMA node.
+  if (bufferPool_) {
+    bufferPool_->prefault();
+  }
+  prefaultHeap();
   const std::chrono::microseconds timeout((int64_t)(1000000LL));
   while (GENERIC_ROS_OK() && keepRunning_) {
     QueueElement qe;
@@ -604,15 +1192,27 @@ void MetavisionWrapper::processingThread()
       }
     }
     if (qe.numBytes != 0) {
+      TRACE_INSTANT("dequeue", qe.timeStamp);
+      TRACE_SCOPE("process", qe.timeStamp);
+      if (qe.isRestart) {
+        callbackHandler_->sourceRestarted();
+      }
+      if (qe.lostTime != 0 || qe.isTimeReset) {
+        callbackHandler_->sensorTimeGap(qe.lostTime, qe.isTimeReset);
+      }
       const uint8_t * data = static_cast<const uint8_t *>(qe.start);
       callbackHandler_->rawDataCallback(qe.timeStamp, data, data + qe.numBytes);
-      free(const_cast<void *>(qe.start));
+      if (!bufferPool_ || !bufferPool_->release(const_cast<void *>(qe.start))) {
+        free(const_cast<void *>(qe.start));
+      }
       {
         std::unique_lock<std::mutex> lock(statsMutex_);
         stats_.maxQueueSize = std::max(stats_.maxQueueSize, qs);
+        recordLatency(qe.timeStamp);  // includes the time spent in the queue
       }
     }
   }
+  threadCpuMonitor_.unregisterThread();
   LOG_INFO_NAMED("processing thread exited!");
 }
 
@@ -626,53 +1226,209 @@ void MetavisionWrapper::setExternalTriggerOutMode(
 
 void MetavisionWrapper::statsThread()
 {
+  configureThread("stats", "mv_stats");
+  threadCpuMonitor_.registerThread("stats");
   while (GENERIC_ROS_OK() && keepRunning_) {
     std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(statsInterval_ * 1000)));
     printStatistics();
   }
+  threadCpuMonitor_.unregisterThread();
   LOG_INFO_NAMED("statistics thread exited!");
 }
 
-void MetavisionWrapper::printStatistics()
+MetavisionWrapper::Stats MetavisionWrapper::takeStatistics()
+{
+  std::unique_lock<std::mutex> lock(statsMutex_);
+  Stats stats = stats_;
+  stats_ = Stats();  // reset statistics
+  return (stats);
+}
+
+MetavisionWrapper::StatsReport MetavisionWrapper::makeStatsReport()
 {
-  Stats stats;
+  StatsReport r;
+  const Stats stats = takeStatistics();
+  std::vector<uint32_t> latencies;
   {
     std::unique_lock<std::mutex> lock(statsMutex_);
-    stats = stats_;
-    stats_ = Stats();  // reset statistics
+    latencies.swap(latencies_);
+    numLatencies_ = 0;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    r.queueSize = queue_.size();
   }
   std::chrono::time_point<std::chrono::system_clock> t_now = std::chrono::system_clock::now();
-  const double dt = std::chrono::duration<double>(t_now - lastPrintTime_).count();
+  r.interval = std::chrono::duration<double>(t_now - lastPrintTime_).count();
   lastPrintTime_ = t_now;
-  const double invT = dt > 0 ? 1.0 / dt : 0;
-  const double recvByteRate = 1e-6 * stats.bytesRecv * invT;
+  const double invT = r.interval > 0 ? 1.0 / r.interval : 0;
+  r.bytesInRate = 1e-6 * stats.bytesRecv * invT;
+  r.bytesOutRate = 1e-6 * stats.bytesSent * invT;
+  r.msgsInRate = stats.msgsRecv * invT;
+  r.msgsOutRate = stats.msgsSent * invT;
+  r.msgsDropped = stats.msgsDropped;
+  r.maxQueueSize = stats.maxQueueSize;
+  if (!latencies.empty()) {
+    // percentiles by partial sorting, in order of increasing rank
+    const size_t n = latencies.size();
+    auto percentile = [&latencies, n](double p) {
+      auto it = latencies.begin() + std::min(static_cast<size_t>(p * n), n - 1);
+      std::nth_element(latencies.begin(), it, latencies.end());
+      return (static_cast<double>(*it));
+    };
+    r.latencyP50 = percentile(0.5);
+    r.latencyP90 = percentile(0.9);
+    r.latencyP99 = percentile(0.99);
+    r.latencyMax = *std::max_element(latencies.begin(), latencies.end());
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  const long pageFaults = usage.ru_minflt + usage.ru_majflt;  // NOLINT
+  r.pageFaultRate = (pageFaults - lastPageFaults_) * invT;
+  lastPageFaults_ = pageFaults;
+  const double cpuTime = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                         1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+  r.cpuLoad = 100.0 * (cpuTime - lastCpuTime_) * invT;
+  lastCpuTime_ = cpuTime;
+  if (stats.bytesCompressedIn != 0) {
+    r.compressionRatio =
+      static_cast<double>(stats.bytesCompressedIn) / std::max(stats.bytesCompressedOut, size_t(1));
+    r.compressedRate = 1e-6 * stats.bytesCompressedOut * invT;
+  }
+  r.numReconnects = numReconnects_;
+  r.numTimeGaps = stats.timeGaps;
+  r.numTimeResets = stats.timeResets;
+  r.lostTime = 1e-3 * stats.timeLost;
+  r.threads = threadCpuMonitor_.sample();
+  return (r);
+}
+
+void MetavisionWrapper::recordLatency(uint64_t t)
+{
+  // must be called with statsMutex_ held
+  const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  const uint32_t usec = static_cast<uint32_t>(
+    std::min((now > t ? now - t : 0) / 1000, uint64_t(std::numeric_limits<uint32_t>::max())));
+  if (latencies_.size() < MAX_LATENCY_SAMPLES) {
+    latencies_.push_back(usec);
+  } else {
+    latencies_[numLatencies_ % MAX_LATENCY_SAMPLES] = usec;  // keep the most recent
+  }
+  numLatencies_++;
+}
 
-  const int recvMsgRate = static_cast<int>(stats.msgsRecv * invT);
-  const int sendMsgRate = static_cast<int>(stats.msgsSent * invT);
+evt3::TimeGapDetector::Result MetavisionWrapper::checkTimeContinuity(
+  const uint8_t * data, size_t size, uint64_t * lostTime)
+{
+  // runs on the source thread
+  *lostTime = 0;
+  if (!timeGapDetector_) {
+    return (evt3::TimeGapDetector::NONE);
+  }
+  const auto result = timeGapDetector_->check(data, data + size, lostTime);
+  if (result != evt3::TimeGapDetector::NONE) {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    if (result == evt3::TimeGapDetector::GAP) {
+      stats_.timeGaps++;
+      stats_.timeLost += *lostTime;
+    } else {
+      stats_.timeResets++;
+    }
+  }
+  return (result);
+}
+
+void MetavisionWrapper::printStatistics()
+{
+  const StatsReport r = makeStatsReport();
+  std::vector<std::function<std::string()>> reporters;
+  std::function<void(const StatsReport &)> callback;
+  {
+    std::unique_lock<std::mutex> lock(statsMutex_);
+    reporters = statsReporters_;
+    callback = statsCallback_;
+  }
+  if (callback) {
+    callback(r);
+  }
+  if (trimHeap_.exchange(false)) {
+    // the message reservations shrank, release the memory of the peak
+    const int released = malloc_trim(0);
+    LOG_INFO_NAMED("trimmed heap, memory returned to OS: " << (released ? "yes" : "no"));
+  }
+  if (!statsLogging_) {
+    return;
+  }
+  const int recvMsgRate = static_cast<int>(r.msgsInRate);
+  const int sendMsgRate = static_cast<int>(r.msgsOutRate);
+  const int pageFaultRate = static_cast<int>(r.pageFaultRate);
 
 #ifndef USING_ROS_1
   if (useMultithreading_) {
     LOG_INFO_NAMED_FMT(
       "bw in: %9.5f MB/s, msgs/s in: %7d, "
-      "out: %7d, maxq: %4zu",
-      recvByteRate, recvMsgRate, sendMsgRate, stats.maxQueueSize);
+      "out: %7d, maxq: %4zu, pf/s: %6d",
+      r.bytesInRate, recvMsgRate, sendMsgRate, r.maxQueueSize, pageFaultRate);
   } else {
     LOG_INFO_NAMED_FMT(
       "bw in: %9.5f MB/s, msgs/s in: %7d, "
-      "out: %7d",
-      recvByteRate, recvMsgRate, sendMsgRate);
+      "out: %7d, pf/s: %6d",
+      r.bytesInRate, recvMsgRate, sendMsgRate, pageFaultRate);
   }
 #else
   if (useMultithreading_) {
     LOG_INFO_NAMED_FMT(
-      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d, maxq: %4zu", loggerName_.c_str(),
-      recvByteRate, recvMsgRate, sendMsgRate, stats.maxQueueSize);
+      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d, maxq: %4zu, pf/s: %6d",
+      loggerName_.c_str(), r.bytesInRate, recvMsgRate, sendMsgRate, r.maxQueueSize,
+      pageFaultRate);
   } else {
     LOG_INFO_NAMED_FMT(
-      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d", loggerName_.c_str(), recvByteRate,
-      recvMsgRate, sendMsgRate);
+      "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d, pf/s: %6d", loggerName_.c_str(),
+      r.bytesInRate, recvMsgRate, sendMsgRate, pageFaultRate);
   }
 #endif
+  if (r.compressionRatio != 0) {
+#ifndef USING_ROS_1
+    LOG_INFO_NAMED_FMT(
+      "compression ratio: %6.2f, bw out: %9.5f MB/s", r.compressionRatio, r.compressedRate);
+#else
+    LOG_INFO_NAMED_FMT(
+      "%s: compression ratio: %6.2f, bw out: %9.5f MB/s", loggerName_.c_str(),
+      r.compressionRatio, r.compressedRate);
+#endif
+  }
+  if (!r.threads.empty()) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "threads cpu% (vcs/s, ics/s):";
+    for (const auto & u : r.threads) {
+      ss << " " << u.name << ": " << u.cpuLoad << " (" << std::setprecision(0)
+         << u.voluntarySwitchRate << ", " << u.involuntarySwitchRate << ")"
+         << std::setprecision(1);
+    }
+    LOG_INFO_NAMED(ss.str());
+  }
+  if (r.numTimeGaps != 0) {
+    LOG_WARN_NAMED(
+      "sensor time gaps: " << r.numTimeGaps << ", data lost: " << r.lostTime << "ms");
+  }
+  if (r.numTimeResets != 0) {
+    LOG_WARN_NAMED("sensor clock resets: " << r.numTimeResets);
+  }
+  if (r.msgsDropped != 0) {
+    LOG_WARN_NAMED("messages dropped: " << r.msgsDropped);
+  }
+  if (numReconnects_ != 0) {
+    LOG_INFO_NAMED(
+      "reconnects: " << numReconnects_ << ", last reconnect took: " << lastReconnectTime_ << "ms");
+  }
+  for (const auto & reporter : reporters) {
+    const std::string line = reporter();
+    if (!line.empty()) {
+      LOG_INFO_NAMED(line);
+    }
+  }
 }
 
 }  // namespace metavision_driver
@@ -0,0 +1,423 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "metavision_driver/multi_driver_ros2.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <rclcpp_components/register_node_macro.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/logging.h"
+#include "metavision_driver/parameters_ros2.h"
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+MultiDriverROS2::MultiDriverROS2(const rclcpp::NodeOptions & options)
+: Node(
+    "metavision_multi_driver",
+    rclcpp::NodeOptions(options).automatically_declare_parameters_from_overrides(true))
+{
+  std::vector<std::string> names;
+  this->get_parameter_or("cameras", names, std::vector<std::string>());
+  if (names.empty()) {
+    LOG_ERROR("no cameras configured, set the cameras parameter!");
+    throw std::runtime_error("no cameras configured!");
+  }
+  int numThreads, maxQueued;
+  this->get_parameter_or("num_threads", numThreads, 2);
+  this->get_parameter_or("max_queued", maxQueued, 64);
+  pool_ = std::make_shared<StrandPool>(
+    get_name(), "mv_publish", numThreads, static_cast<size_t>(std::max(maxQueued, 1)));
+  for (const auto & name : names) {
+    cameras_.emplace_back(new Camera(this, name));
+  }
+  bool sync;
+  this->get_parameter_or("sync", sync, false);
+  if (sync) {
+    // first camera provides the clock unless the sync modes are set explicitly
+    for (size_t i = 0; i < cameras_.size(); i++) {
+      if (!this->has_parameter(names[i] + ".sync_mode")) {
+        cameras_[i]->setSyncMode(i == 0 ? "primary" : "secondary");
+      }
+    }
+  }
+  // opening the devices and applying biases, ROI etc takes a while,
+  // so do it for all cameras in parallel
+  const auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::string> errors(cameras_.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < cameras_.size(); i++) {
+    LOG_INFO("camera " << cameras_[i]->getName() << " sync mode: " << cameras_[i]->getSyncMode());
+    threads.emplace_back([this, i, &errors]() {
+      try {
+        cameras_[i]->initialize();
+      } catch (const std::exception & e) {
+        errors[i] = e.what();
+      }
+    });
+  }
+  for (auto & th : threads) {
+    th.join();
+  }
+  for (size_t i = 0; i < cameras_.size(); i++) {
+    if (!errors[i].empty()) {
+      LOG_ERROR("camera " << cameras_[i]->getName() << " failed: " << errors[i]);
+      throw std::runtime_error("camera initialization failed!");
+    }
+  }
+  LOG_INFO(
+    "initialized " << cameras_.size() << " camera(s) in "
+                   << std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - t0)
+                        .count()
+                   << "ms");
+  pool_->start(get_thread_config(this, "publishing_thread"));
+  LOG_INFO(
+    "publishing " << cameras_.size() << " camera(s) on " << pool_->getNumThreads()
+                  << " thread(s)");
+
+  // the secondaries must be streaming before the primary starts the clock
+  for (auto & cam : cameras_) {
+    if (cam->getSyncMode() == "secondary") {
+      cam->start();
+    }
+  }
+  for (auto & cam : cameras_) {
+    if (cam->getSyncMode() != "secondary") {
+      cam->start();
+    }
+  }
+
+  double printInterval;
+  this->get_parameter_or("statistics_print_interval", printInterval, 1.0);
+  if (printInterval > 0) {
+    lastPrintTime_ = std::chrono::steady_clock::now();
+    statsTimer_ = this->create_wall_timer(
+      std::chrono::duration<double>(printInterval),
+      std::bind(&MultiDriverROS2::printStatistics, this));
+  }
+}
+
+MultiDriverROS2::~MultiDriverROS2()
+{
+  for (auto & cam : cameras_) {
+    cam->stop();  // no more callbacks from here on
+  }
+  pool_->stop();
+  cameras_.clear();
+}
+
+void MultiDriverROS2::printStatistics()
+{
+  const auto now = std::chrono::steady_clock::now();
+  const double dt = std::chrono::duration<double>(now - lastPrintTime_).count();
+  lastPrintTime_ = now;
+  const double invT = dt > 0 ? 1.0 / dt : 0;
+  MetavisionWrapper::Stats total;
+  bool trimHeap(false);
+  for (auto & cam : cameras_) {
+    const MetavisionWrapper::Stats s = cam->takeStatistics();
+    total.msgsRecv += s.msgsRecv;
+    total.msgsSent += s.msgsSent;
+    total.bytesRecv += s.bytesRecv;
+    total.bytesSent += s.bytesSent;
+    if (cameras_.size() > 1) {
+      LOG_INFO_FMT(
+        "%s: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d", cam->getName().c_str(),
+        1e-6 * s.bytesRecv * invT, static_cast<int>(s.msgsRecv * invT),
+        static_cast<int>(s.msgsSent * invT));
+    }
+    if (s.timeGaps != 0 || s.timeResets != 0) {
+      LOG_WARN(
+        cam->getName() << ": sensor time gaps: " << s.timeGaps << ", data lost: "
+                       << 1e-3 * s.timeLost << "ms, clock resets: " << s.timeResets);
+    }
+    for (const auto & line : cam->getStatsReport()) {
+      LOG_INFO(cam->getName() << ": " << line);
+    }
+    trimHeap = cam->takeTrimRequest() || trimHeap;
+  }
+  LOG_INFO_FMT(
+    "total: bw in: %9.5f MB/s, msgs/s in: %7d, out: %7d", 1e-6 * total.bytesRecv * invT,
+    static_cast<int>(total.msgsRecv * invT), static_cast<int>(total.msgsSent * invT));
+  for (const auto & line : pool_->getStatsReport()) {
+    LOG_INFO(line);
+  }
+  if (trimHeap) {
+    // the message reservations shrank, release the memory of the peak
+    const int released = malloc_trim(0);
+    LOG_INFO("trimmed heap, memory returned to OS: " << (released ? "yes" : "no"));
+  }
+}
+
+MultiDriverROS2::Camera::Camera(MultiDriverROS2 * driver, const std::string & name)
+: driver_(driver), name_(name), loggerName_(std::string(driver->get_name()) + "." + name)
+{
+  wrapper_ = std::make_shared<MetavisionWrapper>(loggerName_);
+  configure_wrapper(driver, name, wrapper_.get());
+  wrapper_->setStatisticsInterval(0);  // the driver prints for all cameras
+  get_camera_parameter(driver, name, "encoding", &encoding_, std::string("evt3"));
+  if (!is_supported_encoding(encoding_)) {
+    LOG_ERROR_NAMED("invalid encoding: " << encoding_);
+    throw std::runtime_error("invalid encoding!");
+  }
+  wrapper_->setRequestedEncoding(encoding_);
+  packetSizer_.setConfig(get_packet_sizer_config(driver, name));
+  reservePolicy_.setConfig(get_reserve_policy_config(driver, name));
+  // frame id and serial number must be set per camera
+  driver->get_parameter_or(name + ".frame_id", frameId_, std::string(""));
+
+  int qs;
+  get_camera_parameter(driver, name, "send_queue_size", &qs, 1000);
+  const std::string prefix = "~/" + name + "/";
+  eventPub_ = driver->create_publisher<EventPacketMsg>(
+    prefix + "events", rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  infoPub_ = driver->create_publisher<EventPacketInfoMsg>(
+    prefix + "events_info",
+    rclcpp::QoS(rclcpp::KeepLast(qs)).best_effort().durability_volatile());
+  triggerPub_ = driver->create_publisher<ExtTriggerMsg>(prefix + "trigger", rclcpp::QoS(100));
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(loggerName_);
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  strand_ = driver->pool_->addStrand(name);
+}
+
+void MultiDriverROS2::Camera::initialize()
+{
+  std::string biasFile;
+  get_camera_parameter(driver_, name_, "bias_file", &biasFile, std::string(""));
+  // the SDK thread assembles the messages, no need for a processing thread
+  if (!wrapper_->initialize(false, biasFile)) {
+    LOG_ERROR_NAMED("initialization failed for camera " << name_);
+    throw std::runtime_error("camera initialization failed!");
+  }
+  if (wrapper_->getSyncMode() == "secondary") {
+    // filter out events with zero time stamps until the primary is up,
+    // see DriverROS2::start()
+    wrapper_->setDecodingEvents(true);
+  }
+  if (frameId_.empty()) {
+    const auto sn = wrapper_->getSerialNumber();
+    frameId_ = (sn.size() > 4) ? sn.substr(sn.size() - 4) : name_;
+  }
+  LOG_INFO_NAMED("using frame id: " << frameId_);
+  if (wrapper_->getEncodingFormat() != encoding_) {
+    LOG_ERROR_NAMED(
+      "encoding mismatch, camera has: " << wrapper_->getEncodingFormat() << ", but expecting "
+                                        << encoding_);
+    throw std::runtime_error("encoding mismatch!");
+  }
+  width_ = wrapper_->getWidth();
+  height_ = wrapper_->getHeight();
+}
+
+void MultiDriverROS2::Camera::start()
+{
+  if (!wrapper_->startCamera(this)) {
+    LOG_ERROR_NAMED("cannot start camera " << name_);
+    throw std::runtime_error("cannot start camera!");
+  }
+}
+
+void MultiDriverROS2::Camera::stop() { wrapper_->stop(); }
+
+std::vector<std::string> MultiDriverROS2::Camera::getStatsReport()
+{
+  std::vector<std::string> lines;
+  if (packetSizer_.isAdaptive()) {
+    lines.push_back(packetSizer_.getStatsReport());
+  }
+  lines.push_back(reservePolicy_.getStatsReport());
+  lines.erase(
+    std::remove_if(
+      lines.begin(), lines.end(), [](const std::string & s) { return (s.empty()); }),
+    lines.end());
+  return (lines);
+}
+
+void MultiDriverROS2::Camera::rawDataCallback(
+  uint64_t t, const uint8_t * start, const uint8_t * end)
+{
+  // runs on the SDK thread of this camera
+  const bool sendTriggers = triggerPub_->get_subscription_count() > 0;
+  const bool sendRaw = eventPub_->get_subscription_count() > 0;
+  if (sendRaw && !msg_) {
+    msg_.reset(new EventPacketMsg());
+    msg_->header.frame_id = frameId_;
+    msg_->encoding = encoding_;
+    msg_->seq = seq_++;
+    msg_->width = width_;
+    msg_->height = height_;
+    msg_->header.stamp = rclcpp::Time(t, RCL_SYSTEM_TIME);
+    msg_->events.reserve(reservePolicy_.getReserveSize());
+    packetInfo_ = PacketInfo();
+  }
+  if (sendTriggers || sendRaw) {
+    if (scanPaused_) {
+      // the scanner has missed data, possibly TIME_HIGH roll-overs as well
+      scanner_ = std::make_shared<RawScanner>(encoding_);
+      timeKeeper_ = std::make_shared<ROSTimeKeeper>(loggerName_);
+      scanPaused_ = false;
+    }
+    triggers_.clear();
+    scanner_->scan(
+      start, end, sendTriggers ? &triggers_ : nullptr, sendRaw ? &packetInfo_ : nullptr);
+    if (sendTriggers) {
+      publishTriggers(t);
+    }
+  } else {
+    scanPaused_ = true;
+  }
+  if (!sendRaw) {
+    msg_.reset();
+    return;
+  }
+  const size_t n = end - start;
+  auto & events = msg_->events;
+  const size_t oldSize = events.size();
+  resize_hack(events, oldSize + n);
+  memcpy(reinterpret_cast<void *>(events.data() + oldSize), start, n);
+  if (!packetSizer_.isComplete(t, events.size(), packetInfo_)) {
+    return;
+  }
+  sendMessage(t);
+}
+
+void MultiDriverROS2::Camera::sendMessage(uint64_t t)
+{
+  auto & events = msg_->events;
+  reservePolicy_.update(events.size(), events.capacity());
+  if (reservePolicy_.takeTrimRequest()) {
+    trimHeap_ = true;
+  }
+  msg_->time_base = packetInfo_.startTime * 1000;  // usec -> nsec
+  const size_t numBytes = events.size();
+  // std::function must be copyable, hence the shared pointers
+  auto info = std::make_shared<EventPacketInfoMsg::UniquePtr>(
+    infoPub_->get_subscription_count() > 0 ? makePacketInfo() : nullptr);
+  auto msg = std::make_shared<EventPacketMsg::UniquePtr>(std::move(msg_));
+  const bool queued = driver_->pool_->submit(strand_, [this, msg, info, numBytes]() {
+    if (*info) {
+      infoPub_->publish(std::move(*info));
+    }
+    eventPub_->publish(std::move(*msg));
+    wrapper_->updateBytesSent(numBytes);
+    wrapper_->updateMsgsSent(1);
+  });
+  if (!queued) {
+    RCLCPP_WARN_THROTTLE(
+      rclcpp::get_logger(loggerName_), *driver_->get_clock(), 1000,
+      "publishing falling behind, dropping message!");
+    wrapper_->updateMsgsDropped(1);
+  }
+  packetSizer_.messageSent(t, packetInfo_.numEvents);
+  lostTime_ = 0;
+  timeReset_ = false;
+}
+
+void MultiDriverROS2::Camera::flushMessage()
+{
+  if (!msg_) {
+    return;
+  }
+  if (eventPub_->get_subscription_count() == 0) {
+    msg_.reset();
+    return;
+  }
+  const uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  sendMessage(t);
+}
+
+MultiDriverROS2::EventPacketInfoMsg::UniquePtr MultiDriverROS2::Camera::makePacketInfo() const
+{
+  EventPacketInfoMsg::UniquePtr msg(new EventPacketInfoMsg());
+  msg->header = msg_->header;
+  msg->seq = msg_->seq;
+  msg->time_base = msg_->time_base;
+  msg->first_event_time = packetInfo_.firstTime * 1000;
+  msg->last_event_time = packetInfo_.lastTime * 1000;
+  msg->num_events = packetInfo_.numEvents;
+  msg->num_bytes = msg_->events.size();
+  msg->lost_time = lostTime_ * 1000;
+  msg->time_reset = timeReset_;
+  return (msg);
+}
+
+void MultiDriverROS2::Camera::publishTriggers(uint64_t t)
+{
+  if (!scanner_->hasValidTime()) {
+    return;
+  }
+  // scanner time is in usec, time keeper works in nanoseconds
+  const uint64_t rosTimeOffset = timeKeeper_->updateROSTimeOffset(scanner_->getTime() * 1e3, t);
+  for (const auto & trig : triggers_) {
+    ExtTriggerMsg::UniquePtr msg(new ExtTriggerMsg());
+    msg->sensor_time = trig.time * 1000;
+    const uint64_t stamp = rosTimeOffset + msg->sensor_time;
+    msg->header.frame_id = frameId_;
+    msg->header.stamp = rclcpp::Time(stamp, RCL_SYSTEM_TIME);
+    msg->id = trig.id;
+    msg->polarity = trig.polarity;
+    timeKeeper_->setLastROSTime(stamp);
+    triggerPub_->publish(std::move(msg));
+  }
+}
+
+void MultiDriverROS2::Camera::eventCDCallback(
+  uint64_t, const Metavision::EventCD * start, const Metavision::EventCD * end)
+{
+  // only called on a secondary during startup, see DriverROS2::eventCDCallback()
+  for (auto e = start; e != end; e++) {
+    if (e->t == 0) {
+      return;
+    }
+  }
+  LOG_INFO_NAMED("secondary sees primary up!");
+  wrapper_->setDecodingEvents(false);
+}
+void MultiDriverROS2::Camera::sourceRestarted()
+{
+  resetSensorTime();
+  LOG_INFO_NAMED("source restarted, continuing with sequence number " << seq_);
+}
+
+void MultiDriverROS2::Camera::sensorTimeGap(uint64_t lostTime, bool isReset)
+{
+  // same as DriverROS2::sensorTimeGap()
+  if (isReset) {
+    resetSensorTime();
+    timeReset_ = true;
+  }
+  lostTime_ += lostTime;
+}
+
+void MultiDriverROS2::Camera::resetSensorTime()
+{
+  // same as DriverROS2::resetSensorTime()
+  flushMessage();
+  scanner_ = std::make_shared<RawScanner>(encoding_);
+  timeKeeper_ = std::make_shared<ROSTimeKeeper>(loggerName_);
+}
+
+}  // namespace metavision_driver
+
+RCLCPP_COMPONENTS_REGISTER_NODE(metavision_driver::MultiDriverROS2)
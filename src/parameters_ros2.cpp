@@ -0,0 +1,235 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "metavision_driver/parameters_ros2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace metavision_driver
+{
+static std::vector<std::string> split_string(const std::string & s)
+{
+  std::stringstream ss(s);
+  std::string tmp;
+  std::vector<std::string> words;
+  while (getline(ss, tmp, '.')) {
+    words.push_back(tmp);
+  }
+  return (words);
+}
+
+MetavisionWrapper::HardwarePinConfig get_hardware_pin_config(rclcpp::Node * node)
+{
+  MetavisionWrapper::HardwarePinConfig config;
+  // builds map, e.g:
+  // config["evc3a_plugin_gen31"]["external"] = 0
+  // config["evc3a_plugin_gen31"]["loopback"] = 6
+  const auto params = node->list_parameters({"prophesee_pin_config"}, 10 /* 10 deep */);
+  for (const auto & name : params.names) {
+    auto a = split_string(name);
+    if (a.size() != 3) {
+      RCLCPP_ERROR_STREAM(node->get_logger(), "invalid pin config found: " << name);
+    } else {
+      int64_t pin;
+      node->get_parameter(name, pin);
+      auto it_bool = config.insert({a[1], std::map<std::string, int>()});
+      it_bool.first->second.insert({a[2], static_cast<int>(pin)});
+    }
+  }
+  return (config);
+}
+
+ThreadConfig get_thread_config(
+  rclcpp::Node * node, const std::string & prefix, const std::string & camera)
+{
+  ThreadConfig config;
+  std::vector<int64_t> cpus;
+  get_camera_parameter(node, camera, prefix + "_cpus", &cpus, std::vector<int64_t>());
+  config.cpus.assign(cpus.begin(), cpus.end());
+  get_camera_parameter(node, camera, prefix + "_policy", &config.policy, std::string("other"));
+  get_camera_parameter(node, camera, prefix + "_priority", &config.priority, 0);
+  return (config);
+}
+
+PacketSizer::Config get_packet_sizer_config(rclcpp::Node * node, const std::string & camera)
+{
+  PacketSizer::Config sizerConfig;
+  double mtt, mst;
+  get_camera_parameter(node, camera, "event_message_time_threshold", &mtt, 1e-3);
+  sizerConfig.timeThreshold = uint64_t(std::abs(mtt) * 1e9);
+  int64_t mts, met;
+  get_camera_parameter(node, camera, "event_message_size_threshold", &mts, int64_t(1000000000));
+  sizerConfig.sizeThreshold = static_cast<size_t>(std::abs(mts));
+  get_camera_parameter(node, camera, "event_message_event_threshold", &met, int64_t(0));
+  sizerConfig.eventThreshold = static_cast<uint64_t>(std::abs(met));
+  get_camera_parameter(node, camera, "event_message_sensor_time_threshold", &mst, 0.0);
+  sizerConfig.sensorTimeThreshold = uint64_t(std::abs(mst) * 1e6);
+  get_camera_parameter(node, camera, "event_message_rate_min", &sizerConfig.minRate, 0.0);
+  get_camera_parameter(node, camera, "event_message_rate_max", &sizerConfig.maxRate, 0.0);
+  return (sizerConfig);
+}
+
+ReservePolicy::Config get_reserve_policy_config(rclcpp::Node * node, const std::string & camera)
+{
+  ReservePolicy::Config reserveConfig;
+  int reserveWindow;
+  int64_t reserveMaxSize;
+  get_camera_parameter(node, camera, "reserve_window", &reserveWindow, 256);
+  get_camera_parameter(node, camera, "reserve_percentile", &reserveConfig.percentile, 0.95);
+  get_camera_parameter(node, camera, "reserve_max_size", &reserveMaxSize, int64_t(0));
+  reserveConfig.window = static_cast<size_t>(std::max(reserveWindow, 1));
+  reserveConfig.maxSize = static_cast<size_t>(std::max(reserveMaxSize, int64_t(0)));
+  return (reserveConfig);
+}
+
+BiasController::Config get_bias_controller_config(rclcpp::Node * node, const std::string & camera)
+{
+  BiasController::Config config;
+  get_camera_parameter(node, camera, "bias_control_target_rate", &config.targetRate, 0.0);
+  get_camera_parameter(node, camera, "bias_control_hysteresis", &config.hysteresis, 0.2);
+  get_camera_parameter(node, camera, "bias_control_step", &config.stepFraction, 0.05);
+  get_camera_parameter(node, camera, "bias_control_interval", &config.interval, 1.0);
+  return (config);
+}
+
+void configure_wrapper(rclcpp::Node * node, const std::string & camera, MetavisionWrapper * wrapper)
+{
+  std::string sn;
+  get_camera_parameter(node, camera, "serial", &sn, std::string(""));
+  wrapper->setSerialNumber(sn);
+  double openTimeout;
+  get_camera_parameter(node, camera, "open_timeout", &openTimeout, 5.0);
+  wrapper->setOpenTimeout(openTimeout);
+  bool reconnect;
+  get_camera_parameter(node, camera, "reconnect", &reconnect, true);
+  wrapper->setReconnect(reconnect);
+  std::string fromFile;
+  get_camera_parameter(node, camera, "from_file", &fromFile, std::string(""));
+  wrapper->setFromFile(fromFile);
+  bool nativeReader;
+  get_camera_parameter(node, camera, "native_file_reader", &nativeReader, true);
+  wrapper->setUseNativeFileReader(nativeReader);
+  double fileStartTime, fileEndTime;
+  get_camera_parameter(node, camera, "from_file_start_time", &fileStartTime, -1.0);
+  get_camera_parameter(node, camera, "from_file_end_time", &fileEndTime, -1.0);
+  wrapper->setFileTimeRange(fileStartTime, fileEndTime);
+  std::string source;
+  get_camera_parameter(node, camera, "source", &source, std::string("camera"));
+  wrapper->setSourceType(source);
+  if (source == "synthetic") {
+    MetavisionWrapper::SyntheticConfig sc;
+    get_camera_parameter(node, camera, "synthetic_event_rate", &sc.eventRate, 1e6);
+    get_camera_parameter(node, camera, "synthetic_width", &sc.width, 1280);
+    get_camera_parameter(node, camera, "synthetic_height", &sc.height, 720);
+    get_camera_parameter(
+      node, camera, "synthetic_distribution", &sc.distribution, std::string("uniform"));
+    get_camera_parameter(node, camera, "synthetic_burst_period", &sc.burstPeriod, 0.0);
+    get_camera_parameter(node, camera, "synthetic_burst_duty_cycle", &sc.burstDutyCycle, 0.1);
+    get_camera_parameter(node, camera, "synthetic_burst_factor", &sc.burstFactor, 10.0);
+    get_camera_parameter(node, camera, "synthetic_packet_time", &sc.packetTime, 4e-3);
+    get_camera_parameter(node, camera, "synthetic_realtime", &sc.realtime, true);
+    wrapper->setSyntheticConfig(sc);
+  }
+  std::string syncMode;
+  get_camera_parameter(node, camera, "sync_mode", &syncMode, std::string("standalone"));
+  wrapper->setSyncMode(syncMode);
+  RCLCPP_INFO_STREAM(node->get_logger(), "sync mode: " << syncMode);
+  bool trailFilter;
+  get_camera_parameter(node, camera, "trail_filter", &trailFilter, false);
+  std::string trailFilterType;
+  get_camera_parameter(node, camera, "trail_filter_type", &trailFilterType, std::string("trail"));
+  int trailFilterThreshold;
+  get_camera_parameter(node, camera, "trail_filter_threshold", &trailFilterThreshold, 0);
+  if (trailFilter) {
+    RCLCPP_INFO_STREAM(
+      node->get_logger(), "Using tail filter in " << trailFilterType << " mode with threshold "
+                                                  << trailFilterThreshold);
+    wrapper->setTrailFilter(
+      trailFilterType, static_cast<uint32_t>(trailFilterThreshold), trailFilter);
+  }
+  std::vector<int64_t> roi_long;
+  get_camera_parameter(node, camera, "roi", &roi_long, std::vector<int64_t>());
+  std::vector<int> r(roi_long.begin(), roi_long.end());
+  if (!r.empty()) {
+    RCLCPP_INFO_STREAM(node->get_logger(), "using ROI with " << (r.size() / 4) << " rectangle(s)");
+    for (size_t i = 0; i < r.size() / 4; i += 4) {
+      RCLCPP_INFO_STREAM(
+        node->get_logger(),
+        r[4 * i] << " " << r[4 * i + 1] << " " << r[4 * i + 2] << " " << r[4 * i + 3]);
+    }
+  }
+  wrapper->setROI(r);
+  std::string tInMode;
+  get_camera_parameter(node, camera, "trigger_in_mode", &tInMode, std::string("disabled"));
+  if (tInMode != "disabled") {
+    RCLCPP_INFO_STREAM(node->get_logger(), "trigger in mode:        " << tInMode);
+  }
+  // disabled, enabled, loopback
+  wrapper->setExternalTriggerInMode(tInMode);
+  // disabled, enabled
+  std::string tOutMode;
+  get_camera_parameter(node, camera, "trigger_out_mode", &tOutMode, std::string("disabled"));
+  int64_t tOutPeriod;
+  // trigger out period in usec
+  get_camera_parameter(node, camera, "trigger_out_period", &tOutPeriod, 100000L);
+  double tOutCycle;
+  // fraction of cycle trigger HIGH
+  get_camera_parameter(node, camera, "trigger_duty_cycle", &tOutCycle, 0.5);
+  if (tOutMode != "disabled") {
+    RCLCPP_INFO_STREAM(node->get_logger(), "trigger out mode:       " << tOutMode);
+    RCLCPP_INFO_STREAM(node->get_logger(), "trigger out period:     " << tOutPeriod);
+    RCLCPP_INFO_STREAM(node->get_logger(), "trigger out duty cycle: " << tOutCycle);
+  }
+  wrapper->setExternalTriggerOutMode(tOutMode, tOutPeriod, tOutCycle);
+
+  // disabled, enabled, na
+  std::string ercMode;  // Event Rate Controller Mode
+  get_camera_parameter(node, camera, "erc_mode", &ercMode, std::string("na"));
+  int ercRate;  // Event Rate Controller Rate
+  get_camera_parameter(node, camera, "erc_rate", &ercRate, 100000000);
+  wrapper->setEventRateController(ercMode, ercRate);
+
+  if (wrapper->triggerActive()) {
+    wrapper->setHardwarePinConfig(get_hardware_pin_config(node));
+  }
+  int mipiFramePeriod{-1};
+  get_camera_parameter(node, camera, "mipi_frame_period", &mipiFramePeriod, -1);
+  wrapper->setMIPIFramePeriod(mipiFramePeriod);
+  for (const auto & thread : {"processing", "stats", "source"}) {
+    wrapper->setThreadConfig(
+      thread, get_thread_config(node, std::string(thread) + "_thread", camera));
+  }
+  std::string poolMode;
+  get_camera_parameter(node, camera, "buffer_pool_mode", &poolMode, std::string("none"));
+  int64_t poolBlockSize, poolNumBlocks, heapPrefaultSize;
+  get_camera_parameter(node, camera, "buffer_pool_block_size", &poolBlockSize, int64_t(1 << 20));
+  get_camera_parameter(node, camera, "buffer_pool_num_blocks", &poolNumBlocks, int64_t(32));
+  get_camera_parameter(node, camera, "heap_prefault_size", &heapPrefaultSize, int64_t(16 << 20));
+  wrapper->setBufferPool(
+    poolMode, static_cast<size_t>(std::max(poolBlockSize, int64_t(0))),
+    static_cast<size_t>(std::max(poolNumBlocks, int64_t(0))));
+  wrapper->setHeapPrefaultSize(static_cast<size_t>(std::max(heapPrefaultSize, int64_t(0))));
+  bool tuneHeap;
+  get_camera_parameter(node, camera, "tune_heap", &tuneHeap, false);
+  wrapper->setTuneHeap(tuneHeap);
+  int64_t timeGapThreshold;
+  get_camera_parameter(node, camera, "time_gap_threshold", &timeGapThreshold, int64_t(10000));
+  wrapper->setTimeGapThreshold(static_cast<uint64_t>(std::max(timeGapThreshold, int64_t(0))));
+}
+}  // namespace metavision_driver
@@ -0,0 +1,148 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/preview_renderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace metavision_driver
+{
+// most recent raw data decoded per call to render()
+static constexpr size_t MAX_DECODE_SIZE = 4 * 1024 * 1024;
+// don't let the raw data pile up if render() is not called often enough
+static constexpr size_t MAX_BUFFER_SIZE = 4 * MAX_DECODE_SIZE;
+// skipping keeps the decoding aligned to the largest word (evt21)
+static constexpr size_t WORD_ALIGN = 8;
+
+PreviewRenderer::PreviewRenderer(
+  const std::string & encoding, int width, int height, const std::string & mode, double decay)
+: width_(width),
+  height_(height),
+  isTimeSurface_(mode == "time_surface"),
+  decay_(static_cast<uint32_t>(std::max(decay, 1e-6) * 1e6)),
+  encoding_(encoding),
+  decoder_(make_decoder<PreviewRenderer>(encoding))
+{
+  counts_.resize(width_ * height_, 0);
+  lastTime_.resize(width_ * height_, 0);
+}
+
+void PreviewRenderer::addData(const uint8_t * start, const uint8_t * end)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!buffer_.empty() && buffer_.size() + (end - start) > MAX_BUFFER_SIZE) {
+    // render() would skip the old data anyway, keep the new data
+    skippedBytes_ += buffer_.size();
+    buffer_.clear();
+    resetOffset_ = NO_RESET;
+    restartDecoder_ = true;
+  }
+  buffer_.insert(buffer_.end(), start, end);
+}
+
+void PreviewRenderer::resetTime()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  resetOffset_ = buffer_.size();  // an earlier reset is superseded
+}
+
+bool PreviewRenderer::render(std::vector<uint8_t> * image)
+{
+  decodeBuffer_.clear();
+  size_t resetOffset = NO_RESET;
+  bool restartDecoder = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    decodeBuffer_.swap(buffer_);
+    std::swap(resetOffset, resetOffset_);
+    std::swap(restartDecoder, restartDecoder_);
+  }
+  if (decodeBuffer_.empty()) {
+    return (false);
+  }
+  const uint8_t * start = decodeBuffer_.data();
+  const uint8_t * end = start + decodeBuffer_.size();
+  size_t skip = 0;
+  if (decodeBuffer_.size() > MAX_DECODE_SIZE) {
+    skip = (decodeBuffer_.size() - MAX_DECODE_SIZE + WORD_ALIGN - 1) & ~(WORD_ALIGN - 1);
+    skippedBytes_ += skip;
+  }
+  bool resetDecoder = restartDecoder || skip != 0;
+  if (resetOffset != NO_RESET) {
+    if (resetOffset > skip) {
+      // data from before the reset still goes to the old decoder
+      decode(start + skip, start + resetOffset, resetDecoder);
+      skip = resetOffset;
+    }
+    resetDecoder = true;
+  }
+  decode(start + skip, end, resetDecoder);
+  image->resize(width_ * height_);
+  if (isTimeSurface_) {
+    renderTimeSurface(image);
+  } else {
+    renderCount(image);
+  }
+  return (true);
+}
+
+void PreviewRenderer::decode(const uint8_t * start, const uint8_t * end, bool resetDecoder)
+{
+  if (resetDecoder) {
+    decoder_ = make_decoder<PreviewRenderer>(encoding_);
+  }
+  if (start != end) {
+    decoder_->decode(start, end, this);
+  }
+}
+
+//
+// The loops below have no branches and no aliasing between input and
+// output arrays, so the compiler vectorizes them (this file is built
+// with -O3).
+//
+
+void PreviewRenderer::renderCount(std::vector<uint8_t> * image)
+{
+  const size_t n = counts_.size();
+  uint32_t * __restrict__ c = counts_.data();
+  uint8_t * __restrict__ img = image->data();
+  // a few events per pixel saturate the pixel
+  for (size_t i = 0; i < n; i++) {
+    const uint32_t v = std::min(c[i], 4U) << 6;  // clamp first, the shift could overflow
+    img[i] = static_cast<uint8_t>(v > 255 ? 255 : v);
+  }
+  memset(c, 0, n * sizeof(uint32_t));
+}
+
+void PreviewRenderer::renderTimeSurface(std::vector<uint8_t> * image)
+{
+  const size_t n = lastTime_.size();
+  const uint32_t * __restrict__ lt = lastTime_.data();
+  uint8_t * __restrict__ img = image->data();
+  const uint32_t now = static_cast<uint32_t>(decoder_->getTime());
+  const uint32_t decay = decay_;
+  // linear decay from 255 to 0 over the decay time
+  const float scale = 255.0f / static_cast<float>(decay);
+  for (size_t i = 0; i < n; i++) {
+    const uint32_t age = std::min(now - lt[i], decay);
+    img[i] = static_cast<uint8_t>(static_cast<float>(decay - age) * scale);
+  }
+  // counts are not used by the time surface, but keep them bounded
+  memset(counts_.data(), 0, counts_.size() * sizeof(uint32_t));
+}
+
+}  // namespace metavision_driver
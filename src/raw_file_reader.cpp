@@ -0,0 +1,405 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/raw_file_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "metavision_driver/evt21_utils.h"
+#include "metavision_driver/evt2_utils.h"
+#include "metavision_driver/evt3_utils.h"
+#include "metavision_driver/logging.h"
+
+namespace metavision_driver
+{
+struct IndexFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t entrySize;
+  uint64_t fileSize;
+  uint64_t dataStart;
+  uint64_t numEntries;
+};
+
+static const char INDEX_MAGIC[8] = {'M', 'V', 'D', 'R', 'V', 'I', 'D', 'X'};
+static const uint32_t INDEX_VERSION = 1;
+
+static std::string to_lower(const std::string upper)
+{
+  std::string lower(upper);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  return (lower);
+}
+
+static int get_int(const std::string & s)
+{
+  try {
+    return (std::stoi(s));
+  } catch (const std::exception &) {
+    return (0);
+  }
+}
+
+RawFileReader::RawFileReader(const std::string & loggerName, const std::string & fileName)
+: EventSource(loggerName), fileName_(fileName)
+{
+}
+
+RawFileReader::~RawFileReader()
+{
+  stop();
+  close();
+}
+
+bool RawFileReader::open()
+{
+  close();
+  fd_ = ::open(fileName_.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    LOG_ERROR_NAMED("cannot open raw file " << fileName_ << ": " << strerror(errno));
+    return (false);
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+    LOG_ERROR_NAMED("cannot get size of raw file " << fileName_);
+    close();
+    return (false);
+  }
+  fileSize_ = static_cast<size_t>(st.st_size);
+  void * p = mmap(nullptr, fileSize_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (p == MAP_FAILED) {
+    LOG_ERROR_NAMED("cannot memory map raw file " << fileName_ << ": " << strerror(errno));
+    close();
+    return (false);
+  }
+  madvise(p, fileSize_, MADV_SEQUENTIAL);
+  data_ = static_cast<const uint8_t *>(p);
+
+  if (!parseHeader()) {
+    close();
+    return (false);
+  }
+  if (encodingFormat_ == "evt3") {
+    wordSize_ = evt3::TimeHighScanner::WORD_SIZE;
+  } else if (encodingFormat_ == "evt2") {
+    wordSize_ = evt2::TimeHighScanner::WORD_SIZE;
+  } else if (encodingFormat_ == "evt21") {
+    wordSize_ = evt21::TimeHighScanner::WORD_SIZE;
+  } else {
+    LOG_WARN_NAMED("native reader does not support encoding: " << encodingFormat_);
+    close();
+    return (false);
+  }
+  const std::string indexFile = fileName_ + ".mvidx";
+  if (!loadIndex(indexFile)) {
+    buildIndex();
+    saveIndex(indexFile);
+  }
+  if (index_.empty()) {
+    LOG_ERROR_NAMED("no time stamps found in raw file " << fileName_);
+    close();
+    return (false);
+  }
+  LOG_INFO_NAMED(
+    "raw file sensor time range: " << getFirstTime() * 1e-6 << "s to " << getLastTime() * 1e-6
+                                   << "s");
+  return (true);
+}
+
+void RawFileReader::close()
+{
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), fileSize_);
+    data_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  fileSize_ = 0;
+  dataStart_ = 0;
+  index_.clear();
+}
+
+bool RawFileReader::parseHeader()
+{
+  // header lines start with '%', the last one is "% end"
+  size_t pos = 0;
+  while (pos < fileSize_ && data_[pos] == '%') {
+    const void * eol = memchr(data_ + pos, '\n', fileSize_ - pos);
+    const size_t lineEnd = eol ? static_cast<const uint8_t *>(eol) - data_ : fileSize_;
+    std::string line(reinterpret_cast<const char *>(data_ + pos), lineEnd - pos);
+    pos = std::min(lineEnd + 1, fileSize_);
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line == "% end") {
+      break;
+    }
+    std::stringstream ss(line.substr(1));
+    std::string key, value;
+    ss >> key;
+    std::getline(ss >> std::ws, value);
+    if (key == "format") {
+      // e.g. EVT3;height=720;width=1280
+      std::stringstream fs(value);
+      std::string tok;
+      std::getline(fs, tok, ';');
+      encodingFormat_ = to_lower(tok);
+      while (std::getline(fs, tok, ';')) {
+        if (tok.find("height=") == 0) {
+          height_ = get_int(tok.substr(7));
+        } else if (tok.find("width=") == 0) {
+          width_ = get_int(tok.substr(6));
+        }
+      }
+    } else if (key == "evt" && encodingFormat_ == "unknown") {
+      encodingFormat_ = value == "3.0" ? "evt3" : (value == "2.1" ? "evt21" : "evt2");
+    } else if (key == "geometry") {
+      const size_t x = value.find('x');
+      if (x != std::string::npos) {
+        width_ = get_int(value.substr(0, x));
+        height_ = get_int(value.substr(x + 1));
+      }
+    } else if (key == "Width") {
+      width_ = get_int(value);
+    } else if (key == "Height") {
+      height_ = get_int(value);
+    } else if (key == "serial_number") {
+      serialNumber_ = value;
+    } else if (key == "sensor_generation" || key == "generation") {
+      sensorVersion_ = value;
+    } else if (key == "sensor_name") {
+      sensorName_ = value;
+    }
+  }
+  dataStart_ = pos;
+  if (width_ <= 0 || height_ <= 0) {
+    LOG_WARN_NAMED("cannot find sensor geometry in header of " << fileName_);
+    return (false);
+  }
+  return (true);
+}
+
+bool RawFileReader::loadIndex(const std::string & indexFile)
+{
+  std::ifstream in(indexFile, std::ios::binary);
+  if (!in.is_open()) {
+    return (false);
+  }
+  IndexFileHeader h;
+  in.read(reinterpret_cast<char *>(&h), sizeof(h));
+  if (
+    !in || memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || h.version != INDEX_VERSION ||
+    h.entrySize != sizeof(IndexEntry) || h.fileSize != fileSize_ || h.dataStart != dataStart_) {
+    LOG_WARN_NAMED("ignoring stale or invalid index file " << indexFile);
+    return (false);
+  }
+  index_.resize(h.numEntries);
+  in.read(reinterpret_cast<char *>(index_.data()), h.numEntries * sizeof(IndexEntry));
+  if (!in) {
+    LOG_WARN_NAMED("index file " << indexFile << " is truncated!");
+    index_.clear();
+    return (false);
+  }
+  LOG_INFO_NAMED("loaded index with " << index_.size() << " entries from " << indexFile);
+  return (true);
+}
+
+void RawFileReader::buildIndex()
+{
+  LOG_INFO_NAMED("building index for " << fileName_ << ", this may take a while...");
+  const auto t0 = std::chrono::steady_clock::now();
+  index_.clear();
+  // dispatch once, the scan loop is specialized for the encoding
+  if (encodingFormat_ == "evt3") {
+    scanTimeHigh<evt3::TimeHighScanner>();
+  } else if (encodingFormat_ == "evt2") {
+    scanTimeHigh<evt2::TimeHighScanner>();
+  } else {
+    scanTimeHigh<evt21::TimeHighScanner>();
+  }
+  const double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  LOG_INFO_NAMED("built index with " << index_.size() << " entries in " << dt << "s");
+}
+
+template <class TimeHighScanner>
+void RawFileReader::scanTimeHigh()
+{
+  // EVT2 has a TIME_HIGH word every 64us, so thin out the index to
+  // the EVT3 TIME_HIGH period. This also sets the playback chunk size.
+  TimeHighScanner scanner;
+  const size_t ws = TimeHighScanner::WORD_SIZE;
+  const size_t end = dataStart_ + ((fileSize_ - dataStart_) / ws) * ws;
+  for (size_t off = dataStart_; off < end; off += ws) {
+    uint64_t t;
+    if (scanner.scan(data_ + off, &t)) {
+      // only record advances, keep index strictly monotonic for binary search
+      if (index_.empty() || t >= index_.back().time + evt3::TIME_HIGH_PERIOD) {
+        index_.push_back({t, off});
+      }
+    }
+  }
+}
+
+void RawFileReader::saveIndex(const std::string & indexFile) const
+{
+  std::ofstream out(indexFile, std::ios::binary);
+  if (!out.is_open()) {
+    LOG_WARN_NAMED("cannot write index file " << indexFile << ", will rebuild next time");
+    return;
+  }
+  IndexFileHeader h;
+  memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  h.version = INDEX_VERSION;
+  h.entrySize = sizeof(IndexEntry);
+  h.fileSize = fileSize_;
+  h.dataStart = dataStart_;
+  h.numEntries = index_.size();
+  out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  out.write(reinterpret_cast<const char *>(index_.data()), index_.size() * sizeof(IndexEntry));
+  if (!out) {
+    LOG_WARN_NAMED("failed writing index file " << indexFile);
+  }
+}
+
+size_t RawFileReader::findIndex(uint64_t sensorTime) const
+{
+  // find last entry with time <= sensorTime
+  const auto it = std::upper_bound(
+    index_.begin(), index_.end(), sensorTime,
+    [](uint64_t t, const IndexEntry & e) { return (t < e.time); });
+  return (it == index_.begin() ? 0 : (it - index_.begin()) - 1);
+}
+
+void RawFileReader::setTimeRange(int64_t startTime, int64_t endTime)
+{
+  startTime_ = startTime;
+  endTime_ = endTime;
+}
+
+bool RawFileReader::seek(uint64_t sensorTime)
+{
+  if (index_.empty()) {
+    return (false);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  nextIndex_ = findIndex(sensorTime);
+  seekRequested_ = true;
+  LOG_INFO_NAMED("seeking to sensor time " << index_[nextIndex_].time * 1e-6 << "s");
+  cv_.notify_all();
+  return (true);
+}
+
+bool RawFileReader::start(const Callback & cb)
+{
+  if (!data_ || index_.empty()) {
+    LOG_ERROR_NAMED("cannot start playback, no raw file open!");
+    return (false);
+  }
+  callback_ = cb;
+  nextIndex_ = startTime_ >= 0 ? findIndex(static_cast<uint64_t>(startTime_)) : 0;
+  keepRunning_ = true;
+  thread_ = std::make_shared<std::thread>(&RawFileReader::playbackThread, this);
+  return (true);
+}
+
+bool RawFileReader::stop()
+{
+  if (thread_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      keepRunning_ = false;
+      cv_.notify_all();
+    }
+    thread_->join();
+    thread_.reset();
+    return (true);
+  }
+  return (false);
+}
+
+void RawFileReader::playbackThread()
+{
+  // Hands out the data between consecutive TIME_HIGH changes, i.e.
+  // about 4ms worth of events, paced to play back in real time.
+  std::string report;
+  if (threadConfig_.apply("mv_playback", &report)) {
+    LOG_INFO_NAMED(report);
+  } else {
+    LOG_WARN_NAMED(report);
+  }
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point wallStart;
+  uint64_t sensorStart{0};
+  bool resetPacing{true};
+  bool atEnd{false};
+  bool isRestart{false};
+  const size_t dataEnd = dataStart_ + ((fileSize_ - dataStart_) / wordSize_) * wordSize_;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (keepRunning_) {
+    if (seekRequested_) {
+      seekRequested_ = false;
+      resetPacing = true;
+      atEnd = false;
+      isRestart = true;  // the next data does not continue the previous
+    }
+    if (
+      nextIndex_ >= index_.size() ||
+      (endTime_ >= 0 && index_[nextIndex_].time > static_cast<uint64_t>(endTime_))) {
+      if (!atEnd) {
+        LOG_INFO_NAMED("reached end of playback, waiting for seek.");
+        atEnd = true;
+      }
+      cv_.wait(lock, [this] { return (!keepRunning_ || seekRequested_); });
+      continue;
+    }
+    const size_t idx = nextIndex_++;
+    const IndexEntry & e = index_[idx];
+    // the first chunk also carries whatever precedes the first TIME_HIGH,
+    // such that playback from the start reproduces the file completely
+    const size_t begin = idx == 0 ? dataStart_ : e.offset;
+    const size_t end = idx + 1 < index_.size() ? index_[idx + 1].offset : dataEnd;
+    if (resetPacing) {
+      wallStart = Clock::now();
+      sensorStart = e.time;
+      resetPacing = false;
+    }
+    const auto due = wallStart + std::chrono::microseconds(e.time - sensorStart);
+    if (cv_.wait_until(lock, due, [this] { return (!keepRunning_ || seekRequested_); })) {
+      continue;  // stopped or seek happened while sleeping
+    }
+    lock.unlock();
+    if (isRestart && restartCallback_) {
+      restartCallback_();
+    }
+    isRestart = false;
+    callback_(data_ + begin, end - begin);
+    lock.lock();
+  }
+  LOG_INFO_NAMED("raw file playback thread exited!");
+}
+
+}  // namespace metavision_driver
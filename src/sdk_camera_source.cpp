@@ -0,0 +1,160 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/sdk_camera_source.h"
+
+#include <metavision/hal/facilities/i_hw_identification.h>
+#if METAVISION_VERSION >= 4
+#include <metavision/hal/utils/device_config.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "metavision_driver/logging.h"
+
+namespace metavision_driver
+{
+static std::string to_lower(const std::string upper)
+{
+  std::string lower(upper);
+  std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  return (lower);
+}
+
+static std::string to_upper(const std::string lower)
+{
+  std::string upper(lower);
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  return (upper);
+}
+
+SDKCameraSource::SDKCameraSource(
+  const std::string & loggerName, const std::string & serialNumber, const std::string & fromFile,
+  const std::string & encoding)
+: EventSource(loggerName), fromFile_(fromFile), requestedEncoding_(encoding)
+{
+  serialNumber_ = serialNumber;
+}
+
+SDKCameraSource::~SDKCameraSource() { stop(); }
+
+bool SDKCameraSource::open()
+{
+  // Enumeration fails for a short while after the device appears or
+  // another process releases it. Retry quickly first, then back off.
+  using Clock = std::chrono::steady_clock;
+  const std::chrono::milliseconds minDelay(5), maxDelay(500);
+  const auto t0 = Clock::now();
+  const std::string src =
+    fromFile_.empty() ? (serialNumber_.empty() ? "default" : serialNumber_) : fromFile_;
+  std::chrono::milliseconds delay(minDelay);
+  for (int attempt = 1;; attempt++) {
+    try {
+      if (!fromFile_.empty()) {
+        LOG_INFO_NAMED("reading events from file: " << fromFile_);
+        const auto cfg = Metavision::FileConfigHints().real_time_playback(true);
+        cam_ = Metavision::Camera::from_file(fromFile_, cfg);
+      } else {
+#if METAVISION_VERSION >= 4
+        // the plugin picks the data format when the device is opened
+        Metavision::DeviceConfig config;
+        if (!requestedEncoding_.empty()) {
+          config.set_format(to_upper(requestedEncoding_));
+        }
+        if (!serialNumber_.empty()) {
+          cam_ = Metavision::Camera::from_serial(serialNumber_, config);
+        } else {
+          cam_ = Metavision::Camera::from_first_available(config);
+        }
+#else
+        if (!serialNumber_.empty()) {
+          cam_ = Metavision::Camera::from_serial(serialNumber_);
+        } else {
+          cam_ = Metavision::Camera::from_first_available();
+        }
+#endif
+      }
+      const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0);
+      LOG_INFO_NAMED("opened " << src << " in " << dt.count() << "ms, attempts: " << attempt);
+      break;
+    } catch (const Metavision::CameraException & e) {
+      const auto elapsed = Clock::now() - t0;
+      if (!fromFile_.empty() || elapsed + delay > std::chrono::duration<double>(openTimeout_)) {
+        LOG_ERROR_NAMED("cannot open " << src << ", giving up: " << e.what());
+        return (false);
+      }
+      LOG_WARN_NAMED(
+        "cannot open " << src << " on attempt " << attempt << ", retrying in " << delay.count()
+                       << "ms");
+      std::this_thread::sleep_for(delay);
+      delay = std::min(delay * 2, maxDelay);
+    }
+  }
+  try {
+    using HWI = Metavision::I_HW_Identification;
+    const HWI * hwi = cam_.get_device().get_facility<HWI>();
+    const auto sinfo = hwi->get_sensor_info();
+    encodingFormat_ = to_lower(hwi->get_current_data_encoding_format());
+    sensorVersion_ =
+      std::to_string(sinfo.major_version_) + "." + std::to_string(sinfo.minor_version_);
+    sensorName_ = sinfo.name_;
+    // overwrite serial in case it was not set
+    serialNumber_ = cam_.get_camera_configuration().serial_number;
+    const auto & g = cam_.geometry();
+#if METAVISION_VERSION < 5
+    width_ = g.width();
+    height_ = g.height();
+#else
+    width_ = g.get_width();
+    height_ = g.get_height();
+#endif
+  } catch (const Metavision::CameraException & e) {
+    LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
+    return (false);
+  }
+  return (true);
+}
+
+bool SDKCameraSource::start(const Callback & cb)
+{
+  try {
+    rawDataCallbackId_ = cam_.raw_data().add_callback(cb);
+    rawDataCallbackActive_ = true;
+    // this will actually start the camera
+    cam_.start();
+  } catch (const Metavision::CameraException & e) {
+    LOG_ERROR_NAMED("unexpected sdk error: " << e.what());
+    return (false);
+  }
+  return (true);
+}
+
+bool SDKCameraSource::stop()
+{
+  bool status = false;
+  if (cam_.is_running()) {
+    cam_.stop();
+    status = true;
+  }
+  if (rawDataCallbackActive_) {
+    cam_.raw_data().remove_callback(rawDataCallbackId_);
+    rawDataCallbackActive_ = false;
+  }
+  return (status);
+}
+
+}  // namespace metavision_driver
@@ -0,0 +1,247 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace metavision_driver
+{
+using shm_ring::Header;
+using shm_ring::INVALID_SEQ;
+using shm_ring::Record;
+using shm_ring::Slot;
+
+static constexpr size_t ALIGNMENT = 64;
+
+static size_t align_up(size_t n, size_t a) { return ((n + a - 1) & ~(a - 1)); }
+
+static std::string error_string(const std::string & what, const std::string & name)
+{
+  return (what + " " + name + ": " + std::string(strerror(errno)));
+}
+
+//
+// ----------------- writer ---------------------------------
+//
+
+ShmRingWriter::~ShmRingWriter() { close(); }
+
+bool ShmRingWriter::create(
+  const std::string & name, size_t capacity, uint32_t numSlots, const std::string & encoding,
+  uint32_t width, uint32_t height, bool isBigEndian, std::string * error)
+{
+  close();
+  if (numSlots == 0 || capacity == 0 || encoding.size() >= sizeof(Header::encoding)) {
+    *error = "invalid ring parameters";
+    return (false);
+  }
+  capacity = align_up(capacity, ALIGNMENT);
+  const size_t dataOffset = align_up(sizeof(Header) + numSlots * sizeof(Slot), ALIGNMENT);
+  const size_t mapSize = dataOffset + capacity;
+  shm_unlink(name.c_str());  // remove stale ring left behind by a crash
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    *error = error_string("cannot create shared memory", name);
+    return (false);
+  }
+  if (ftruncate(fd, mapSize) != 0) {
+    *error = error_string("cannot resize shared memory", name);
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return (false);
+  }
+  void * p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);  // mapping stays valid
+  if (p == MAP_FAILED) {
+    *error = error_string("cannot map shared memory", name);
+    shm_unlink(name.c_str());
+    return (false);
+  }
+  name_ = name;
+  mapSize_ = mapSize;
+  header_ = reinterpret_cast<Header *>(p);
+  slots_ = reinterpret_cast<Slot *>(header_ + 1);
+  data_ = reinterpret_cast<uint8_t *>(p) + dataOffset;
+  for (uint32_t i = 0; i < numSlots; i++) {
+    slots_[i].seq.store(INVALID_SEQ, std::memory_order_relaxed);
+  }
+  header_->version = shm_ring::VERSION;
+  header_->capacity = capacity;
+  header_->dataOffset = dataOffset;
+  header_->numSlots = numSlots;
+  header_->width = width;
+  header_->height = height;
+  header_->isBigEndian = isBigEndian ? 1 : 0;
+  strncpy(header_->encoding, encoding.c_str(), sizeof(header_->encoding) - 1);
+  header_->writePos.store(0, std::memory_order_relaxed);
+  header_->numWritten.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = shm_ring::MAGIC;  // readers check this last
+  return (true);
+}
+
+void ShmRingWriter::close()
+{
+  if (header_) {
+    munmap(header_, mapSize_);
+    shm_unlink(name_.c_str());
+    header_ = nullptr;
+    slots_ = nullptr;
+    data_ = nullptr;
+  }
+}
+
+bool ShmRingWriter::write(const Record & rec, const uint8_t * data)
+{
+  const uint64_t capacity = header_->capacity;
+  const uint64_t alignedSize = align_up(rec.size, ALIGNMENT);
+  if (alignedSize > capacity) {
+    return (false);
+  }
+  uint64_t pos = header_->writePos.load(std::memory_order_relaxed);
+  const uint64_t offset = pos % capacity;
+  if (offset + alignedSize > capacity) {
+    pos += capacity - offset;  // data must be contiguous, skip to start of ring
+  }
+  Slot & slot = slots_[rec.seq % header_->numSlots];
+  slot.seq.store(INVALID_SEQ, std::memory_order_relaxed);
+  // announce the region about to be overwritten before touching it
+  header_->writePos.store(pos + alignedSize, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(data_ + pos % capacity, data, rec.size);
+  slot.pos = pos;
+  slot.size = rec.size;
+  slot.stamp = rec.stamp;
+  slot.timeBase = rec.timeBase;
+  slot.firstEventTime = rec.firstEventTime;
+  slot.lastEventTime = rec.lastEventTime;
+  slot.numEvents = rec.numEvents;
+  slot.seq.store(rec.seq, std::memory_order_release);
+  header_->numWritten.fetch_add(1, std::memory_order_release);
+  return (true);
+}
+
+//
+// ----------------- reader ---------------------------------
+//
+
+ShmRingReader::~ShmRingReader() { close(); }
+
+bool ShmRingReader::open(const std::string & name, std::string * error)
+{
+  close();
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    *error = error_string("cannot open shared memory", name);
+    return (false);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    *error = "shared memory " + name + " is too small";
+    ::close(fd);
+    return (false);
+  }
+  const size_t mapSize = st.st_size;
+  void * p = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    *error = error_string("cannot map shared memory", name);
+    return (false);
+  }
+  const Header * h = reinterpret_cast<const Header *>(p);
+  if (h->magic != shm_ring::MAGIC || h->version != shm_ring::VERSION) {
+    *error = "shared memory " + name + " is not a ring of version " +
+             std::to_string(shm_ring::VERSION) + " (or not initialized yet)";
+    munmap(p, mapSize);
+    return (false);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (h->dataOffset + h->capacity > mapSize) {
+    *error = "shared memory " + name + " has inconsistent size";
+    munmap(p, mapSize);
+    return (false);
+  }
+  header_ = h;
+  slots_ = reinterpret_cast<const Slot *>(h + 1);
+  data_ = reinterpret_cast<const uint8_t *>(p) + h->dataOffset;
+  mapSize_ = mapSize;
+  return (true);
+}
+
+void ShmRingReader::close()
+{
+  if (header_) {
+    munmap(const_cast<Header *>(header_), mapSize_);
+    header_ = nullptr;
+    slots_ = nullptr;
+    data_ = nullptr;
+  }
+}
+
+const uint8_t * ShmRingReader::get(uint64_t seq, Record * rec) const
+{
+  const Slot & slot = slots_[seq % header_->numSlots];
+  if (slot.seq.load(std::memory_order_acquire) != seq) {
+    return (nullptr);  // not written yet or slot reused
+  }
+  rec->seq = seq;
+  rec->pos = slot.pos;
+  rec->size = slot.size;
+  rec->stamp = slot.stamp;
+  rec->timeBase = slot.timeBase;
+  rec->firstEventTime = slot.firstEventTime;
+  rec->lastEventTime = slot.lastEventTime;
+  rec->numEvents = slot.numEvents;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.seq.load(std::memory_order_relaxed) != seq || !isValid(*rec)) {
+    return (nullptr);  // overwritten while reading the slot
+  }
+  return (data_ + rec->pos % header_->capacity);
+}
+
+bool ShmRingReader::isValid(const Record & rec) const
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return (header_->writePos.load(std::memory_order_relaxed) - rec.pos <= header_->capacity);
+}
+
+bool ShmRingReader::read(uint64_t seq, Record * rec, std::vector<uint8_t> * data) const
+{
+  const uint8_t * p = get(seq, rec);
+  if (!p) {
+    return (false);
+  }
+  data->assign(p, p + rec->size);
+  return (isValid(*rec));
+}
+
+uint64_t ShmRingReader::getNumWritten() const
+{
+  return (header_->numWritten.load(std::memory_order_acquire));
+}
+
+std::string ShmRingReader::getEncoding() const
+{
+  return (std::string(header_->encoding, strnlen(header_->encoding, sizeof(header_->encoding))));
+}
+
+}  // namespace metavision_driver
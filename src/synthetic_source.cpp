@@ -0,0 +1,191 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/synthetic_source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "metavision_driver/evt3_utils.h"
+#include "metavision_driver/logging.h"
+#include "metavision_driver/resize_hack.h"
+
+namespace metavision_driver
+{
+SyntheticEventGenerator::SyntheticEventGenerator(const Config & config) : config_(config) {}
+
+double SyntheticEventGenerator::getRate(uint64_t t) const
+{
+  if (config_.burstPeriod <= 0) {
+    return (config_.eventRate);
+  }
+  const double phase = std::fmod(t * 1e-6, config_.burstPeriod) / config_.burstPeriod;
+  return (
+    phase < config_.burstDutyCycle ? config_.eventRate * config_.burstFactor : config_.eventRate);
+}
+
+void SyntheticEventGenerator::pickPixel(uint16_t * x, uint16_t * y)
+{
+  const int w = config_.width;
+  const int h = config_.height;
+  if (config_.distribution == "gaussian") {
+    // Irwin-Hall approximation: sum of 4 uniforms has variance 1/3
+    const double sigma = w / 8.0;
+    while (true) {
+      const double zx = (uniform() + uniform() + uniform() + uniform() - 2.0) * std::sqrt(3.0);
+      const double zy = (uniform() + uniform() + uniform() + uniform() - 2.0) * std::sqrt(3.0);
+      const int ix = static_cast<int>(w * 0.5 + zx * sigma);
+      const int iy = static_cast<int>(h * 0.5 + zy * sigma);
+      if (ix >= 0 && ix < w && iy >= 0 && iy < h) {
+        *x = static_cast<uint16_t>(ix);
+        *y = static_cast<uint16_t>(iy);
+        return;
+      }
+    }
+  }
+  *x = static_cast<uint16_t>(random() % w);
+  *y = static_cast<uint16_t>(random() % h);
+}
+
+size_t SyntheticEventGenerator::generate(uint64_t dt, std::vector<uint8_t> * buf)
+{
+  const double numEv = getRate(time_ + dt / 2) * dt * 1e-6 + eventDebt_;
+  const size_t n = static_cast<size_t>(numEv);
+  eventDebt_ = numEv - n;
+  // worst case is 4 words per event plus one keep-alive TIME_HIGH
+  const size_t oldSize = buf->size();
+  resize_hack(*buf, oldSize + (4 * n + 1) * sizeof(uint16_t));
+  uint16_t * p = reinterpret_cast<uint16_t *>(buf->data() + oldSize);
+  const uint16_t * pStart = p;
+  for (size_t i = 0; i < n; i++) {
+    // spread the events evenly across the time slice
+    const uint64_t t = time_ + (i * dt) / n;
+    const uint64_t th = t >> evt3::TIME_LOW_BITS;
+    if (th != lastTimeHigh_) {
+      *p++ = (evt3::TIME_HIGH << 12) | (th & 0x0FFF);
+      lastTimeHigh_ = th;
+    }
+    if (t != lastTime_) {
+      *p++ = (evt3::TIME_LOW << 12) | (t & 0x0FFF);
+      lastTime_ = t;
+    }
+    uint16_t x, y;
+    pickPixel(&x, &y);
+    if (y != lastY_) {
+      *p++ = (evt3::ADDR_Y << 12) | (y & 0x07FF);
+      lastY_ = y;
+    }
+    const uint16_t polarity = random() & 0x1;
+    *p++ = (evt3::ADDR_X << 12) | (polarity << 11) | (x & 0x07FF);
+  }
+  time_ += dt;
+  // keep-alive so the receiver sees time advance even without events
+  const uint64_t th = time_ >> evt3::TIME_LOW_BITS;
+  if (th != lastTimeHigh_) {
+    *p++ = (evt3::TIME_HIGH << 12) | (th & 0x0FFF);
+    lastTimeHigh_ = th;
+  }
+  buf->resize(oldSize + (p - pStart) * sizeof(uint16_t));
+  return (n);
+}
+
+SyntheticSource::SyntheticSource(
+  const std::string & loggerName, const SyntheticEventGenerator::Config & config)
+: EventSource(loggerName), generator_(config)
+{
+}
+
+SyntheticSource::~SyntheticSource() { stop(); }
+
+bool SyntheticSource::open()
+{
+  const auto & cfg = generator_.getConfig();
+  if (cfg.width <= 0 || cfg.height <= 0 || cfg.width > 2048 || cfg.height > 2048) {
+    LOG_ERROR_NAMED("invalid synthetic sensor size: " << cfg.width << "x" << cfg.height);
+    return (false);
+  }
+  if (cfg.packetTime <= 0) {
+    LOG_ERROR_NAMED("synthetic packet time must be positive!");
+    return (false);
+  }
+  if (cfg.distribution != "uniform" && cfg.distribution != "gaussian") {
+    LOG_WARN_NAMED("unknown distribution " << cfg.distribution << ", using uniform");
+  }
+  width_ = cfg.width;
+  height_ = cfg.height;
+  encodingFormat_ = "evt3";
+  serialNumber_ = "synthetic";
+  sensorName_ = "synthetic";
+  LOG_INFO_NAMED(
+    "synthetic source: " << width_ << "x" << height_ << " rate: " << cfg.eventRate * 1e-6
+                         << " Mev/s distribution: " << cfg.distribution);
+  return (true);
+}
+
+bool SyntheticSource::start(const Callback & cb)
+{
+  callback_ = cb;
+  keepRunning_ = true;
+  thread_ = std::make_shared<std::thread>(&SyntheticSource::generatorThread, this);
+  return (true);
+}
+
+bool SyntheticSource::stop()
+{
+  if (!thread_) {
+    return (false);
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    keepRunning_ = false;
+    cv_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+  return (true);
+}
+
+void SyntheticSource::generatorThread()
+{
+  std::string report;
+  if (threadConfig_.apply("mv_synthetic", &report)) {
+    LOG_INFO_NAMED(report);
+  } else {
+    LOG_WARN_NAMED(report);
+  }
+  const auto & cfg = generator_.getConfig();
+  const uint64_t dt = std::max(static_cast<uint64_t>(cfg.packetTime * 1e6), uint64_t(1));
+  const auto t0 = std::chrono::steady_clock::now();
+  const uint64_t sensorT0 = generator_.getTime();
+  std::vector<uint8_t> buf;
+  while (true) {
+    buf.clear();
+    generator_.generate(dt, &buf);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (cfg.realtime) {
+        const auto tw = t0 + std::chrono::microseconds(generator_.getTime() - sensorT0);
+        cv_.wait_until(lock, tw, [this] { return (!keepRunning_); });
+      }
+      if (!keepRunning_) {
+        break;
+      }
+    }
+    callback_(buf.data(), buf.size());
+  }
+}
+
+}  // namespace metavision_driver
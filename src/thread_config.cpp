@@ -0,0 +1,86 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metavision_driver/thread_config.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+namespace metavision_driver
+{
+static const std::map<std::string, int> policyMap = {
+  {"other", SCHED_OTHER}, {"fifo", SCHED_FIFO}, {"rr", SCHED_RR}};
+
+bool ThreadConfig::apply(const std::string & name, std::string * report) const
+{
+  std::stringstream ss;
+  bool status = true;
+  const pthread_t self = pthread_self();
+  const std::string shortName = name.substr(0, 15);  // kernel limit
+  ss << "thread " << shortName;
+  int rc = pthread_setname_np(self, shortName.c_str());
+  if (rc != 0) {
+    ss << " (cannot set name: " << strerror(rc) << ")";
+  }
+  if (!cpus.empty()) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (const auto c : cpus) {
+      if (c >= 0 && c < CPU_SETSIZE) {
+        CPU_SET(c, &cpuSet);
+      }
+    }
+    rc = pthread_setaffinity_np(self, sizeof(cpuSet), &cpuSet);
+    if (rc != 0) {
+      ss << " cpus: cannot pin (" << strerror(rc) << ")";
+      status = false;
+    } else {
+      ss << " cpus:";
+      for (const auto c : cpus) {
+        ss << " " << c;
+      }
+    }
+  }
+  const auto it = policyMap.find(policy);
+  if (it == policyMap.end()) {
+    ss << " invalid policy: " << policy;
+    status = false;
+  } else if (it->second != SCHED_OTHER) {
+    sched_param sp;
+    const int pmin = sched_get_priority_min(it->second);
+    const int pmax = sched_get_priority_max(it->second);
+    sp.sched_priority = std::max(pmin, std::min(pmax, priority));
+    rc = pthread_setschedparam(self, it->second, &sp);
+    if (rc == 0) {
+      ss << " policy: " << policy << " priority: " << sp.sched_priority;
+    } else {
+      // typically EPERM when running without CAP_SYS_NICE or rtprio limits
+      ss << " policy: other (cannot set " << policy << ": " << strerror(rc) << ")";
+      status = false;
+    }
+  } else {
+    ss << " policy: other";
+  }
+  *report = ss.str();
+  return (status);
+}
+
+}  // namespace metavision_driver
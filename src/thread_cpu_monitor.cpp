@@ -0,0 +1,107 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "metavision_driver/thread_cpu_monitor.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace metavision_driver
+{
+static pid_t current_tid() { return (static_cast<pid_t>(syscall(SYS_gettid))); }
+
+void ThreadCpuMonitor::registerThread(const std::string & name)
+{
+  Entry e;
+  e.name = name;
+  e.tid = current_tid();
+  if (pthread_getcpuclockid(pthread_self(), &e.clock) != 0) {
+    e.clock = CLOCK_THREAD_CPUTIME_ID;  // only valid for the caller, will be dropped
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  threads_.erase(
+    std::remove_if(
+      threads_.begin(), threads_.end(), [&name](const Entry & t) { return (t.name == name); }),
+    threads_.end());
+  threads_.push_back(e);
+}
+
+void ThreadCpuMonitor::unregisterThread()
+{
+  const pid_t tid = current_tid();
+  std::unique_lock<std::mutex> lock(mutex_);
+  threads_.erase(
+    std::remove_if(
+      threads_.begin(), threads_.end(), [tid](const Entry & t) { return (t.tid == tid); }),
+    threads_.end());
+}
+
+bool ThreadCpuMonitor::readSwitches(pid_t tid, uint64_t * voluntary, uint64_t * involuntary)
+{
+  std::ifstream f("/proc/self/task/" + std::to_string(tid) + "/status");
+  if (!f.is_open()) {
+    return (false);
+  }
+  int numFound = 0;
+  std::string key;
+  while (numFound < 2 && (f >> key)) {
+    if (key == "voluntary_ctxt_switches:") {
+      f >> *voluntary;
+      numFound++;
+    } else if (key == "nonvoluntary_ctxt_switches:") {
+      f >> *involuntary;
+      numFound++;
+    }
+  }
+  return (numFound == 2);
+}
+
+std::vector<ThreadCpuMonitor::Usage> ThreadCpuMonitor::sample()
+{
+  std::vector<Usage> usage;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto now = std::chrono::steady_clock::now();
+  const double dt = std::chrono::duration<double>(now - lastSampleTime_).count();
+  lastSampleTime_ = now;
+  for (auto it = threads_.begin(); it != threads_.end();) {
+    struct timespec ts;
+    uint64_t vcs(0), ics(0);
+    if (
+      it->clock == CLOCK_THREAD_CPUTIME_ID || clock_gettime(it->clock, &ts) != 0 ||
+      !readSwitches(it->tid, &vcs, &ics)) {
+      it = threads_.erase(it);  // thread has exited without unregistering
+      continue;
+    }
+    const uint64_t cpuTime = static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    if (!it->isFirst && dt > 0) {
+      Usage u;
+      u.name = it->name;
+      u.cpuLoad = 1e-7 * (cpuTime - it->cpuTime) / dt;
+      u.voluntarySwitchRate = (vcs - it->voluntarySwitches) / dt;
+      u.involuntarySwitchRate = (ics - it->involuntarySwitches) / dt;
+      usage.push_back(u);
+    }
+    it->cpuTime = cpuTime;
+    it->voluntarySwitches = vcs;
+    it->involuntarySwitches = ics;
+    it->isFirst = false;
+    ++it;
+  }
+  return (usage);
+}
+}  // namespace metavision_driver
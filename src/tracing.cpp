@@ -0,0 +1,155 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "metavision_driver/tracing.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace metavision_driver
+{
+std::atomic<bool> Tracer::enabled_{false};
+std::mutex Tracer::registryMutex_;
+std::vector<std::shared_ptr<Tracer::ThreadBuffer>> Tracer::registry_;
+size_t Tracer::bufferSize_{1 << 16};
+
+bool Tracer::isCompiledIn()
+{
+#ifdef METAVISION_DRIVER_TRACING
+  return (true);
+#else
+  return (false);
+#endif
+}
+
+void Tracer::setBufferSize(size_t numRecords)
+{
+  std::unique_lock<std::mutex> lock(registryMutex_);
+  bufferSize_ = std::max(numRecords, size_t(1));
+}
+
+Tracer::ThreadBuffer * Tracer::registerThread()
+{
+  std::unique_lock<std::mutex> lock(registryMutex_);
+  auto b = std::make_shared<ThreadBuffer>(bufferSize_);
+  b->tid = static_cast<int>(syscall(SYS_gettid));
+  char name[16];  // kernel limit
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+    b->threadName = name;
+  }
+  registry_.push_back(b);
+  return (b.get());
+}
+
+bool Tracer::enable(bool enable, const std::string & fileName, std::string * msg)
+{
+  if (enable && !isCompiledIn()) {
+    *msg = "tracing not compiled in, build with -DENABLE_TRACING=ON";
+    return (false);
+  }
+  const bool wasEnabled = enabled_.exchange(enable);
+  if (wasEnabled && !enable) {
+    return (dump(fileName, msg));
+  }
+  *msg = enable ? "tracing enabled" : "tracing disabled";
+  return (true);
+}
+
+// escape the few characters that can show up in thread names
+static std::string json_escape(const std::string & s)
+{
+  std::string e;
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      e.push_back('\\');
+      e.push_back(c);
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      e.push_back(c);
+    }
+  }
+  return (e);
+}
+
+// Chrome trace event format, time stamps and durations are in usec
+static const char * threadNameFormat =
+  "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+  "\"args\": {\"name\": \"%s\"}}";
+static const char * instantFormat =
+  "%s{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": %d, "
+  "\"tid\": %d, \"args\": {\"arg\": %llu}}";
+static const char * completeFormat =
+  "%s{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, "
+  "\"tid\": %d, \"args\": {\"arg\": %llu}}";
+
+bool Tracer::dump(const std::string & fileName, std::string * msg)
+{
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::unique_lock<std::mutex> lock(registryMutex_);
+    buffers = registry_;
+  }
+  FILE * f = fopen(fileName.c_str(), "w");
+  if (!f) {
+    *msg = "cannot open trace file " + fileName + ": " + strerror(errno);
+    return (false);
+  }
+  const int pid = static_cast<int>(getpid());
+  size_t numRecords(0), numLost(0);
+  fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  const char * sep = "";
+  for (const auto & b : buffers) {
+    const uint64_t n = b->records.size();
+    // copy first, then check which records were overwritten while copying
+    const uint64_t head = b->head.load(std::memory_order_acquire);
+    const uint64_t first = head > n ? head - n : 0;
+    std::vector<Record> records(head - first);
+    for (uint64_t i = first; i < head; i++) {
+      records[i - first] = b->records[i % n];
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t headAfter = b->head.load(std::memory_order_relaxed);
+    // the writer may be filling slot headAfter % n right now
+    const uint64_t valid = headAfter + 1 > n ? headAfter + 1 - n : 0;
+    numLost += first;
+    fprintf(f, threadNameFormat, sep, pid, b->tid, json_escape(b->threadName).c_str());
+    sep = ",\n";
+    for (uint64_t i = std::max(first, valid); i < head; i++) {
+      const Record & r = records[i - first];
+      const unsigned long long arg = r.arg;  // NOLINT
+      if (r.duration == 0) {
+        fprintf(f, instantFormat, sep, r.name, 1e-3 * r.start, pid, b->tid, arg);
+      } else {
+        fprintf(
+          f, completeFormat, sep, r.name, 1e-3 * r.start, 1e-3 * r.duration, pid, b->tid, arg);
+      }
+      numRecords++;
+    }
+    numLost += std::max(first, valid) - first;
+  }
+  fprintf(f, "\n]}\n");
+  const bool ok = (fclose(f) == 0);
+  *msg = "wrote " + std::to_string(numRecords) + " trace records from " +
+         std::to_string(buffers.size()) + " threads to " + fileName;
+  if (numLost != 0) {
+    *msg += " (" + std::to_string(numLost) + " older records overwritten)";
+  }
+  return (ok);
+}
+}  // namespace metavision_driver
@@ -0,0 +1,94 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METAVISION_DRIVER__TEST__RAW_WORDS_H_
+#define METAVISION_DRIVER__TEST__RAW_WORDS_H_
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+
+// helpers to build raw data word by word for the unit tests
+namespace metavision_driver
+{
+namespace test
+{
+struct Event
+{
+  uint64_t t;
+  uint16_t x;
+  uint16_t y;
+  uint8_t p;
+};
+
+// collects whatever the decoder emits
+struct Collector
+{
+  void eventCD(uint64_t t, uint16_t x, uint16_t y, uint8_t p) { events.push_back({t, x, y, p}); }
+  void eventExtTrigger(uint64_t t, uint8_t id, uint8_t p) { triggers.push_back({t, id, 0, p}); }
+  std::vector<Event> events;
+  std::vector<Event> triggers;  // id goes into x
+};
+
+// little endian raw data from a sequence of words
+template <class Word>
+std::vector<uint8_t> toBytes(const std::vector<Word> & words)
+{
+  std::vector<uint8_t> bytes(words.size() * sizeof(Word));
+  memcpy(bytes.data(), words.data(), bytes.size());
+  return (bytes);
+}
+
+template <class Word>
+void decode(const std::string & encoding, const std::vector<Word> & words, Collector * c)
+{
+  auto decoder = make_decoder<Collector>(encoding);
+  ASSERT_TRUE(decoder);
+  const auto bytes = toBytes(words);
+  decoder->decode(bytes.data(), bytes.data() + bytes.size(), c);
+}
+
+// ------------ EVT3 words
+inline uint16_t e3TimeHigh(uint16_t t) { return (0x8000 | (t & 0x0FFF)); }
+inline uint16_t e3TimeLow(uint16_t t) { return (0x6000 | (t & 0x0FFF)); }
+inline uint16_t e3AddrY(uint16_t y) { return (0x0000 | y); }
+inline uint16_t e3AddrX(uint16_t x, uint8_t p) { return (0x2000 | (p << 11) | x); }
+inline uint16_t e3VectBaseX(uint16_t x, uint8_t p) { return (0x3000 | (p << 11) | x); }
+inline uint16_t e3Vect12(uint16_t m) { return (0x4000 | (m & 0x0FFF)); }
+inline uint16_t e3Vect8(uint16_t m) { return (0x5000 | (m & 0x00FF)); }
+inline uint16_t e3Trigger(uint8_t id, uint8_t p) { return (0xA000 | (id << 8) | p); }
+
+// ------------ EVT2 words, the upper half of EVT2.1 words has the same layout
+inline uint32_t e2TimeHigh(uint32_t t) { return ((0x8U << 28) | (t & 0x0FFFFFFF)); }
+inline uint32_t e2CD(uint8_t p, uint8_t tl, uint16_t x, uint16_t y)
+{
+  return ((static_cast<uint32_t>(p) << 28) | (tl << 22) | (x << 11) | y);
+}
+inline uint32_t e2Trigger(uint8_t tl, uint8_t id, uint8_t p)
+{
+  return ((0xAU << 28) | (tl << 22) | (id << 8) | p);
+}
+inline uint64_t e21Word(uint32_t upper, uint32_t mask)
+{
+  return ((static_cast<uint64_t>(upper) << 32) | mask);
+}
+}  // namespace test
+}  // namespace metavision_driver
+#endif  // METAVISION_DRIVER__TEST__RAW_WORDS_H_
@@ -0,0 +1,123 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "metavision_driver/bias_controller.h"
+
+using metavision_driver::BiasController;
+using Biases = std::map<std::string, int>;
+
+namespace
+{
+// Gen4.1 ranges: diff_on [95, 140], diff_off [25, 65], fo [45, 110],
+// which with the default step fraction gives steps of 2, 2 and 3
+const Biases baseline = {{"bias_diff_on", 120}, {"bias_diff_off", 40}, {"bias_fo", 80}};
+
+class BiasControllerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    BiasController::Config config;
+    config.targetRate = 1000;
+    controller_.setConfig(config);
+    controller_.initialize("4.1", baseline);
+  }
+  // one update with the rate far above the target
+  Biases updateHigh(const Biases & current)
+  {
+    controller_.addEvents(1000000000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return (controller_.update(current));
+  }
+  // one update without any events
+  Biases updateLow(const Biases & current)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return (controller_.update(current));
+  }
+  BiasController controller_;
+};
+}  // namespace
+
+TEST_F(BiasControllerTest, Initialize)
+{
+  EXPECT_TRUE(controller_.isEnabled());
+  EXPECT_EQ(controller_.getState(), BiasController::HOLDING);
+  EXPECT_EQ(controller_.getBaseline(), baseline);
+  EXPECT_EQ(controller_.getControlledBiases().size(), 3U);
+}
+
+TEST_F(BiasControllerTest, ReducesContrastFirst)
+{
+  const Biases changes = updateHigh(baseline);
+  EXPECT_EQ(controller_.getState(), BiasController::REDUCING);
+  EXPECT_EQ(changes, Biases({{"bias_diff_on", 122}, {"bias_diff_off", 42}}));
+}
+
+TEST_F(BiasControllerTest, ReducesBandwidthAtContrastLimits)
+{
+  const Biases current = {{"bias_diff_on", 140}, {"bias_diff_off", 65}, {"bias_fo", 80}};
+  EXPECT_EQ(updateHigh(current), Biases({{"bias_fo", 77}}));
+  EXPECT_EQ(controller_.getState(), BiasController::REDUCING);
+}
+
+TEST_F(BiasControllerTest, Saturates)
+{
+  const Biases current = {{"bias_diff_on", 140}, {"bias_diff_off", 65}, {"bias_fo", 45}};
+  EXPECT_TRUE(updateHigh(current).empty());
+  EXPECT_EQ(controller_.getState(), BiasController::SATURATED);
+}
+
+TEST_F(BiasControllerTest, RestoresBandwidthFirstAndStopsAtBaseline)
+{
+  Biases current = {{"bias_diff_on", 140}, {"bias_diff_off", 65}, {"bias_fo", 77}};
+  Biases changes = updateLow(current);
+  EXPECT_EQ(changes, Biases({{"bias_fo", 80}}));
+  EXPECT_EQ(controller_.getState(), BiasController::RESTORING);
+  current["bias_fo"] = 80;
+  changes = updateLow(current);
+  EXPECT_EQ(changes, Biases({{"bias_diff_on", 138}, {"bias_diff_off", 63}}));
+  // never more sensitive than the baseline
+  EXPECT_TRUE(updateLow(baseline).empty());
+  EXPECT_EQ(controller_.getState(), BiasController::HOLDING);
+  current = {{"bias_diff_on", 121}, {"bias_diff_off", 40}, {"bias_fo", 80}};
+  EXPECT_EQ(updateLow(current), Biases({{"bias_diff_on", 120}}));
+}
+
+TEST(BiasController, UnknownSensorIsDisabled)
+{
+  BiasController controller;
+  BiasController::Config config;
+  config.targetRate = 1000;
+  controller.setConfig(config);
+  controller.initialize("unknown", baseline);
+  EXPECT_FALSE(controller.isEnabled());
+  EXPECT_EQ(controller.getState(), BiasController::DISABLED);
+  controller.addEvents(1000000000);
+  EXPECT_TRUE(controller.update(baseline).empty());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,92 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+#include "raw_words.h"
+
+using metavision_driver::make_decoder;
+using namespace metavision_driver::test;  // NOLINT
+
+TEST(Evt2Decoder, DecodesEventsAndTriggers)
+{
+  Collector c;
+  decode<uint32_t>(
+    "evt2",
+    {e2CD(1, 0, 3, 4), e2TimeHigh(0x12345), e2CD(1, 7, 640, 480), e2CD(0, 8, 1, 2),
+     e2Trigger(9, 5, 0)},
+    &c);
+  ASSERT_EQ(c.events.size(), 2U);  // first one has no time yet
+  EXPECT_EQ(c.events[0].t, (0x12345ULL << 6) | 7);
+  EXPECT_EQ(c.events[0].x, 640);
+  EXPECT_EQ(c.events[0].y, 480);
+  EXPECT_EQ(c.events[0].p, 1);
+  EXPECT_EQ(c.events[1].t, (0x12345ULL << 6) | 8);
+  EXPECT_EQ(c.events[1].p, 0);
+  ASSERT_EQ(c.triggers.size(), 1U);
+  EXPECT_EQ(c.triggers[0].t, (0x12345ULL << 6) | 9);
+  EXPECT_EQ(c.triggers[0].x, 5);
+  EXPECT_EQ(c.triggers[0].p, 0);
+}
+
+TEST(Evt2Decoder, TimeHighRollover)
+{
+  Collector c;
+  decode<uint32_t>(
+    "evt2", {e2TimeHigh(0x0FFFFFFF), e2CD(0, 1, 0, 0), e2TimeHigh(0), e2CD(0, 1, 0, 0)}, &c);
+  ASSERT_EQ(c.events.size(), 2U);
+  EXPECT_EQ(c.events[0].t, (0x0FFFFFFFULL << 6) | 1);
+  EXPECT_EQ(c.events[1].t, (1ULL << 34) | 1);
+}
+
+TEST(Evt21Decoder, ExpandsPixelMask)
+{
+  Collector c;
+  decode<uint64_t>(
+    "evt21",
+    {e21Word(e2TimeHigh(0x42), 0), e21Word(e2CD(1, 3, 32, 10), 0x80000003),
+     e21Word(e2CD(0, 4, 64, 11), 0x1)},
+    &c);
+  ASSERT_EQ(c.events.size(), 4U);
+  const uint64_t t = 0x42ULL << 6;
+  EXPECT_EQ(c.events[0].x, 32);
+  EXPECT_EQ(c.events[1].x, 33);
+  EXPECT_EQ(c.events[2].x, 63);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(c.events[i].t, t | 3);
+    EXPECT_EQ(c.events[i].y, 10);
+    EXPECT_EQ(c.events[i].p, 1);
+  }
+  EXPECT_EQ(c.events[3].x, 64);
+  EXPECT_EQ(c.events[3].p, 0);
+  EXPECT_EQ(c.events[3].t, t | 4);
+}
+
+TEST(DecoderFactory, UnsupportedEncoding)
+{
+  EXPECT_FALSE(make_decoder<Collector>("evt4"));
+  EXPECT_FALSE(metavision_driver::is_supported_encoding("evt4"));
+  EXPECT_TRUE(metavision_driver::is_supported_encoding("evt21"));
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
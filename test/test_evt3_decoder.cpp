@@ -0,0 +1,114 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "metavision_driver/decoder_factory.h"
+#include "raw_words.h"
+
+using metavision_driver::make_decoder;
+using namespace metavision_driver::test;  // NOLINT
+
+TEST(Evt3Decoder, IgnoresEventsBeforeFirstTimeHigh)
+{
+  Collector c;
+  decode<uint16_t>("evt3", {e3AddrY(5), e3AddrX(7, 1), e3Trigger(0, 1)}, &c);
+  EXPECT_TRUE(c.events.empty());
+  EXPECT_TRUE(c.triggers.empty());
+}
+
+TEST(Evt3Decoder, DecodesSingleEvents)
+{
+  Collector c;
+  decode<uint16_t>(
+    "evt3",
+    {e3TimeHigh(0x123), e3TimeLow(0x456), e3AddrY(5), e3AddrX(7, 1), e3AddrX(8, 0),
+     e3Trigger(3, 1)},
+    &c);
+  ASSERT_EQ(c.events.size(), 2U);
+  const uint64_t t = (0x123ULL << 12) | 0x456;
+  EXPECT_EQ(c.events[0].t, t);
+  EXPECT_EQ(c.events[0].x, 7);
+  EXPECT_EQ(c.events[0].y, 5);
+  EXPECT_EQ(c.events[0].p, 1);
+  EXPECT_EQ(c.events[1].x, 8);
+  EXPECT_EQ(c.events[1].p, 0);
+  ASSERT_EQ(c.triggers.size(), 1U);
+  EXPECT_EQ(c.triggers[0].t, t);
+  EXPECT_EQ(c.triggers[0].x, 3);
+  EXPECT_EQ(c.triggers[0].p, 1);
+}
+
+TEST(Evt3Decoder, DecodesVectorWords)
+{
+  Collector c;
+  // 12 bit vector at x = 100, then an 8 bit vector continues at x = 112
+  decode<uint16_t>(
+    "evt3",
+    {e3TimeHigh(1), e3AddrY(9), e3VectBaseX(100, 1), e3Vect12(0x805), e3Vect8(0x81)}, &c);
+  const std::vector<uint16_t> expected = {100, 102, 111, 112, 119};
+  ASSERT_EQ(c.events.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(c.events[i].x, expected[i]);
+    EXPECT_EQ(c.events[i].y, 9);
+    EXPECT_EQ(c.events[i].p, 1);
+    EXPECT_EQ(c.events[i].t, 1ULL << 12);
+  }
+}
+
+TEST(Evt3Decoder, StateCarriesAcrossBuffers)
+{
+  Collector c;
+  auto decoder = make_decoder<Collector>("evt3");
+  const auto b1 = toBytes<uint16_t>({e3TimeHigh(2), e3AddrY(4)});
+  // odd number of bytes: the trailing byte is not decoded
+  auto b2 = toBytes<uint16_t>({e3AddrX(6, 0)});
+  b2.push_back(0xFF);
+  decoder->decode(b1.data(), b1.data() + b1.size(), &c);
+  decoder->decode(b2.data(), b2.data() + b2.size(), &c);
+  ASSERT_EQ(c.events.size(), 1U);
+  EXPECT_EQ(c.events[0].t, 2ULL << 12);
+  EXPECT_EQ(c.events[0].y, 4);
+  EXPECT_TRUE(decoder->hasValidTime());
+  EXPECT_EQ(decoder->getTime(), 2ULL << 12);
+}
+
+TEST(Evt3Decoder, TimeHighRollover)
+{
+  Collector c;
+  decode<uint16_t>(
+    "evt3", {e3TimeHigh(0xFFF), e3AddrX(1, 0), e3TimeHigh(0x000), e3AddrX(2, 0)}, &c);
+  ASSERT_EQ(c.events.size(), 2U);
+  EXPECT_EQ(c.events[0].t, 0xFFFULL << 12);
+  EXPECT_EQ(c.events[1].t, 1ULL << 24);  // one full period of the 24 bit counter later
+}
+
+TEST(Evt3Decoder, SmallStepBackIsNotRollover)
+{
+  Collector c;
+  decode<uint16_t>(
+    "evt3", {e3TimeHigh(0x100), e3AddrX(1, 0), e3TimeHigh(0x0FF), e3AddrX(2, 0)}, &c);
+  ASSERT_EQ(c.events.size(), 2U);
+  EXPECT_EQ(c.events[1].t, 0x0FFULL << 12);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
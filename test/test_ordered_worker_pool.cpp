@@ -0,0 +1,166 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "metavision_driver/ordered_worker_pool.h"
+
+using metavision_driver::OrderedWorkerPool;
+using metavision_driver::ThreadConfig;
+
+namespace
+{
+struct Job
+{
+  int index{0};
+  int result{0};
+};
+
+// collects the emitted jobs, emit() is called from the worker threads
+class Sink
+{
+public:
+  void emit(Job * job)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    order_.push_back(job->index);
+    EXPECT_EQ(job->result, job->index * 2);
+    cv_.notify_all();
+  }
+  std::vector<int> waitFor(size_t n)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::seconds(10), [this, n] { return (order_.size() >= n); });
+    return (order_);
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<int> order_;
+};
+
+std::unique_ptr<Job> makeJob(int index)
+{
+  std::unique_ptr<Job> job(new Job());
+  job->index = index;
+  return (job);
+}
+}  // namespace
+
+TEST(OrderedWorkerPool, EmitsInSubmissionOrder)
+{
+  const int numJobs = 40;
+  Sink sink;
+  OrderedWorkerPool<Job> pool("test", "test_pool", 4, numJobs);
+  pool.start(
+    [](int, Job * job) {
+      // early jobs take longest, so they complete out of order
+      std::this_thread::sleep_for(std::chrono::milliseconds((3 - job->index % 4) * 2));
+      job->result = job->index * 2;
+    },
+    [&sink](Job * job) { sink.emit(job); }, ThreadConfig());
+  for (int i = 0; i < numJobs; i++) {
+    ASSERT_TRUE(pool.submit(makeJob(i)));
+  }
+  const auto order = sink.waitFor(numJobs);
+  pool.stop();
+  ASSERT_EQ(order.size(), static_cast<size_t>(numJobs));
+  for (int i = 0; i < numJobs; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+  const auto stats = pool.getStats();
+  EXPECT_EQ(stats.numProcessed, static_cast<size_t>(numJobs));
+  EXPECT_EQ(stats.numDropped, 0U);
+}
+
+TEST(OrderedWorkerPool, DropsBeyondMaxInFlight)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool release = false;
+  Sink sink;
+  OrderedWorkerPool<Job> pool("test", "test_pool", 2, 2);
+  pool.start(
+    [&](int, Job * job) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&release] { return (release); });
+      job->result = job->index * 2;
+    },
+    [&sink](Job * job) { sink.emit(job); }, ThreadConfig());
+  EXPECT_TRUE(pool.submit(makeJob(0)));
+  EXPECT_TRUE(pool.submit(makeJob(1)));
+  EXPECT_FALSE(pool.submit(makeJob(2)));  // two are still processing
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    release = true;
+    cv.notify_all();
+  }
+  const auto order = sink.waitFor(2);
+  EXPECT_EQ(order, std::vector<int>({0, 1}));
+  // jobs are emitted, so there is room again
+  EXPECT_TRUE(pool.submit(makeJob(3)));
+  EXPECT_EQ(sink.waitFor(3).back(), 3);
+  pool.stop();
+  EXPECT_EQ(pool.getStats().numDropped, 1U);
+}
+
+TEST(OrderedWorkerPool, StopEmitsSubmittedJobs)
+{
+  const int numJobs = 8;
+  Sink sink;
+  OrderedWorkerPool<Job> pool("test", "test_pool", 2, numJobs);
+  pool.start(
+    [](int, Job * job) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      job->result = job->index * 2;
+    },
+    [&sink](Job * job) { sink.emit(job); }, ThreadConfig());
+  for (int i = 0; i < numJobs; i++) {
+    ASSERT_TRUE(pool.submit(makeJob(i)));
+  }
+  pool.stop();  // returns only when all jobs have been emitted
+  const auto order = sink.waitFor(0);
+  ASSERT_EQ(order.size(), static_cast<size_t>(numJobs));
+  for (int i = 0; i < numJobs; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+  const auto stats = pool.getStats();
+  EXPECT_EQ(stats.numProcessed, static_cast<size_t>(numJobs));
+  EXPECT_EQ(stats.numDropped, 0U);
+}
+
+TEST(OrderedWorkerPool, StopCountsUnprocessedJobsAsDropped)
+{
+  OrderedWorkerPool<Job> pool("test", "test_pool", 2, 4);
+  // not started, so nobody processes the jobs
+  EXPECT_TRUE(pool.submit(makeJob(0)));
+  EXPECT_TRUE(pool.submit(makeJob(1)));
+  pool.stop();
+  EXPECT_EQ(pool.getStats().numDropped, 2U);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "metavision_driver/packet_sizer.h"
+
+using metavision_driver::PacketInfo;
+using metavision_driver::PacketSizer;
+
+TEST(PacketSizer, TimeAndSizeThresholds)
+{
+  PacketSizer::Config config;
+  config.timeThreshold = 1000;
+  config.sizeThreshold = 500;
+  PacketSizer sizer(config);
+  sizer.messageSent(10000, 0);
+  PacketInfo info;
+  info.numEvents = 1000000;  // event threshold is disabled
+  EXPECT_FALSE(sizer.isComplete(11000, 500, info));
+  EXPECT_TRUE(sizer.isComplete(11001, 500, info));
+  EXPECT_TRUE(sizer.isComplete(11000, 501, info));
+  EXPECT_FALSE(sizer.isAdaptive());
+}
+
+TEST(PacketSizer, EventAndSensorTimeThresholds)
+{
+  PacketSizer::Config config;
+  config.eventThreshold = 100;
+  config.sensorTimeThreshold = 50;
+  PacketSizer sizer(config);
+  sizer.messageSent(0, 0);
+  PacketInfo info;
+  info.numEvents = 99;
+  EXPECT_FALSE(sizer.isComplete(0, 0, info));
+  info.numEvents = 100;
+  EXPECT_TRUE(sizer.isComplete(0, 0, info));
+  info.numEvents = 0;
+  info.startTime = 1000;
+  info.lastTime = 1060;
+  EXPECT_FALSE(sizer.isComplete(0, 0, info));  // no start time seen yet
+  info.hasStartTime = true;
+  EXPECT_TRUE(sizer.isComplete(0, 0, info));
+  info.lastTime = 1049;
+  EXPECT_FALSE(sizer.isComplete(0, 0, info));
+}
+
+TEST(PacketSizer, AdaptiveSettlesInsideBand)
+{
+  PacketSizer::Config config;
+  config.minRate = 10;
+  config.maxRate = 100;
+  PacketSizer sizer(config);
+  EXPECT_TRUE(sizer.isAdaptive());
+  EXPECT_EQ(sizer.getEventThreshold(), 1U);
+  // the time threshold bounds the latency at 1 / minRate
+  PacketInfo info;
+  sizer.messageSent(10000000000ULL, 0);
+  EXPECT_FALSE(sizer.isComplete(10100000000ULL, 0, info));
+  EXPECT_TRUE(sizer.isComplete(10100000001ULL, 0, info));
+  // 100 events every msec is 1000 msgs/s, way above the band
+  uint64_t t = 10000000000ULL;
+  for (int i = 0; i < 500; i++) {
+    t += 1000000;
+    sizer.messageSent(t, 100);
+  }
+  EXPECT_NEAR(sizer.getMessageRate(), 1000.0, 1.0);
+  // aims for the geometric mean of the band: 1e5 events/s / sqrt(10 * 100)
+  EXPECT_NEAR(static_cast<double>(sizer.getEventThreshold()), 3162.0, 2.0);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/evt3_utils.h"
+#include "metavision_driver/raw_file_reader.h"
+#include "raw_words.h"
+
+using metavision_driver::RawFileReader;
+using metavision_driver::evt3::TIME_HIGH_PERIOD;
+using namespace metavision_driver::test;  // NOLINT
+
+namespace
+{
+const char * header = "% evt 3.0\n% format EVT3;height=480;width=640\n% end\n";
+const int numTimeHighs = 10;
+
+// records the order of data and restarts coming from the reader
+class Recorder
+{
+public:
+  void data(const uint8_t * p, size_t size)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    sizes_.push_back(size);
+    // every chunk starts with a TIME_HIGH, except possibly the first
+    const uint16_t w = metavision_driver::evt3::readWord(p);
+    log_.push_back(metavision_driver::evt3::code(w) == metavision_driver::evt3::TIME_HIGH
+                     ? metavision_driver::evt3::payload(w)
+                     : -2);
+    cv_.notify_all();
+  }
+  void restart()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    log_.push_back(-1);
+  }
+  std::vector<int> waitFor(size_t n)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::seconds(10), [this, n] { return (sizes_.size() >= n); });
+    return (log_);
+  }
+  std::vector<size_t> getSizes()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return (sizes_);
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<int> log_;  // TIME_HIGH at start of chunk, -1 for restart
+  std::vector<size_t> sizes_;
+};
+
+class RawFileReaderTest : public ::testing::Test
+{
+protected:
+  void SetUp() override { fileName_ = "/tmp/mv_test_" + std::to_string(getpid()) + ".raw"; }
+  void TearDown() override
+  {
+    std::remove(fileName_.c_str());
+    std::remove((fileName_ + ".mvidx").c_str());
+  }
+  // one TIME_HIGH followed by an event for each period
+  void writeFile(const std::vector<uint16_t> & leading)
+  {
+    std::vector<uint16_t> words(leading);
+    for (int i = 0; i < numTimeHighs; i++) {
+      words.push_back(e3TimeHigh(i));
+      words.push_back(e3AddrY(i));
+      words.push_back(e3AddrX(i, 1));
+    }
+    const auto bytes = toBytes(words);
+    std::ofstream out(fileName_, std::ios::binary);
+    out << header;
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  }
+  void start(RawFileReader * reader)
+  {
+    reader->setRestartCallback([this]() { recorder_.restart(); });
+    ASSERT_TRUE(reader->start(
+      [this](const uint8_t * p, size_t size) { recorder_.data(p, size); }));
+  }
+  std::string fileName_;
+  Recorder recorder_;
+};
+}  // namespace
+
+TEST_F(RawFileReaderTest, OpenBuildsIndex)
+{
+  writeFile({});
+  RawFileReader reader("test", fileName_);
+  ASSERT_TRUE(reader.open());
+  EXPECT_EQ(reader.getEncodingFormat(), "evt3");
+  EXPECT_EQ(reader.getWidth(), 640);
+  EXPECT_EQ(reader.getHeight(), 480);
+  EXPECT_EQ(reader.getFirstTime(), 0U);
+  EXPECT_EQ(reader.getLastTime(), (numTimeHighs - 1) * TIME_HIGH_PERIOD);
+  // the second time the index is loaded from file
+  reader.close();
+  ASSERT_TRUE(reader.open());
+  EXPECT_EQ(reader.getLastTime(), (numTimeHighs - 1) * TIME_HIGH_PERIOD);
+}
+
+TEST_F(RawFileReaderTest, PlaysDataBeforeFirstTimeHigh)
+{
+  writeFile({e3AddrY(1), e3AddrX(2, 0)});
+  RawFileReader reader("test", fileName_);
+  ASSERT_TRUE(reader.open());
+  start(&reader);
+  const auto log = recorder_.waitFor(numTimeHighs);
+  reader.stop();
+  ASSERT_EQ(log.size(), static_cast<size_t>(numTimeHighs));
+  EXPECT_EQ(log[0], -2);  // starts with the leading words
+  EXPECT_EQ(log[1], 1);
+  const auto sizes = recorder_.getSizes();
+  EXPECT_EQ(sizes[0], 5 * sizeof(uint16_t));
+  EXPECT_EQ(sizes[1], 3 * sizeof(uint16_t));
+}
+
+TEST_F(RawFileReaderTest, SeekBackwardRestarts)
+{
+  writeFile({});
+  RawFileReader reader("test", fileName_);
+  ASSERT_TRUE(reader.open());
+  start(&reader);
+  // play to the end, then go back to the third period
+  auto log = recorder_.waitFor(numTimeHighs);
+  ASSERT_TRUE(reader.seek(2 * TIME_HIGH_PERIOD + 100));
+  log = recorder_.waitFor(2 * numTimeHighs - 2);
+  reader.stop();
+  std::vector<int> expected;
+  for (int i = 0; i < numTimeHighs; i++) {
+    expected.push_back(i);
+  }
+  expected.push_back(-1);  // restart comes before the data after the seek
+  for (int i = 2; i < numTimeHighs; i++) {
+    expected.push_back(i);
+  }
+  EXPECT_EQ(log, expected);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "metavision_driver/raw_scanner.h"
+#include "raw_words.h"
+
+using metavision_driver::PacketInfo;
+using metavision_driver::RawScanner;
+using metavision_driver::TriggerEvent;
+using namespace metavision_driver::test;  // NOLINT
+
+TEST(RawScanner, CollectsPacketInfoAndTriggers)
+{
+  RawScanner scanner("evt3");
+  const auto b1 = toBytes<uint16_t>(
+    {e3TimeHigh(1), e3TimeLow(5), e3AddrY(0), e3AddrX(1, 0), e3Trigger(2, 1), e3TimeLow(9),
+     e3AddrX(2, 1)});
+  std::vector<TriggerEvent> triggers;
+  PacketInfo info;
+  scanner.scan(b1.data(), b1.data() + b1.size(), &triggers, &info);
+  const uint64_t t0 = 1ULL << 12;
+  EXPECT_TRUE(info.hasStartTime);
+  EXPECT_EQ(info.startTime, t0 | 5);  // no time before the scan, first event
+  EXPECT_EQ(info.firstTime, t0 | 5);
+  EXPECT_EQ(info.lastTime, t0 | 9);
+  EXPECT_EQ(info.numEvents, 2U);
+  ASSERT_EQ(triggers.size(), 1U);
+  EXPECT_EQ(triggers[0].time, t0 | 5);
+  EXPECT_EQ(triggers[0].id, 2);
+  EXPECT_TRUE(triggers[0].polarity);
+
+  // the next packet starts at the sensor time where the last scan ended
+  const auto b2 = toBytes<uint16_t>({e3TimeLow(20), e3AddrX(3, 0)});
+  PacketInfo info2;
+  scanner.scan(b2.data(), b2.data() + b2.size(), nullptr, &info2);
+  EXPECT_EQ(info2.startTime, t0 | 9);
+  EXPECT_EQ(info2.firstTime, t0 | 20);
+  EXPECT_EQ(info2.numEvents, 1U);
+  EXPECT_EQ(scanner.getTime(), t0 | 20);
+}
+
+TEST(RawScanner, NullOutputs)
+{
+  RawScanner scanner("evt2");
+  const auto b = toBytes<uint32_t>({e2TimeHigh(1), e2CD(1, 0, 0, 0)});
+  scanner.scan(b.data(), b.data() + b.size(), nullptr, nullptr);
+  EXPECT_TRUE(scanner.hasValidTime());
+  EXPECT_EQ(scanner.getTime(), 1ULL << 6);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
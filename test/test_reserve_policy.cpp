@@ -0,0 +1,90 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "metavision_driver/reserve_policy.h"
+
+using metavision_driver::ReservePolicy;
+
+TEST(ReservePolicy, UsesPercentileOfWindow)
+{
+  ReservePolicy::Config config;
+  config.window = 100;
+  config.percentile = 0.9;
+  ReservePolicy policy(config);
+  EXPECT_EQ(policy.getReserveSize(), 0U);
+  policy.update(10, 10);
+  EXPECT_EQ(policy.getReserveSize(), 10U);  // recomputed right away at startup
+  policy.setConfig(config);
+  // 128 messages of sizes 1..128, the window holds the last 100
+  for (size_t s = 1; s <= 128; s++) {
+    policy.update(s, s);
+  }
+  EXPECT_EQ(policy.getReserveSize(), 119U);
+}
+
+TEST(ReservePolicy, IgnoresRareBursts)
+{
+  ReservePolicy::Config config;
+  config.window = 100;
+  config.percentile = 0.9;
+  ReservePolicy policy(config);
+  // one in 20 messages is huge, that is below the 10% the percentile skips
+  for (int i = 1; i <= 128; i++) {
+    policy.update(i % 20 == 0 ? 10000000 : 10, 10);
+  }
+  EXPECT_EQ(policy.getReserveSize(), 10U);
+  EXPECT_FALSE(policy.takeTrimRequest());
+}
+
+TEST(ReservePolicy, RecoversAfterBurstAndRequestsTrim)
+{
+  ReservePolicy::Config config;
+  config.window = 100;
+  config.percentile = 0.9;
+  ReservePolicy policy(config);
+  for (int i = 0; i < 128; i++) {
+    policy.update(10000000, 10000000);
+  }
+  EXPECT_EQ(policy.getReserveSize(), 10000000U);
+  EXPECT_FALSE(policy.takeTrimRequest());
+  for (int i = 0; i < 128; i++) {
+    policy.update(1000, 1000);
+  }
+  EXPECT_EQ(policy.getReserveSize(), 1000U);
+  EXPECT_TRUE(policy.takeTrimRequest());
+  EXPECT_FALSE(policy.takeTrimRequest());  // only once per peak
+}
+
+TEST(ReservePolicy, RespectsMaxSize)
+{
+  ReservePolicy::Config config;
+  config.window = 10;
+  config.maxSize = 5000;
+  ReservePolicy policy(config);
+  for (int i = 0; i < 10; i++) {
+    policy.update(100000, 100000);
+  }
+  EXPECT_EQ(policy.getReserveSize(), 5000U);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
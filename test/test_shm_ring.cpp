@@ -0,0 +1,154 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metavision_driver/shm_ring.h"
+
+using metavision_driver::ShmRingReader;
+using metavision_driver::ShmRingWriter;
+namespace shm_ring = metavision_driver::shm_ring;
+
+namespace
+{
+// unique per process such that parallel test runs don't collide
+std::string ringName() { return ("/mv_test_ring_" + std::to_string(getpid())); }
+
+std::vector<uint8_t> makePacket(uint64_t seq, size_t size)
+{
+  std::vector<uint8_t> p(size);
+  for (size_t i = 0; i < size; i++) {
+    p[i] = static_cast<uint8_t>(seq * 31 + i);
+  }
+  return (p);
+}
+
+bool writePacket(ShmRingWriter * w, uint64_t seq, size_t size)
+{
+  shm_ring::Record rec;
+  rec.seq = seq;
+  rec.size = size;
+  rec.stamp = 1000 + seq;
+  rec.numEvents = seq * 10;
+  const auto data = makePacket(seq, size);
+  return (w->write(rec, data.data()));
+}
+
+class ShmRingTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    std::string error;
+    // 1024 bytes of data, the writer aligns packets to 64 bytes
+    ASSERT_TRUE(writer_.create(ringName(), 1024, 8, "evt3", 640, 480, false, &error)) << error;
+    ASSERT_TRUE(reader_.open(ringName(), &error)) << error;
+  }
+  ShmRingWriter writer_;
+  ShmRingReader reader_;
+};
+}  // namespace
+
+TEST_F(ShmRingTest, Header)
+{
+  EXPECT_EQ(reader_.getEncoding(), "evt3");
+  EXPECT_EQ(reader_.getWidth(), 640U);
+  EXPECT_EQ(reader_.getHeight(), 480U);
+  EXPECT_FALSE(reader_.isBigEndian());
+  EXPECT_EQ(reader_.getNumWritten(), 0U);
+}
+
+TEST_F(ShmRingTest, ReadBack)
+{
+  ASSERT_TRUE(writePacket(&writer_, 0, 100));
+  ASSERT_TRUE(writePacket(&writer_, 1, 200));
+  EXPECT_EQ(reader_.getNumWritten(), 2U);
+  shm_ring::Record rec;
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(reader_.read(1, &rec, &data));
+  EXPECT_EQ(rec.seq, 1U);
+  EXPECT_EQ(rec.size, 200U);
+  EXPECT_EQ(rec.stamp, 1001U);
+  EXPECT_EQ(rec.numEvents, 10U);
+  EXPECT_EQ(data, makePacket(1, 200));
+  EXPECT_FALSE(reader_.read(2, &rec, &data));  // not written yet
+}
+
+TEST_F(ShmRingTest, PacketsAreContiguousAcrossWrap)
+{
+  // 320 bytes per packet after alignment: the 4th packet does not fit
+  // at the end and must start over at the beginning of the ring
+  for (uint64_t seq = 0; seq < 4; seq++) {
+    ASSERT_TRUE(writePacket(&writer_, seq, 300));
+  }
+  shm_ring::Record rec;
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(reader_.read(3, &rec, &data));
+  EXPECT_EQ(rec.pos % 1024, 0U);
+  EXPECT_EQ(data, makePacket(3, 300));
+  // the packet at the start of the ring is gone, the others are intact
+  EXPECT_FALSE(reader_.read(0, &rec, &data));
+  ASSERT_TRUE(reader_.read(2, &rec, &data));
+  EXPECT_EQ(data, makePacket(2, 300));
+}
+
+TEST_F(ShmRingTest, DetectsOverwrite)
+{
+  ASSERT_TRUE(writePacket(&writer_, 0, 256));
+  shm_ring::Record rec;
+  const uint8_t * p = reader_.get(0, &rec);
+  ASSERT_NE(p, nullptr);
+  EXPECT_TRUE(reader_.isValid(rec));
+  // zero copy access: the writer laps the reader
+  for (uint64_t seq = 1; seq <= 4; seq++) {
+    ASSERT_TRUE(writePacket(&writer_, seq, 256));
+  }
+  EXPECT_FALSE(reader_.isValid(rec));
+  EXPECT_EQ(reader_.get(0, &rec), nullptr);
+}
+
+TEST_F(ShmRingTest, SlotReuse)
+{
+  // 8 slots: packet 8 takes the slot of packet 0
+  for (uint64_t seq = 0; seq <= 8; seq++) {
+    ASSERT_TRUE(writePacket(&writer_, seq, 64));
+  }
+  shm_ring::Record rec;
+  EXPECT_EQ(reader_.get(0, &rec), nullptr);
+  EXPECT_NE(reader_.get(8, &rec), nullptr);
+  EXPECT_EQ(rec.seq, 8U);
+}
+
+TEST_F(ShmRingTest, RejectsOversizedPacket) { EXPECT_FALSE(writePacket(&writer_, 0, 1025)); }
+
+TEST(ShmRing, OpenFailsWithoutWriter)
+{
+  ShmRingReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.open(ringName() + "_none", &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(reader.isOpen());
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,96 @@
+// -*-c++-*---------------------------------------------------------------------------------------
+// Copyright 2024 Bernd Pfrommer <bernd.pfrommer@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "metavision_driver/evt3_utils.h"
+#include "raw_words.h"
+
+using metavision_driver::evt3::TimeGapDetector;
+using namespace metavision_driver::test;  // NOLINT
+
+namespace
+{
+TimeGapDetector::Result check(
+  TimeGapDetector * d, const std::vector<uint16_t> & words, uint64_t * lostTime)
+{
+  const auto b = toBytes(words);
+  return (d->check(b.data(), b.data() + b.size(), lostTime));
+}
+}  // namespace
+
+TEST(TimeGapDetector, ContinuousAcrossCounterWrap)
+{
+  TimeGapDetector d(10000);
+  uint64_t lost;
+  EXPECT_EQ(check(&d, {e3TimeHigh(0xFFE), e3AddrX(0, 0), e3TimeHigh(0xFFF)}, &lost), d.NONE);
+  // the 12 bit counter wraps: a roll-over, not a reset
+  EXPECT_EQ(check(&d, {e3AddrX(0, 0), e3TimeHigh(0x000), e3TimeHigh(0x001)}, &lost), d.NONE);
+  EXPECT_EQ(lost, 0U);
+  // no TIME_HIGH at all, nothing to check
+  EXPECT_EQ(check(&d, {e3AddrY(1), e3AddrX(0, 0)}, &lost), d.NONE);
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x002)}, &lost), d.NONE);
+}
+
+TEST(TimeGapDetector, ReportsGap)
+{
+  TimeGapDetector d(10000);
+  uint64_t lost;
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x100)}, &lost), d.NONE);
+  // 2 periods forward is below the threshold
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x102)}, &lost), d.NONE);
+  // 10 periods forward: 9 periods are missing
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x10C)}, &lost), d.GAP);
+  EXPECT_EQ(lost, 9 * metavision_driver::evt3::TIME_HIGH_PERIOD);
+}
+
+TEST(TimeGapDetector, ReportsGapAcrossCounterWrap)
+{
+  TimeGapDetector d(10000);
+  uint64_t lost;
+  EXPECT_EQ(check(&d, {e3TimeHigh(0xFF0)}, &lost), d.NONE);
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x010)}, &lost), d.GAP);
+  EXPECT_EQ(lost, 0x1F * metavision_driver::evt3::TIME_HIGH_PERIOD);
+}
+
+TEST(TimeGapDetector, ReportsReset)
+{
+  TimeGapDetector d(10000);
+  uint64_t lost;
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x800)}, &lost), d.NONE);
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x001)}, &lost), d.RESET);
+  EXPECT_EQ(lost, 0U);
+  // continues normally from the new time
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x002)}, &lost), d.NONE);
+}
+
+TEST(TimeGapDetector, ThresholdIsAtLeastOnePeriod)
+{
+  TimeGapDetector d(1);
+  uint64_t lost;
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x010)}, &lost), d.NONE);
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x011)}, &lost), d.NONE);
+  EXPECT_EQ(check(&d, {e3TimeHigh(0x013)}, &lost), d.GAP);
+  EXPECT_EQ(lost, metavision_driver::evt3::TIME_HIGH_PERIOD);
+}
+
+int main(int argc, char ** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}